@@ -12,7 +12,6 @@ public:
     BitBuffer(DataRate datarate_, FluxDecoder& decoder);
 
     const Data& data() const;
-    bool wrapped() const;
     int size() const;
     int remaining() const;
 
@@ -23,21 +22,49 @@ public:
     void splicepos(int pos);
 
     bool index();
+    const std::vector<int>& indexes() const;
     void add_index();
     void set_next_index();
 
     void sync_lost();
     void clear();
     void add(uint8_t bit);
+    void add_jitter(int percent);
+    bool has_jitter() const;
+    int jitter(int bitpos) const;
+    void set_weak(int bitpos, int bits);
+    bool has_weak() const;
+    bool weak(int bitpos) const;
     void remove(int num_bits);
 
-    uint8_t read1();
+    // Inline, as the scanners call these for every bit while searching for address marks.
+    inline bool wrapped() const
+    {
+        return m_wrapped || m_bitsize == 0;
+    }
+
+    inline uint8_t read1()
+    {
+        uint8_t bit = (m_data[m_bitpos / 8] >> (m_bitpos & 7)) & 1;
+
+        if (++m_bitpos == m_bitsize)
+        {
+            m_bitpos = 0;
+            m_wrapped = true;
+        }
+
+        return bit;
+    }
+
     uint8_t read2();
     uint8_t read8_msb();
     uint8_t read8_lsb();
     uint16_t read16();
     uint32_t read32();
+    uint32_t read_bits(int count);
+    uint32_t peek_bits(int count) const;
     uint8_t read_byte();
+    int read_gcr(Data& buf);
 
     template <typename T>
     bool read(T& buf)
@@ -64,6 +91,8 @@ private:
     Data m_data{};
     std::vector<int> m_indexes{};
     std::vector<int> m_sync_losses{};
+    Data m_jitter{};    // max PLL phase error (percent) per 8 bits, only when decoded from flux
+    Data m_weak{};      // non-zero per 8 bits holding weak bits, only when known
     int m_bitsize = 0;
     int m_bitpos = 0;
     int m_splicepos = 0;
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "VectorX.h"
+
+#include <cstdint>
+
+/* Correlates a bitstream with itself shifted by a number of bits, comparing
+ * 64 bits at a time and counting the equal ones by popcount. A multi
+ * revolution track read repeats after each revolution, so the best shift
+ * around the expected track length is the revolution length in bits.
+ * The bits are in the big endian bit order of the read bytes.
+ */
+class BitCorrelator
+{
+public:
+    struct Correlation
+    {
+        int shift = 0;
+        int matchingBits = 0;
+        int comparedBits = 0;
+
+        double MatchingRatio() const
+        {
+            return comparedBits > 0 ? static_cast<double>(matchingBits) / comparedBits : 0.0;
+        }
+    };
+
+    BitCorrelator(const uint8_t* bytes, int byteSize);
+    explicit BitCorrelator(const Data& bytes);
+
+    int BitSize() const { return m_bitSize; }
+
+    // The number of bits in [0, bitCount) equal to the bit shift later.
+    int CountMatchingBits(int shift, int bitCount) const;
+    // The shift in [shiftMin, shiftMax] having the most matching bits in [0, bitCount), the lowest one if more.
+    Correlation FindBestShift(int shiftMin, int shiftMax, int bitCount) const;
+
+private:
+    static int PopCount(uint64_t bits);
+    uint64_t WordAtBit(int bitPosition) const;
+
+    VectorX<uint64_t> m_words{}; // Padded with a zero word so a word can be read at any bit.
+    int m_bitSize = 0;
+};
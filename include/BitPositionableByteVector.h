@@ -5,6 +5,8 @@
 #include "ByteBitPosition.h"
 #include "VectorX.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
@@ -15,6 +17,17 @@ inline uint8_t Double4Bits(uint8_t bits)
     return (bits & 8) * 0x18u | (bits & 4) * 0xcu | (bits & 2) * 0x6u | (bits & 1) * 0x3u;
 }
 
+inline uint16_t Double8Bits(uint8_t bits)
+{
+    static const auto doubledBitsTable = [] {
+        std::array<uint16_t, 256> table{};
+        for (auto i = 0; i < 256; i++)
+            table[i] = static_cast<uint16_t>(Double4Bits(static_cast<uint8_t>(i >> 4)) << UINT8_T_BIT_SIZE | Double4Bits(i & 0xfu));
+        return table;
+    }();
+    return doubledBitsTable[bits];
+}
+
 class BitPositionableByteVector
 {
 public:
@@ -79,8 +92,17 @@ public:
             return;
         assert(RemainingByteLength() >= size);
         auto byteBitPositionSelected = byteBitPosition == nullptr ? &m_byteBitPosition : byteBitPosition;
-        for (auto i = 0; i < size; i++)
-            *(mem++) = ReadByte(byteBitPositionSelected);
+        // The bit position within the bytes does not change so the bytes are shifted by the same amount.
+        const auto bitPosition = byteBitPositionSelected->BitPosition();
+        auto src = m_bytes.data() + byteBitPositionSelected->BytePosition();
+        if (bitPosition == 0)
+            std::copy(src, src + size, mem);
+        else
+        {
+            for (auto i = 0; i < size; i++, src++)
+                *(mem++) = static_cast<uint8_t>(src[0] << bitPosition | src[1] >> (UINT8_T_BIT_SIZE - bitPosition));
+        }
+        byteBitPositionSelected->PreAddBytes(size);
     }
 
     inline void ReadBytes(Data& dataBytes, ByteBitPosition* byteBitPosition = nullptr)
@@ -246,13 +268,34 @@ public:
         const auto dstRemainingBitSize = RemainingBitLength();
         if (dstRemainingBitSize < dstBitsLen)
             m_bytes.resize(m_bytes.size() + ByteSizeHavingBits(dstBitsLen - dstRemainingBitSize));
-        while (bitsLen >= UINT8_T_BIT_SIZE)
+        // Double whole bytes directly, their bit positions within the src and dst bytes do not change.
+        const auto byteLen = bitsLen / UINT8_T_BIT_SIZE;
+        if (byteLen > 0)
         {
-            // Copy bits so dst will be at byte boundary.
-            auto srcBitsByte = srcBits.ReadByte(srcByteBitPositionSelected);
-            WriteByte(Double4Bits(srcBitsByte >> 4), dstByteBitPositionSelected);
-            WriteByte(Double4Bits(srcBitsByte & 0xfu), dstByteBitPositionSelected);
-            bitsLen -= UINT8_T_BIT_SIZE;
+            const auto srcBitPosition = srcByteBitPositionSelected->BitPosition();
+            const auto dstBitPosition = dstByteBitPositionSelected->BitPosition();
+            auto src = srcBits.m_bytes.data() + srcByteBitPositionSelected->BytePosition();
+            auto dst = m_bytes.data() + dstByteBitPositionSelected->BytePosition();
+            for (auto i = 0; i < byteLen; i++, src++, dst += 2)
+            {
+                const auto srcBitsByte = srcBitPosition == 0 ? *src
+                    : static_cast<uint8_t>(src[0] << srcBitPosition | src[1] >> (UINT8_T_BIT_SIZE - srcBitPosition));
+                const unsigned doubledBits = Double8Bits(srcBitsByte);
+                if (dstBitPosition == 0)
+                {
+                    dst[0] = static_cast<uint8_t>(doubledBits >> UINT8_T_BIT_SIZE);
+                    dst[1] = static_cast<uint8_t>(doubledBits);
+                }
+                else
+                {
+                    dst[0] = static_cast<uint8_t>((dst[0] & 0xff00u >> dstBitPosition) | doubledBits >> (UINT8_T_BIT_SIZE + dstBitPosition));
+                    dst[1] = static_cast<uint8_t>(doubledBits >> dstBitPosition);
+                    dst[2] = static_cast<uint8_t>((dst[2] & 0xffu >> dstBitPosition) | doubledBits << (UINT8_T_BIT_SIZE - dstBitPosition));
+                }
+            }
+            srcByteBitPositionSelected->PreAddBytes(byteLen);
+            dstByteBitPositionSelected->PreAddBytes(byteLen * 2);
+            bitsLen -= byteLen * UINT8_T_BIT_SIZE;
         }
         if (bitsLen > 0)
         {
@@ -273,6 +316,41 @@ public:
         (*byteBitPositionSelected)++;
     }
 
+    /* Step to the first bit position from the current one where the next
+     * patternBitsLen bits are the pattern and at least remainingByteLengthMin
+     * bytes remain. Same as peeking the bits at each position and stepping a
+     * bit, but comparing 64 bit windows. If there is no such position then
+     * stepping to where less bytes remain and returning false.
+     */
+    bool StepToBits(uint32_t pattern, int patternBitsLen, int remainingByteLengthMin)
+    {
+        constexpr int WINDOW_BIT_SIZE = 64;
+        assert(patternBitsLen > 0 && patternBitsLen <= 32 && remainingByteLengthMin * UINT8_T_BIT_SIZE >= patternBitsLen);
+        const auto patternMask = ~0ull >> (WINDOW_BIT_SIZE - patternBitsLen);
+        const auto positionMax = (BytesByteSize() - remainingByteLengthMin) * UINT8_T_BIT_SIZE;
+        auto position = m_byteBitPosition.TotalBitPosition();
+        while (position <= positionMax)
+        {
+            // The window starts at the byte of position, the bytes after the end are 0.
+            const auto bytePosition = position / UINT8_T_BIT_SIZE;
+            uint64_t window = 0;
+            for (auto i = 0; i < WINDOW_BIT_SIZE / UINT8_T_BIT_SIZE; i++)
+                window = window << UINT8_T_BIT_SIZE | (bytePosition + i < BytesByteSize() ? m_bytes[bytePosition + i] : 0u);
+            const auto windowPositionSup = std::min(bytePosition * UINT8_T_BIT_SIZE + WINDOW_BIT_SIZE - patternBitsLen, positionMax) + 1;
+            for (; position < windowPositionSup; position++)
+            {
+                const auto shift = bytePosition * UINT8_T_BIT_SIZE + WINDOW_BIT_SIZE - patternBitsLen - position;
+                if ((window >> shift & patternMask) == pattern)
+                {
+                    m_byteBitPosition = position;
+                    return true;
+                }
+            }
+        }
+        m_byteBitPosition = position;
+        return false;
+    }
+
     void StepBytes(int bytes, ByteBitPosition* byteBitPosition = nullptr)
     {
         auto byteBitPositionSelected = byteBitPosition == nullptr ? &m_byteBitPosition : byteBitPosition;
@@ -4,4 +4,5 @@
 
 bool generate_special(TrackData& trackdata);
 void generate_bitstream(TrackData& trackdata);
+FluxData generate_flux(const BitBuffer& bitbuf, int precomp_ns = 0);
 void generate_flux(TrackData& trackdata);
@@ -14,6 +14,8 @@ public:
     int gapPreIDAMBits(const bool short_mfm_gap = false) const;
     void adjustDataBitsBeforeOffset(const int sectorOffset, const int gap3_bytes = 0, const bool short_mfm_gap = false) override;
     void justAddedImportantBits() override;
+    void justAddedDataAM() override;
+    void setWeakData(int offset, int length);
     void cutExcessUnimportantDataBitsAtTheEnd(const int trackLen);
     void addIAM() override;
     int getIAMPosition() const;
@@ -28,4 +30,5 @@ private:
     int m_iamOffset = 0;
     int m_prevSectorOffset = 0; // Always must be >= 0.
     int m_afterLastImportantRawBitPosition = 0;
+    int m_dataOffset = 0;   // Start of the most recently added sector data.
 };
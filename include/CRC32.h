@@ -0,0 +1,61 @@
+#pragma once
+
+#include "VectorX.h"
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+
+// CRC-32 (IEEE 802.3, reflected) as used by zip, WOZ and UDI. The value is
+// held in its final (inverted) form, so a running CRC can be passed on as
+// the initial value of another, as with zlib's crc32().
+class CRC32
+{
+public:
+    static constexpr const uint32_t POLYNOMIAL = 0xedb88320;  // reflected 0x04c11db7
+    static constexpr const uint32_t INIT_CRC = 0;             // CRC of no data
+
+    explicit CRC32(uint32_t init = INIT_CRC);
+    explicit CRC32(const Data& data, uint32_t init = INIT_CRC);
+
+    template<typename T>
+    CRC32(const void* buf, T len, uint32_t init_ = INIT_CRC)
+        : CRC32(init_)
+    {
+        add(buf, len);
+    }
+
+    operator uint32_t () const;
+
+    void init(uint32_t crc = INIT_CRC);
+    uint32_t add(uint8_t byte);
+
+    template<typename T>
+    uint32_t add(const void* buf, T len)
+    {
+        if (len > 0)
+            add_block(reinterpret_cast<const uint8_t*>(buf), static_cast<size_t>(len));
+
+        return m_crc;
+    }
+
+    uint32_t add(const Data& data);
+
+    // Append a block whose own CRC (from INIT_CRC) and length are already known.
+    uint32_t combine(uint32_t crc2, uint64_t len2);
+    static uint32_t combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+
+private:
+    void add_block(const uint8_t* pb, size_t len);
+
+    static void init_crc_tables();
+    static uint32_t multmodp(uint32_t a, uint32_t b);
+    static uint32_t x2nmodp(uint64_t n, unsigned k);
+
+    static std::array<std::array<uint32_t, 256>, 8> s_crc_lookup;
+    static std::array<uint32_t, 32> s_x2n_lookup;
+    static bool s_have_clmul;
+    static std::once_flag flag;
+
+    uint32_t m_crc = INIT_CRC;
+};
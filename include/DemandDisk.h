@@ -2,6 +2,7 @@
 
 #include "Disk.h"
 #include "DeviceReadingPolicy.h"
+#include "RetryLearner.h"
 
 #include <bitset>
 
@@ -29,4 +30,5 @@ protected:
     virtual void save(TrackData& trackdata);
 
     std::bitset<MAX_DISK_CYLS * MAX_DISK_HEADS> m_loaded{};
+    RetryLearner m_retry_learner{};   // Used only with opt_adaptive_retries.
 };
@@ -36,6 +36,11 @@ public:
     virtual TrackData& readNC(const CylHead& cylhead, bool uncached = false,
                               int with_head_seek_to = -1,
                               const DeviceReadingPolicy& deviceReadingPolicy = DeviceReadingPolicy{});
+    static void PrefetchTransferTracks(Disk& src_disk, const Range& range, Disk& dst_disk,
+                                       TransferMode transferMode, const DeviceReadingPolicy& deviceReadingPolicy,
+                                       bool cyls_first, bool& downwards,
+                                       const std::function<bool(const CylHead& cylhead)>& is_track_skipped = nullptr,
+                                       const std::function<void(const CylHead& cylhead)>& on_track_read = nullptr);
     const TrackData& read(const CylHead& cylhead, bool uncached = false,
                           int with_head_seek_to = -1,
                           const DeviceReadingPolicy& deviceReadingPolicy = DeviceReadingPolicy{});
@@ -22,6 +22,7 @@ public:
     bool sync_lost();
     int flux_revs() const;
     int flux_count() const;
+    int jitter_percent() const;
 
     int next_bit();
     int next_flux();
@@ -37,6 +38,7 @@ protected:
     int m_flux_scale_percent = 100;
     int m_pll_adjust = 0;
     int m_goodbits = 0;
+    int m_jitter_percent = 0;
     bool m_index = false;
     bool m_sync_lost = false;
 };
@@ -14,6 +14,7 @@
 #endif
 
 class MEMORY;
+class HddManifest;
 
 const int SECTOR_SIZE = 512;
 
@@ -39,7 +40,8 @@ public:
     bool Seek(int64_t sector) const;
     int Read(void* pv, int sectors, bool byte_swap = false) const;
     int Write(void* pv, int sectors, bool byte_swap = false);
-    bool Copy(HDD* phSrc_, int64_t uSectors_, int64_t uSrcOffset_ = 0, int64_t uDstOffset_ = 0, int64_t uTotal_ = 0, const char* pcszAction_ = nullptr);
+    bool Copy(HDD* phSrc_, int64_t uSectors_, int64_t uSrcOffset_ = 0, int64_t uDstOffset_ = 0, int64_t uTotal_ = 0, const char* pcszAction_ = nullptr, HddManifest* manifest = nullptr);
+    bool Verify(HDD* phSrc_, int64_t uSectors_, int64_t uSrcOffset_ = 0, int64_t uDstOffset_ = 0, int64_t uTotal_ = 0);
 
     void SetIdentifyData(const IDENTIFYDEVICE* pIdentify_ = nullptr);
 
@@ -60,6 +62,9 @@ protected:
     virtual bool Create(const std::string&/*path*/, uint64_t /*ullTotalBytes_*/, const IDENTIFYDEVICE* /*pIdentify_*/ = nullptr, bool /*fOverwrite_*/ = false) { return false; }
 
     void Reset();
+    int CopyBlockSectors(const HDD* phSrc_) const;
+    bool EndDirectIO() const;
+    void DropCachedData(int64_t len) const;
     std::string GetIdentifyString(void* p, size_t n);
     void SetIdentifyString(const std::string& str, void* p, size_t n);
 
@@ -69,6 +74,9 @@ public:
     int sector_size = 0, data_offset = 0;
     int64_t total_sectors = 0;
     int64_t total_bytes = 0;
+    int io_sectors = 0;             // preferred sectors per request, or 0 for the default
+    bool uncached_io = false;       // keep the data out of the OS cache
+    mutable bool direct_io = false; // O_DIRECT is in use
     std::string strMakeModel{}, strSerialNumber{}, strFirmwareRevision{};
     IDENTIFYDEVICE sIdentify = {};
 };
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* CRC-32 checksums of the 1MB blocks of an HDD image, stored next to it so
+ * the image can be verified later without rereading its source. Copying adds
+ * the sectors as they are read, from any thread and in any order, and they
+ * are combined into the block checksums once the whole disk is covered. The
+ * CRC-32 of all of the data is kept too, as crc32 and zip tools report for a
+ * raw image.
+ */
+class HddManifest
+{
+public:
+    static constexpr int BLOCK_BYTES = 1024 * 1024;
+
+    explicit HddManifest(const std::string& path);
+    static std::string DefaultPath(const std::string& hdd_path);
+
+    const std::string& path() const { return m_path; }
+
+    void Start(int64_t total_sectors, int sector_size);
+    // Add sectors of the disk in any order, from any thread.
+    void AddSectors(int64_t sector, const uint8_t* pb, int sectors);
+    // Combine the added sectors into block checksums, throw if any are missing.
+    void Finish();
+
+    // Return false if there is no manifest, throw if it is invalid.
+    bool Load();
+    void Save() const;
+
+    int64_t total_sectors() const { return m_total_sectors; }
+    int sector_size() const { return m_sector_size; }
+    int block_sectors() const { return BLOCK_BYTES / m_sector_size; }
+    int64_t blocks() const { return static_cast<int64_t>(m_block_crcs.size()); }
+    uint32_t block_crc(int64_t block) const { return m_block_crcs[static_cast<size_t>(block)]; }
+    uint32_t image_crc() const { return m_image_crc; }
+
+private:
+    struct Extent
+    {
+        int sectors = 0;
+        uint32_t crc = 0;
+    };
+
+    std::string m_path;
+    int64_t m_total_sectors = 0;
+    int m_sector_size = 0;
+    std::mutex m_mutex{};
+    std::map<int64_t, Extent> m_extents{};  // by first sector
+    std::vector<uint32_t> m_block_crcs{};
+    uint32_t m_image_crc = 0;
+};
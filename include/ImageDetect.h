@@ -0,0 +1,24 @@
+#pragma once
+
+#include "MemFile.h"
+#include "types.h"
+
+// Cheap pre-checks run before the full image readers. A format may register
+// magic byte strings and file extensions that its reader always requires, so
+// a mismatch means the reader would reject the file and needn't be called.
+// Formats without a signature remain candidates for every file.
+struct ImageSignature
+{
+    struct Magic
+    {
+        int offset;
+        std::string bytes;
+    };
+
+    const char* pszType;
+    VectorX<Magic> magics{};                // one must match, if any are given
+    VectorX<std::string> extensions{};      // one must match the file name, if any are given
+};
+
+bool IsImageCandidate(const IMAGE_ENTRY& entry, const MemFile& file);
+VectorX<const IMAGE_ENTRY*> ImageCandidates(const MemFile& file);
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// LZSS Compression - adapted from the original C code by Haruhiko Okumura (1988)
+//
+// For algorithm/implementation details, as well as general compression info, see:
+//   http://www.fadden.com/techmisc/hdc/  (chapter 10 covers LZSS)
+//
+// Tweaked and reformatted to improve my own understanding, and wrapped in a
+// namespace to avoid polluting the global namespace with the following.
+// Used by the TD0 reader for its Huffman compressed images.
+//
+// The decoder reads its input a 64-bit word at a time, and decodes the first
+// TABLE_BITS of each Huffman code with a lookup table into the adaptive tree.
+// The table only depends on the nodes near the root, so it's rebuilt lazily,
+// when a tree update has swapped one of those nodes since it was last built.
+
+namespace LZSS
+{
+constexpr int N = 4096;                     // ring buffer size
+constexpr int F = 60;                       // lookahead buffer size
+constexpr int THRESHOLD = 2;                // match needs to be longer than this for position/length coding
+
+constexpr int N_CHAR = 256 - THRESHOLD + F; // kinds of characters (character code = 0..N_CHAR-1)
+constexpr int T = N_CHAR * 2 - 1;           // size of table
+constexpr int R = T - 1;                    // tree root position
+constexpr int MAX_FREQ = 0x8000;            // updates tree when root frequency reached this value
+
+constexpr int TABLE_BITS = 6;               // code bits decoded by a single table lookup
+
+
+class Decoder
+{
+public:
+    Decoder(const uint8_t* pb, int len);
+
+    int Unpack(uint8_t* pOut_, int out_size);
+    int consumed() const;
+
+private:
+    void RebuildTree();
+    void UpdateTree(int c);
+    void BuildTable(int node, int depth, unsigned prefix);
+
+    void Refill();
+    unsigned GetBit();
+    unsigned GetBits(int count);
+    bool eof() const;
+
+    unsigned DecodeChar();
+    unsigned DecodePosition();
+
+    struct TableEntry
+    {
+        uint16_t node;      // tree node reached
+        uint8_t bits;       // code bits used to reach it
+    };
+
+    std::array<short, T + N_CHAR> parent{};     // parent nodes (0..T-1) and leaf positions (rest)
+    std::array<short, T> son{};                 // pointers to child nodes (son[], son[] + 1)
+    std::array<uint16_t, T + 1> freq{};         // frequency table
+
+    std::array<TableEntry, 1 << TABLE_BITS> m_table{};  // first TABLE_BITS of each code
+    std::array<bool, T> m_in_table{};           // nodes examined when building m_table
+    bool m_table_dirty = true;
+
+    std::array<uint8_t, N + F - 1> ring_buff{}; // text buffer for match strings
+    unsigned r = N - F;                         // ring buffer position
+
+    const uint8_t* m_pb = nullptr;              // next unbuffered input byte
+    const uint8_t* m_end = nullptr;             // end of input
+    int m_len = 0;                              // input length
+    uint64_t m_bitbuf = 0;                      // left-aligned bit buffer
+    int m_bitcount = 0;                         // valid bits in m_bitbuf
+    uint64_t m_bitpos = 0;                      // total bits consumed
+};
+
+} // namespace LZSS
@@ -4,6 +4,7 @@
 
 #include <cstring>
 #include <string>
+#include <vector>
 
 enum class Compress { None, Zip, Gzip, Bzip2, Xz };
 std::string to_string(const Compress& compress);
@@ -16,6 +17,10 @@ public:
     void open(const void* buf, int size, const std::string& path,
         const std::string& filename = "");
 
+    // Names of the non-empty files in a zip archive, which can be opened
+    // individually using "archive.zip:name" paths.
+    static std::vector<std::string> zip_entries(const std::string& path);
+
     const Data& data() const;
     int size() const;
     int remaining() const;
@@ -34,6 +34,10 @@ public:
     {
     }
 
+    // The bits of the sync for searching it, the signs in reading order.
+    static constexpr uint32_t BITS = ADDRESS_MARK_SIGN << 16 | ADDRESS_MARK_SIGN << 8 | ADDRESS_MARK_SIGN;
+    static constexpr int BITS_LEN = 3 * UINT8_T_BIT_SIZE;
+
     static constexpr bool IsValid(uint8_t byte)
     {
         return byte == ADDRESS_MARK_SIGN;
@@ -295,6 +299,7 @@ public:
     void ProcessSectorDataRefs(OrphanDataCapableTrack& orphanDataCapableTrack);
     OrphanDataCapableTrack DecodeTrack(const CylHead& cylHead);
     OrphanDataCapableTrack DecodeTrack(const CylHead& cylHead) const;
+    int DetermineBestTrackLen(const int trackLenAbout) const;
 
     BitPositionableByteVector m_physicalTrackContent{};
 
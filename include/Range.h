@@ -16,6 +16,9 @@ public:
     int heads() const;
     bool contains(const CylHead& cylhead);
     void each(const std::function<void(const CylHead & cylhead)>& func, bool cyls_first = false) const;
+    // Like each but the cylinders are swept alternately upwards and downwards, the first
+    // sweep downwards if downwards is set, which is toggled by each sweep for continuing.
+    void each_serpentine(const std::function<void(const CylHead & cylhead)>& func, bool cyls_first, bool& downwards) const;
 
     std::string ToString(bool onlyRelevantData = true) const;
     friend std::string to_string(const Range& r, bool onlyRelevantData = true)
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Disk.h"
+#include "RetryPolicy.h"
+
+#include <bitset>
+#include <string>
+
+/* The progress of copying a device disk, stored next to the destination image
+ * so an interrupted copy can be resumed. It records the disk round with its
+ * retry state, the tracks done in that round, and the read stats of the
+ * destination sectors since not every image format stores them.
+ */
+class RescueCheckpoint
+{
+public:
+    explicit RescueCheckpoint(const std::string& dst_path);
+
+    const std::string& path() const { return m_path; }
+
+    // Return false if there is no checkpoint, throw if it is invalid.
+    bool Load();
+    // The destination image must be written already since the checkpoint refers to it.
+    void Save(Disk& dst_disk);
+    void Remove() const;
+    void ApplyReadStats(Disk& dst_disk) const;
+
+    void StartRound(int round, const RetryPolicy& disk_retries, bool sweep_downwards);
+    bool IsTrackDone(const CylHead& cylhead) const;
+    void SetTrackDone(const CylHead& cylhead);
+
+    int round = 0;
+    int disk_retries_left = 0;
+    bool disk_retries_changed = false;
+    bool sweep_downwards = false;
+
+private:
+    struct SectorReadStats
+    {
+        CylHead cylhead{};
+        Header header{};
+        int read_attempts = 0;
+        VectorX<int> read_counts{};
+    };
+
+    std::string m_path;
+    std::bitset<MAX_DISK_CYLS * MAX_DISK_HEADS> m_tracks_done{};
+    VectorX<SectorReadStats> m_sector_read_stats{};
+};
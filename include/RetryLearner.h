@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Header.h"
+
+#include <map>
+#include <tuple>
+
+/* Learns from the retries spent so far how likely a further retry improves
+ * the read data of a track or of a sector, so hopeless retrying can stop
+ * early while improving reads keep their budget. The estimate of a track or
+ * sector starts from the estimate of its neighbouring cylinders, which starts
+ * from the estimate of the whole disk, and each level moves towards its own
+ * observations as they accumulate. It uses no randomness or clock so its
+ * decisions are reproducible.
+ */
+class RetryLearner
+{
+public:
+    static constexpr int WHOLE_TRACK = -1;           // Sector id for track level retries.
+    static constexpr int MIN_RETRIES = 1;            // Retries always allowed before learning can stop them.
+    static constexpr double MIN_IMPROVEMENT_PROBABILITY = 0.1;
+
+    // Record the outcome of one retry of the track or of its sector.
+    void Record(const CylHead& cylhead, int sector_id, bool improved);
+
+    // The estimated probability that the next retry improves the read data.
+    double ImprovementProbability(const CylHead& cylhead, int sector_id) const;
+
+    // Whether a further retry is worth spending after the given number of retries.
+    bool WorthRetrying(const CylHead& cylhead, int sector_id, int retries_done) const;
+
+private:
+    struct Stats
+    {
+        int retries = 0;
+        int improvements = 0;
+    };
+
+    using Key = std::tuple<int, int, int>; // cyl, head, sector id
+
+    // Blend the observations with a prior estimate having the given weight in retries.
+    static double Estimate(const Stats& stats, double prior, double prior_weight);
+    Stats Get(int cyl, int head, int sector_id) const;
+
+    std::map<Key, Stats> m_stats{};
+    Stats m_track_total{};
+    Stats m_sector_total{};
+};
@@ -3,6 +3,11 @@
 #include "HDD.h"
 #include "Util.h"
 
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
 const int MGT_TRACKS = 80;
 const int MGT_SIDES = 2;
 const int MGT_SECTORS = 10;
@@ -105,6 +110,15 @@ struct BDOS_CAPS
     bool lba = false;           // True if disk needs LBA sector count instead of CHS
 };
 
+// BDOS caps and record list of a disk, read once and cached in memory, and
+// next to image files where the file size and modification time must match.
+struct BDOS_INDEX
+{
+    BDOS_CAPS caps{};
+    std::vector<std::string> labels{};      // Record list labels, from record 1 (empty if unused)
+    std::map<std::string, int> records{};   // Lower-case label to lowest record number using it
+};
+
 
 const int PRODOS_SECTOR_SIZE = 512;
 const int PRODOS_BASE_SECTORS = 68;
@@ -139,4 +153,5 @@ bool IsBDOSDisk(const HDD& hdd, BDOS_CAPS& bdc);
 
 bool UpdateBDOSBootSector(uint8_t* pb_, const HDD& hdd);
 void GetBDOSCaps(int64_t sectors, BDOS_CAPS& bdc);
+std::shared_ptr<const BDOS_INDEX> GetBDOSIndex(const HDD& hdd, const std::string& hdd_path);
 int FindBDOSRecord(const HDD& hdd, const std::string& path, BDOS_CAPS& bdc);
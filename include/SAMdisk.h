@@ -6,13 +6,17 @@
 #include "HDD.h"
 
 // copy
-bool ImageToImage(const std::string& src_path, const std::string& dst_path);
+bool ImageToImage(const std::string& src_path, const std::string& dst_path,
+                  const std::vector<std::string>& extra_src_paths = {});
 bool Image2Trinity(const std::string& path, const std::string& trinity_path);
 bool Hdd2Hdd(const std::string& src_path, const std::string& dst_path);
 bool Hdd2Boot(const std::string& hdd_path, const std::string& boot_path);
 bool Boot2Hdd(const std::string& boot_path, const std::string& hdd_path);
 bool Boot2Boot(const std::string& src_path, const std::string& dst_path);
 
+// batch
+bool BatchConvert(const std::string& src, const std::string& dst_pattern);
+
 // create
 bool CreateImage(const std::string& path, Range range);
 bool CreateHddImage(const std::string& path, int nSizeMB_);
@@ -37,6 +41,7 @@ bool FormatBoot(const std::string& path);
 bool FormatRecord(const std::string& path);
 bool FormatImage(const std::string& path, Range range);
 bool UnformatImage(const std::string& path, Range range);
+bool VerifyHdd(const std::string& path, const std::string& manifest_path = "");
 
 // rpm
 bool DiskRpm(const std::string& path);
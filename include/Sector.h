@@ -9,6 +9,7 @@
 //////////////////////////////////////////////////////////////////////////////
 
 using DataList = VectorX<Data>;
+using WeakRegions = VectorX<Interval<int>>;    // byte ranges of weak sector data
 
 //////////////////////////////////////////////////////////////////////////////
 
@@ -214,6 +215,7 @@ public:
     int revolution = 0;                     // the nth floppy disk spin when this sector was read (i.e. multioffset / tracklen), usually 0. Currently not saved in RDSK.
     int gap3 = 0;                           // inter-sector gap size
     uint8_t dam = IBM_DAM;                  // data address mark
+    WeakRegions weak_regions{};             // weak data ranges detected from flux timing. Currently not saved in any format.
 
 private:
     bool m_bad_id_crc = false;
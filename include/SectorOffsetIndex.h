@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Interval.h"
+#include "Sector.h"
+
+#include <utility>
+
+/* Index of the sector offsets, for finding the sectors at offsets within a
+ * ringed interval or tolerated same as an offset in logarithmic time instead
+ * of iterating all sectors. The found indices are ascending so the first one
+ * accepted by a predicate is the same as the one found by iterating. The index
+ * is a snapshot, the sectors must be changed only through Insert.
+ */
+class SectorOffsetIndex
+{
+public:
+    explicit SectorOffsetIndex(const Sectors& sectors);
+
+    // The indices of sectors whose offset is ringed within the interval.
+    VectorX<int> FindRingedWithin(const Interval<int>& interval) const;
+    // The indices of sectors whose offset is tolerated same as the offset, see are_offsets_tolerated_same.
+    VectorX<int> FindToleratedSame(int offset, int toleratedOffsetDistance, int trackLen) const;
+
+    // Whether the sectors are in offset order.
+    bool IsSorted() const { return m_sorted; }
+    // The index where a sector of the offset is inserted to keep the sectors in offset order.
+    int UpperBound(int offset) const;
+    // Register a sector inserted at the index.
+    void Insert(int index, int offset);
+
+private:
+    using OffsetAndIndex = std::pair<int, int>;
+
+    // The indices of sectors whose offset is within any of the closed ranges.
+    VectorX<int> FindWithin(std::initializer_list<OffsetAndIndex> ranges) const;
+
+    VectorX<OffsetAndIndex> m_offsetsAndIndices{}; // Ordered by offset then index.
+    bool m_sorted = true;
+};
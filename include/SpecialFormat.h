@@ -10,6 +10,7 @@ bool IsSpectrumSpeedlockTrack (const Track &track, int &weak_offset, int &weak_s
 bool IsCpcSpeedlockTrack (const Track &track, int &weak_offset, int &weak_size);
 bool IsRainbowArtsTrack (const Track &track, int &weak_offset, int &weak_size);
 bool IsKBIWeakSectorTrack (const Track &track, int &weak_offset, int &weak_size);
+bool IsFluxWeakSectorTrack (const Track &track);
 bool IsLogoProfTrack (const Track &track);
 bool IsOperaSoftTrack (const Track &track);
 bool Is8KSectorTrack (const Track &track);
@@ -23,6 +24,7 @@ TrackData GenerateSpectrumSpeedlockTrack (const CylHead &cylhead, const Track &t
 TrackData GenerateCpcSpeedlockTrack (const CylHead &cylhead, const Track &track, int weak_offset, int weak_size);
 TrackData GenerateRainbowArtsTrack (const CylHead &cylhead, const Track &track, int weak_offset, int weak_size);
 TrackData GenerateKBIWeakSectorTrack (const CylHead &cylhead, const Track &track, int weak_offset, int weak_size);
+TrackData GenerateFluxWeakSectorTrack (const CylHead &cylhead, const Track &track);
 TrackData GenerateLogoProfTrack (const CylHead &cylhead, const Track &track);
 TrackData GenerateSystem24Track (const CylHead &cylhead, const Track &track);
 TrackData GenerateOperaSoftTrack (const CylHead &cylhead, const Track &track);
@@ -8,7 +8,9 @@
 class TimedAndPhysicalDualTrack
 {
 public:
-    bool SyncDemultiMergePhysicalUsingTimed(OrphanDataCapableTrack&& toBeMergedODCTrack, const RepeatedSectors& repeatedSectorIds);
+    // The revolutionLen is the length of a revolution in the physical track if known, otherwise 0.
+    bool SyncDemultiMergePhysicalUsingTimed(OrphanDataCapableTrack&& toBeMergedODCTrack, const RepeatedSectors& repeatedSectorIds,
+        const int revolutionLen = 0);
 
     Track timedIdTrack{};
     /* Cumulative last result of adding each newly read synced and demultid
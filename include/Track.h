@@ -2,6 +2,7 @@
 
 #include "Sector.h"
 #include "Format.h"
+#include "SectorOffsetIndex.h"
 
 #include <map>
 
@@ -206,6 +207,8 @@ public:
     IdOffsetDistanceInfo idOffsetDistanceInfo{};
 
 private:
+    AddResult add(Sector&& sector, SectorOffsetIndex& offsetIndex);
+
     Sectors m_sectors{};
     mutable Sectors m_sectors_view_ordered_by_id{};
 
@@ -14,6 +14,7 @@ public:
     virtual void addRawBit(bool one) = 0;
     virtual void adjustDataBitsBeforeOffset(const int sectorOffset, const int gap3_bytes = 0, const bool short_mfm_gap = false) = 0;
     virtual void justAddedImportantBits() = 0;
+    virtual void justAddedDataAM() {}
 
     void addBit(bool bit);
     void addDataBit(bool bit);
@@ -12,6 +12,7 @@
 #ifndef _WIN32
 #include <dirent.h>
 #endif
+#include <mutex>
 #include <set>
 
 #ifndef HIWORD
@@ -141,6 +142,7 @@ const char* CHR(int cyl, int head, int record);
 const char* CHSR(int cyl, int head, int sector, int record);
 
 extern std::set<std::string> seen_messages;
+extern std::mutex messages_mutex;
 
 void MessageCore(MsgType type, const std::string& msg);
 
@@ -189,6 +191,8 @@ void FreeMem(void* pv_);
 std::string FileExt(const std::string& path);
 bool IsFileExt(const std::string& path, const std::string& ext);
 int64_t FileSize(const std::string& path);
+int64_t FileModTime(const std::string& path);
+bool RenameReplacing(const std::string& from_path, const std::string& to_path);
 int GetFileType(const char* pcsz_);
 
 #ifdef _WIN32
@@ -209,6 +213,7 @@ void ReadBinaryFile(const std::string& filePath, Data& data);
 void WriteBinaryFile(const std::string& filePath, const Data& data);
 
 void ByteSwap(void* pv, size_t nSize_);
+bool IsZeroFilled(const void* pv, size_t nSize_);
 int TPeek(const uint8_t* buf, int offset = 0);
 void TrackUsedInit(Disk& disk);
 bool IsTrackUsed(int cyl_, int head_);
@@ -10,6 +10,12 @@
 
 
 
+/* The virtual drive simulates the timing of a real one: the disk rotates at
+ * 300 or 360 rpm, the index pulse marks angle 0 and stepping takes the time
+ * selected by Specify. Every command advances a simulated clock instead of
+ * answering instantly, optionally sleeping in scaled real time as well, so
+ * reading strategies can be compared without hardware.
+ */
 class VfdrawcmdSys : public FdrawcmdSys
 {
 public:
@@ -20,6 +26,9 @@ public:
     FD_FDC_INFO* GetFdcInfo() override;
     int GetMaxTransferSize() override;
 
+    int64_t GetElapsedTime() const; // Simulated microseconds since opening.
+    int GetRotationalPosition() const; // Simulated microseconds since the last index pulse.
+
 public:
     bool GetVersion(util::Version& version) override;
     bool GetResult(FD_CMD_RESULT& result) override;
@@ -31,6 +40,34 @@ protected:
     void LimitCyl();
     const PhysicalTrackMFM& LoadPhysicalTrack(const CylHead& cylhead);
     OrphanDataCapableTrack& ReadTrackFromPhysicalTrack(const CylHead& cylhead);
+    const OrphanDataCapableTrack& ReadTrackUnderHead(int head);
+
+    // Simulated timing, all times are in microseconds.
+    class SimulatedCommand
+    {
+    public:
+        SimulatedCommand(VfdrawcmdSys& vfdrawcmdSys, const char* name);
+        ~SimulatedCommand();
+        SimulatedCommand(const SimulatedCommand&) = delete;
+        SimulatedCommand& operator=(const SimulatedCommand&) = delete;
+
+        int64_t startTime() const;
+
+    private:
+        VfdrawcmdSys& m_vfdrawcmdSys;
+        const char* m_name;
+        int64_t m_startTime;
+    };
+
+    int Rpm() const;
+    int RotationTime() const;
+    int StepTime() const;
+    int SectorTime(const OrphanDataCapableTrack& orphanDataCapableTrack, const Sector& sector) const;
+    void AdvanceTime(int64_t time);
+    void AdvanceTimeToIndex();
+    void AdvanceTimeToSector(const OrphanDataCapableTrack& orphanDataCapableTrack, const Sector& sector);
+    void AdvanceTimeToIndexCountFrom(int64_t startTime, int count);
+    void AdvanceTimeBySteps(int steps);
 public:
     bool SetEncRate(Encoding encoding, DataRate datarate) override;
     bool SetHeadSettleTime(int ms) override;
@@ -74,6 +111,12 @@ private:
     uint8_t m_waitSectorCount = 0; // The number of sector to wait before these operations: ReadId, ReadData, ReadDeletedData, WriteData, WriteDeletedData, Verify.
     bool m_waitSector = false;
     uint8_t m_currentSectorIndex = 0;
+    CylHead m_currentCylHead{}; // The track m_currentSectorIndex belongs to.
+
+    int64_t m_elapsedTime = 0;
+    int m_commandDepth = 0;
+    int m_stepRate = 0x8; // Coded SRT value, see Specify.
+    int m_headSettleTime = 15; // ms
 
     std::bitset<MAX_DISK_CYLS * MAX_DISK_HEADS> m_physicalTrackLoaded{};
     std::map<CylHead, PhysicalTrackMFM> m_physicalTracks{};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "BitBuffer.h"
+#include "Sector.h"
+
+// Locates weak byte ranges of a sector data field decoded from multi-revolution
+// flux. Each revolution's copy of the data field is added with its bitstream
+// position, then a single pass compares the copies byte by byte. Bytes which
+// decode differently between revolutions, or whose flux transitions have a high
+// or unstable PLL phase error over several revolutions, are reported as weak.
+class WeakBitAnalyser
+{
+public:
+    static constexpr int JITTER_PERCENT_MIN = 30;           // mean phase error of a weak byte
+    static constexpr int JITTER_SPREAD_PERCENT_MIN = 15;    // phase error spread across revolutions of a weak byte
+    static constexpr int MERGE_GAP_BYTES = 4;               // weak ranges closer than this are joined
+
+    explicit WeakBitAnalyser(const BitBuffer& bitbuf);
+
+    bool usable() const;
+    void add_copy(int bitpos, int shift, const Data& data);
+    WeakRegions analyse(int data_size) const;
+    void analyse(Sector& sector) const;
+
+private:
+    struct DataCopy
+    {
+        int bitpos;     // bitstream position of the first data byte
+        int shift;      // log2 of bitcells per data byte (4 for MFM, 5 for FM)
+        Data data;
+    };
+
+    int byte_jitter(const DataCopy& copy, int index) const;
+
+    const BitBuffer& m_bitbuf;
+    VectorX<DataCopy> m_copies{};
+};
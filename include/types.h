@@ -78,7 +78,7 @@ IMAGE_ENTRY aImageTypes[] = {
     ADD_IMAGE_RW(IMD)
     ADD_IMAGE_RO(SBT)
     ADD_IMAGE_RO(DFI)
-    ADD_IMAGE_RO(SCP)
+    ADD_IMAGE_RW(SCP)
     ADD_IMAGE_RO(STREAM)
     ADD_IMAGE_RW(HFE)
     ADD_IMAGE_RW(MFI)
@@ -45,6 +45,8 @@ private:
     Track BlindReadHeaders(const CylHead& cylhead, int& firstSectorSeen);
     void ReadSector(const CylHead& cylhead, Track& track, int index, int firstSectorSeen = 0);
     void ReadSectors(const CylHead& cylhead, Track& track, const VectorX<int>& indices, int firstSectorSeen);
+    bool ReadSectorRun(const CylHead& cylhead, Track& track, const VectorX<int>& indices,
+        const VectorX<int>& order, int n, int length);
     void ReadFirstGap(const CylHead& cylhead, Track& track);
 
     /* Here are the methods of multi track reading based on CmdTimedMultiScan
@@ -58,7 +60,8 @@ private:
         Track& track) const;
     void ReadSectors(const CylHead& cylhead, TimedAndPhysicalDualTrack& timedAndPhysicalDualTrack,
         const DeviceReadingPolicy& deviceReadingPolicy, const bool directlyIntoFinal);
-    bool ReadAndMergePhysicalTracks(const CylHead& cylhead, TimedAndPhysicalDualTrack& timedAndPhysicalDualTrack);
+    std::unique_ptr<MEMORY> ReadPhysicalTrack(const CylHead& cylhead);
+    bool MergePhysicalTrack(const CylHead& cylhead, const MEMORY& mem, TimedAndPhysicalDualTrack& timedAndPhysicalDualTrack);
 
     std::unique_ptr<FdrawcmdSys> m_fdrawcmd;
     Encoding m_lastEncoding{ Encoding::Unknown };
@@ -2,12 +2,14 @@
 
 #include "Disk.h"
 #include "HDD.h"
+#include "SAMCoupe.h"
 
 #include <memory>
 
 bool ReadRecord(const std::string& path, std::shared_ptr<Disk>& disk);
 bool WriteRecord(const std::string& path, std::shared_ptr<Disk>& disk);
 bool ReadRecord(HDD& hdd, int record, std::shared_ptr<Disk>& disk);
+bool ReadRecord(HDD& hdd, int record, const BDOS_CAPS& bdc, std::shared_ptr<Disk>& disk);
 bool WriteRecord(HDD& hdd, int record, std::shared_ptr<Disk>& disk, bool format = false);
 
 bool UnwrapCPM(std::shared_ptr<Disk>& cpm_disk, std::shared_ptr<Disk>& disk);
@@ -10,6 +10,7 @@
 #include <memory>
 #include <ostream>
 #include <sstream>
+#include <string>
 #include <vector>
 
 class posix_error : public std::system_error
@@ -381,12 +382,38 @@ struct LogHelper
 extern LogHelper cout;
 extern std::ofstream log;
 
+// Output of the current thread not yet written, while collected by ThreadLineOutput.
+extern thread_local std::string* thread_output;
+void add_thread_output(LogHelper& h, const std::string& text);
+
+// Collects what the current thread writes, and writes it a whole line at a
+// time, so the output of disks read by several threads at once doesn't mix.
+class ThreadLineOutput
+{
+public:
+    ThreadLineOutput();
+    ~ThreadLineOutput();
+    ThreadLineOutput(const ThreadLineOutput&) = delete;
+    ThreadLineOutput& operator=(const ThreadLineOutput&) = delete;
+
+private:
+    std::string m_pending{};
+};
+
 LogHelper& operator<<(LogHelper& h, colour c);
 LogHelper& operator<<(LogHelper& h, ttycmd cmd);
 
 template <typename T>
 LogHelper& operator<<(LogHelper& h, const T& t)
 {
+    if (thread_output)
+    {
+        std::ostringstream ss;
+        ss << t;
+        add_thread_output(h, ss.str());
+        return h;
+    }
+
     if (h.clearline)
     {
         h.clearline = false;
@@ -3,8 +3,9 @@
 #include "BitBuffer.h"
 #include "Options.h"
 
-#include <cstring>
 #include <algorithm>
+#include <array>
+#include <cstring>
 
 static auto& opt_a1sync = getOpt<int>("a1sync");
 static auto& opt_debug = getOpt<int>("debug");
@@ -51,6 +52,8 @@ BitBuffer::BitBuffer(DataRate datarate_, FluxDecoder& decoder)
         }
 
         add(bit ? 1 : 0);
+        if (bit)
+            add_jitter(decoder.jitter_percent());
 
         if (decoder.index())
             add_index();
@@ -62,11 +65,6 @@ const Data &BitBuffer::data() const
     return m_data;
 }
 
-bool BitBuffer::wrapped() const
-{
-    return m_wrapped || m_bitsize == 0;
-}
-
 int BitBuffer::size() const
 {
     return m_bitsize;
@@ -109,6 +107,11 @@ bool BitBuffer::index()
     return true;
 }
 
+const std::vector<int>& BitBuffer::indexes() const
+{
+    return m_indexes;
+}
+
 void BitBuffer::add_index()
 {
     m_indexes.push_back(m_bitpos);
@@ -159,69 +162,142 @@ void BitBuffer::add(uint8_t bit)
     m_bitsize = std::max(m_bitsize, ++m_bitpos);
 }
 
-void BitBuffer::remove(int num_bits)
+// Record the PLL phase error of the most recently added bit, keeping the
+// worst value seen in each group of 8 bits.
+void BitBuffer::add_jitter(int percent)
 {
-    assert(m_bitpos >= num_bits);
-    m_bitpos -= std::min(num_bits, m_bitpos);
-    m_bitsize = m_bitpos;
+    assert(m_bitpos > 0);
+    auto offset = (m_bitpos - 1) / 8;
+
+    if (offset >= m_jitter.size())
+        m_jitter.resize(m_data.size());
+
+    auto value = static_cast<uint8_t>(std::min(percent, 255));
+    m_jitter[offset] = std::max(m_jitter[offset], value);
 }
 
-uint8_t BitBuffer::read1()
+bool BitBuffer::has_jitter() const
 {
-    uint8_t bit = (m_data[m_bitpos / 8] >> (m_bitpos & 7)) & 1;
+    return !m_jitter.empty();
+}
 
-    if (++m_bitpos == m_bitsize)
-    {
-        m_bitpos = 0;
-        m_wrapped = true;
-    }
+int BitBuffer::jitter(int bitpos) const
+{
+    auto offset = bitpos / 8;
+    return (offset >= 0 && offset < m_jitter.size()) ? m_jitter[offset] : 0;
+}
 
-    return bit;
+// Mark a range of bits as weak, so they may read differently each time.
+void BitBuffer::set_weak(int bitpos, int bits)
+{
+    assert(bitpos >= 0 && bits >= 0);
+    if (!bits)
+        return;
+
+    if (m_weak.size() < m_data.size())
+        m_weak.resize(m_data.size());
+
+    auto end = std::min((bitpos + bits + 7) / 8, m_weak.size());
+    for (auto offset = bitpos / 8; offset < end; ++offset)
+        m_weak[offset] = 1;
 }
 
-uint8_t BitBuffer::read2()
+bool BitBuffer::has_weak() const
 {
-    return static_cast<uint8_t>((read1() << 1) | read1());
+    return !m_weak.empty();
 }
 
-uint8_t BitBuffer::read8_msb()
+bool BitBuffer::weak(int bitpos) const
 {
-    uint8_t byte = 0;
+    auto offset = bitpos / 8;
+    return offset >= 0 && offset < m_weak.size() && m_weak[offset];
+}
 
-    for (auto i = 0; i < 8; ++i)
-        byte = static_cast<uint8_t>((byte << 1) | read1());
+void BitBuffer::remove(int num_bits)
+{
+    assert(m_bitpos >= num_bits);
+    m_bitpos -= std::min(num_bits, m_bitpos);
+    m_bitsize = m_bitpos;
 
-    return byte;
+    // Drop weak marks on the removed bits, and the marks entirely if none are left.
+    auto weak_bytes = (m_bitsize + 7) / 8;
+    if (m_weak.size() > weak_bytes)
+        m_weak.resize(weak_bytes);
+    if (std::find(m_weak.begin(), m_weak.end(), 1) == m_weak.end())
+        m_weak.clear();
 }
 
-uint8_t BitBuffer::read8_lsb()
+uint8_t BitBuffer::read2()
 {
-    uint8_t byte = 0;
+    return static_cast<uint8_t>(read_bits(2));
+}
 
-    for (auto i = 0; i < 8; ++i)
-        byte |= (read1() << i);
+uint8_t BitBuffer::read8_msb()
+{
+    return static_cast<uint8_t>(read_bits(8));
+}
 
-    return byte;
+uint8_t BitBuffer::read8_lsb()
+{
+    return util::reverse_byte(static_cast<uint8_t>(read_bits(8)));
 }
 
 uint16_t BitBuffer::read16()
 {
-    uint16_t word = 0;
+    return static_cast<uint16_t>(read_bits(16));
+}
+
+uint32_t BitBuffer::read32()
+{
+    return read_bits(32);
+}
 
-    for (auto i = 0; i < 16; ++i)
-        word = static_cast<uint16_t>((word << 1) | read1());
+// Read up to 32 bits, returning the first bit read as the most significant.
+uint32_t BitBuffer::read_bits(int count)
+{
+    // Reads that wrap are done a bit at a time, to set the wrapped flag.
+    if (m_bitpos + count >= m_bitsize)
+    {
+        uint32_t bits = 0;
+        for (auto i = 0; i < count; ++i)
+            bits = (bits << 1) | read1();
+        return bits;
+    }
 
-    return word;
+    auto bits = peek_bits(count);
+    m_bitpos += count;
+    return bits;
 }
 
-uint32_t BitBuffer::read32()
+// Return the next bits as read_bits would, without moving the read position.
+uint32_t BitBuffer::peek_bits(int count) const
 {
-    uint32_t dword = 0;
+    assert(count >= 0 && count <= 32);
+    auto offset = m_bitpos / 8;
 
-    for (auto i = 0; i < 32; ++i)
-        dword = (dword << 1) | read1();
+    if (!count || m_bitpos + count >= m_bitsize || offset + 8 > m_data.size())
+    {
+        uint32_t bits = 0;
+        for (auto i = 0, pos = m_bitpos; i < count && m_bitsize; ++i)
+        {
+            bits = (bits << 1) | ((m_data[pos / 8] >> (pos & 7)) & 1);
+            if (++pos == m_bitsize)
+                pos = 0;
+        }
+        return bits;
+    }
 
-    return dword;
+    uint64_t word = 0;
+    for (auto i = 7; i >= 0; --i)
+        word = (word << 8) | m_data[offset + i];
+    auto lsb_first = static_cast<uint32_t>(word >> (m_bitpos & 7));
+
+    // Bits are stored LSB first, so reverse them to put the first bit on top.
+    auto msb_first = (static_cast<uint32_t>(util::reverse_byte(lsb_first & 0xff)) << 24) |
+        (static_cast<uint32_t>(util::reverse_byte((lsb_first >> 8) & 0xff)) << 16) |
+        (static_cast<uint32_t>(util::reverse_byte((lsb_first >> 16) & 0xff)) << 8) |
+        util::reverse_byte(lsb_first >> 24);
+    return msb_first >> (32 - count);
 }
 
 const uint8_t gcr5char[32] = {
@@ -231,10 +307,31 @@ const uint8_t gcr5char[32] = {
     000, 0x9, 0xa, 0xb, 000, 0xd, 0xe, 000, // 18-1F
 };
 
+// Decoded data byte for each 10-bit GCR code, with the number of invalid
+// 5-bit groups (treated as zero nibbles) in bits 8-9.
+static const std::array<uint16_t, 1024>& gcr10_table()
+{
+    static const auto table = []
+    {
+        auto nibble = [](int gcr5) { return (gcr5char[gcr5] || gcr5 == 0x0a) ? gcr5char[gcr5] : -1; };
+
+        std::array<uint16_t, 1024> t{};
+        for (auto gcr = 0; gcr < 1024; ++gcr)
+        {
+            auto hi = nibble(gcr >> 5), lo = nibble(gcr & 0x1f);
+            auto invalid = (hi < 0) + (lo < 0);
+            auto data = (std::max(hi, 0) << 4) | std::max(lo, 0);
+            t[gcr] = static_cast<uint16_t>((invalid << 8) | data);
+        }
+        return t;
+    }();
+
+    return table;
+}
+
 uint8_t BitBuffer::read_byte()
 {
     uint8_t data = 0;
-    uint16_t gcr = 0;
 
     switch (encoding)
     {
@@ -257,10 +354,7 @@ uint8_t BitBuffer::read_byte()
         break;
 
     case Encoding::Apple:
-        for (auto i = 0; i < 8; ++i)
-        {
-            data = static_cast<uint8_t>((data << 1) | read1());
-        }
+        data = static_cast<uint8_t>(read_bits(8));
         // Disk ][ keeps reading until bit 7 is 1
         for (; (data & 0x80) == 0;)
         {
@@ -270,24 +364,33 @@ uint8_t BitBuffer::read_byte()
 
     case Encoding::GCR:
     case Encoding::Victor:
-        for (auto i = 0; i < 10; ++i)
-        {
-            gcr = static_cast<uint16_t>((gcr << 1) | read1());
-        }
-        data = static_cast<uint8_t>((gcr5char[gcr >> 5] << 4) | gcr5char[gcr & 0x1f]);
+        data = static_cast<uint8_t>(gcr10_table()[read_bits(10)]);
         break;
 
     default:
-        for (auto i = 0; i < 8; ++i)
-        {
-            data = static_cast<uint8_t>((data << 1) | read1());
-        }
+        data = static_cast<uint8_t>(read_bits(8));
         break;
     }
 
     return data;
 }
 
+// Read GCR encoded bytes, returning the number of invalid 5-bit codes found.
+int BitBuffer::read_gcr(Data& buf)
+{
+    const auto& table = gcr10_table();
+    auto invalid = 0;
+
+    for (auto& b : buf)
+    {
+        auto entry = table[read_bits(10)];
+        b = static_cast<uint8_t>(entry);
+        invalid += entry >> 8;
+    }
+
+    return invalid;
+}
+
 int BitBuffer::track_bitsize() const
 {
     return m_indexes.size() ? m_indexes[0] : m_bitsize;
@@ -0,0 +1,77 @@
+// Bitstream self correlation for finding the revolution length of a track read
+
+#include "BitCorrelator.h"
+
+#include <cassert>
+#include <limits>
+
+constexpr int WORD_BIT_SIZE = std::numeric_limits<uint64_t>::digits;
+
+
+BitCorrelator::BitCorrelator(const uint8_t* bytes, int byteSize)
+    : m_words((byteSize + 7) / 8 + 1, 0), m_bitSize(byteSize * 8)
+{
+    for (auto i = 0; i < byteSize; i++)
+        m_words[i / 8] |= static_cast<uint64_t>(bytes[i]) << (WORD_BIT_SIZE - 8 - (i % 8) * 8);
+}
+
+BitCorrelator::BitCorrelator(const Data& bytes)
+    : BitCorrelator(bytes.data(), bytes.size())
+{
+}
+
+/*static*/ int BitCorrelator::PopCount(uint64_t bits)
+{
+#ifdef __GNUC__
+    return __builtin_popcountll(bits);
+#else
+    bits -= (bits >> 1) & 0x5555555555555555ull;
+    bits = (bits & 0x3333333333333333ull) + ((bits >> 2) & 0x3333333333333333ull);
+    bits = (bits + (bits >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return static_cast<int>((bits * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+uint64_t BitCorrelator::WordAtBit(int bitPosition) const
+{
+    const auto wordIndex = bitPosition / WORD_BIT_SIZE;
+    const auto bitShift = bitPosition % WORD_BIT_SIZE;
+    return bitShift == 0 ? m_words[wordIndex]
+        : (m_words[wordIndex] << bitShift) | (m_words[wordIndex + 1] >> (WORD_BIT_SIZE - bitShift));
+}
+
+int BitCorrelator::CountMatchingBits(int shift, int bitCount) const
+{
+    assert(shift >= 0 && bitCount >= 0 && shift + bitCount <= m_bitSize);
+
+    auto matchingBits = 0;
+    for (auto i = 0; i < bitCount; i += WORD_BIT_SIZE)
+    {
+        auto equalBits = ~(m_words[i / WORD_BIT_SIZE] ^ WordAtBit(i + shift));
+        const auto remainingBits = bitCount - i;
+        if (remainingBits < WORD_BIT_SIZE)
+            equalBits &= ~0ull << (WORD_BIT_SIZE - remainingBits);
+        matchingBits += PopCount(equalBits);
+    }
+    return matchingBits;
+}
+
+BitCorrelator::Correlation BitCorrelator::FindBestShift(int shiftMin, int shiftMax, int bitCount) const
+{
+    assert(shiftMin >= 0 && shiftMin <= shiftMax && shiftMax + bitCount <= m_bitSize);
+
+    Correlation best;
+    best.shift = shiftMin;
+    best.comparedBits = bitCount;
+    best.matchingBits = -1;
+    for (auto shift = shiftMin; shift <= shiftMax; shift++)
+    {
+        const auto matchingBits = CountMatchingBits(shift, bitCount);
+        if (matchingBits > best.matchingBits)
+        {
+            best.shift = shift;
+            best.matchingBits = matchingBits;
+        }
+    }
+    return best;
+}
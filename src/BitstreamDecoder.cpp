@@ -10,6 +10,7 @@
 //#include "TrackDataParser.h"
 #include "IBMPCBase.h"
 #include "JupiterAce.h"
+#include "WeakBitAnalyser.h"
 //#include "SpecialFormat.h"
 
 #include <algorithm>
@@ -221,6 +222,35 @@ void scan_bitstream(TrackData& trackdata)
 }
 
 
+// Bit i is set if bits i to i+len-1 are all set, for len up to 32.
+static uint64_t ones_runs(uint64_t bits, int len)
+{
+    for (auto have = 1; have < len; )
+    {
+        auto step = std::min(have, len - have);
+        bits &= bits >> step;
+        have += step;
+    }
+    return bits;
+}
+
+// Can the next 32 bits be consumed in one go, without reaching the end of the
+// buffer and without completing a sync run of the given length? The history
+// is the previous bits shifted in by the caller, with the most recent in bit 0.
+static bool skip_word_without_sync(BitBuffer& bitbuf, uint32_t& history, int sync_len)
+{
+    if (bitbuf.size() - bitbuf.tell() <= 32)
+        return false;
+
+    auto window = (static_cast<uint64_t>(history) << 32) | bitbuf.peek_bits(32);
+    if (ones_runs(window, sync_len) & 0xffffffff)
+        return false;
+
+    bitbuf.read_bits(32);
+    history = static_cast<uint32_t>(window);
+    return true;
+}
+
 /*
 GCR 5/3 encode/decode
 0xab, 0xad, 0xae, 0xaf, 0xb5, 0xb6, 0xb7, 0xba,
@@ -289,6 +319,27 @@ void scan_bitstream_apple(TrackData& trackdata)
         if (!track.size() && bitbuf.tell() > track.tracklen)
             break;
 
+        // Skip whole words that can't complete an address mark
+        if (!(opt_debug && opt_encoding == Encoding::Apple) &&
+            (track.size() || bitbuf.tell() + 32 <= track.tracklen) &&
+            bitbuf.size() - bitbuf.tell() > 32)
+        {
+            auto window = (static_cast<uint64_t>(dword) << 32) | bitbuf.peek_bits(32);
+            auto am_found = false;
+            for (auto i = 0; i < 32 && !am_found; ++i)
+            {
+                auto am = (window >> i) & 0xffffff;
+                am_found = am == 0xd5aa96 || am == 0xd5aaad;
+            }
+
+            if (!am_found)
+            {
+                bitbuf.read_bits(32);
+                dword = static_cast<uint32_t>(window);
+                continue;
+            }
+        }
+
         dword = (dword << 1) | bitbuf.read1();
         if (opt_debug && opt_encoding == Encoding::Apple)
         {
@@ -459,19 +510,16 @@ void scan_bitstream_apple(TrackData& trackdata)
 #endif
             }
 
-            // 6-and-2 de-nibblizing
-            for (auto byte = 0; byte < 256; byte++)
+            // 6-and-2 de-nibblizing, with each auxiliary byte holding the swapped
+            // low bit pairs for the same position in each third of the sector
+            static const uint8_t swap2[4] = { 0, 2, 1, 3 };
+            for (auto byte = 0; byte < 86; byte++)
             {
-                auto bits = 0;
-
-                if (byte < 86)
-                    bits = decdata[byte] & 3;
-                else if (byte < 172)
-                    bits = (decdata[byte - 86] >> 2) & 3;
-                else
-                    bits = (decdata[byte - 172] >> 4) & 3;
-
-                outdata[byte] = (decdata[byte + 86] << 2) | ((bits & 2) >> 1) | ((bits & 1) << 1);
+                auto aux = decdata[byte];
+                outdata[byte] = static_cast<uint8_t>((decdata[byte + 86] << 2) | swap2[aux & 3]);
+                outdata[byte + 86] = static_cast<uint8_t>((decdata[byte + 172] << 2) | swap2[(aux >> 2) & 3]);
+                if (byte + 172 < 256)
+                    outdata[byte + 172] = static_cast<uint8_t>((decdata[byte + 258] << 2) | swap2[(aux >> 4) & 3]);
             }
 
             if (opt_debug)
@@ -528,6 +576,9 @@ void scan_bitstream_gcr(TrackData& trackdata)
 
     while (!bitbuf.wrapped())
     {
+        if (!sync && !(opt_debug && opt_encoding == Encoding::GCR) && skip_word_without_sync(bitbuf, dword, 24))
+            continue;
+
         dword = (dword << 1) | bitbuf.read1();
 
         if (opt_debug && opt_encoding == Encoding::GCR)
@@ -681,9 +732,12 @@ void scan_bitstream_gcr(TrackData& trackdata)
 
             // Read the full data field and verify its checksum
             Data data(data_bytes);
-            bitbuf.read(data);
+            auto invalid = bitbuf.read_gcr(data);
             stored_cksum = data[256];
 
+            if (opt_debug && invalid)
+                util::cout << "  s_b_gcr " << invalid << " invalid GCR codes in sector " << sector.header.sector << "\n";
+
             // Truncate at the extent size, unless we're asked to keep overlapping sectors
             if (!opt_keepoverlap && extent_bytes < sector.size())
                 data.resize(extent_bytes);
@@ -1286,6 +1340,8 @@ void scan_bitstream_mfm_fm(TrackData& trackdata)
         if (opt_debug)
             util::cout << "  s_b_mfm_fm finding " << trackdata.cylhead << " sector " << sector.header.sector << ":\n";
 
+        WeakBitAnalyser weak_analyser(bitbuf);
+
         for (auto itData = data_fields.begin(); itData != data_fields.end(); ++itData)
         {
             const auto& dam_offset = itData->first;
@@ -1364,7 +1420,9 @@ void scan_bitstream_mfm_fm(TrackData& trackdata)
 
             // Read the full data field and check its CRC
             Data data(data_bytes);
+            auto data_offset = bitbuf.tell();
             bitbuf.read(data);
+            weak_analyser.add_copy(data_offset, shift, data);
             bool bad_crc = crc.add(data.data(), normal_bytes) != 0;
             if (opt_debug && bad_crc)
             {
@@ -1450,6 +1508,9 @@ void scan_bitstream_mfm_fm(TrackData& trackdata)
             if (!bad_crc || !chk8k_methods.empty())
                 break;
         }
+
+        // Compare the copies from each revolution to locate weak data.
+        weak_analyser.analyse(sector);
     }
 
     trackdata.add(std::move(track));
@@ -1778,6 +1839,9 @@ void scan_bitstream_victor(TrackData& trackdata)
 
     while (!bitbuf.wrapped())
     {
+        if (!sync && !(opt_debug && opt_encoding == Encoding::Victor) && skip_word_without_sync(bitbuf, dword, 10))
+            continue;
+
         dword = (dword << 1) | bitbuf.read1();
 
         if (opt_debug && opt_encoding == Encoding::Victor)
@@ -1934,7 +1998,7 @@ void scan_bitstream_victor(TrackData& trackdata)
 
             // Read the full data field and verify its checksum
             Data data(data_bytes);
-            bitbuf.read(data);
+            auto invalid = bitbuf.read_gcr(data);
 
             stored_cksum = bitbuf.read_byte();
             stored_cksum |= bitbuf.read_byte() << 8;
@@ -1952,7 +2016,7 @@ void scan_bitstream_victor(TrackData& trackdata)
             bool bad_crc = cksum != stored_cksum;
 
             if (opt_debug)
-                util::cout << util::fmt("  s_b_victor cksum s %2d disk:calc %04x:%04x\n", sector.header.sector, stored_cksum, cksum);
+                util::cout << util::fmt("  s_b_victor cksum s %2d disk:calc %04x:%04x invalid %d\n", sector.header.sector, stored_cksum, cksum, invalid);
 
             sector.add(std::move(data), bad_crc, IBM_DAM);
 
@@ -5,6 +5,10 @@
 #include "BitstreamTrackBuilder.h"
 #include "SpecialFormat.h"
 #include "IBMPC.h"
+#include "FluxTrackBuilder.h"
+
+#include <cstring>
+#include <limits>
 
 static auto& opt_gap3 = getOpt<int>("gap3");
 static auto& opt_force = getOpt<int>("force");
@@ -31,6 +35,8 @@ bool generate_special(TrackData& trackdata)
         trackdata.add(GenerateRainbowArtsTrack(trackdata.cylhead, track, weak_offset, weak_size));
     else if (IsKBIWeakSectorTrack(track, weak_offset, weak_size))
         trackdata.add(GenerateKBIWeakSectorTrack(trackdata.cylhead, track, weak_offset, weak_size));
+    else if (IsFluxWeakSectorTrack(track))
+        trackdata.add(GenerateFluxWeakSectorTrack(trackdata.cylhead, track));
     else if (IsLogoProfTrack(track))
         trackdata.add(GenerateLogoProfTrack(trackdata.cylhead, track));
     else if (IsOperaSoftTrack(track))
@@ -45,6 +51,31 @@ bool generate_special(TrackData& trackdata)
     return true;
 }
 
+// Mark the sector data bytes that differ between its copies as weak.
+static void set_weak_copy_differences(BitstreamTrackBuilder& bitbuf, const Sector& sector)
+{
+    const auto& data0 = sector.data_copy(0);
+    auto weak_begin = -1;
+
+    for (auto i = 0; i <= data0.size(); ++i)
+    {
+        auto differs = false;
+        for (auto copy = 1; i < data0.size() && copy < sector.copies() && !differs; ++copy)
+        {
+            const auto& data = sector.data_copy(copy);
+            differs = i >= data.size() || data[i] != data0[i];
+        }
+
+        if (differs && weak_begin < 0)
+            weak_begin = i;
+        else if (!differs && weak_begin >= 0)
+        {
+            bitbuf.setWeakData(weak_begin, i - weak_begin);
+            weak_begin = -1;
+        }
+    }
+}
+
 bool generate_simple(TrackData& trackdata)
 {
     bool first_sector = true;
@@ -96,6 +127,8 @@ bool generate_simple(TrackData& trackdata)
             else
             {
                 bitbuf.addSector(s, gap3);
+                if (s.copies() > 1 && (s.encoding == Encoding::MFM || s.encoding == Encoding::FM))
+                    set_weak_copy_differences(bitbuf, s);
             }
             break;
         default:
@@ -134,50 +167,131 @@ void generate_bitstream(TrackData& trackdata)
         throw util::exception("bitstream conversion not yet implemented for ", trackdata.cylhead);
 }
 
-void generate_flux(TrackData& trackdata)
+constexpr int WORD_BIT_SIZE = std::numeric_limits<uint64_t>::digits;
+
+// The bitstream bits of the word at a bit position multiple of 64, first bit lowest.
+static uint64_t bitstream_word(const Data& data, int bitpos)
+{
+    auto offset = bitpos / 8;
+    uint64_t word = 0;
+    if (offset + intsizeof(word) <= data.size())
+    {
+        std::memcpy(&word, data.data() + offset, sizeof(word));
+        return util::letoh(word);
+    }
+
+    for (auto i = data.size() - 1; i >= offset; --i)
+        word = (word << 8) | data[i];
+    return word;
+}
+
+// The word at a bit position multiple of 64, keeping only the bits in [begin,end).
+static uint64_t bitstream_word(const Data& data, int bitpos, int begin, int end)
+{
+    auto word = bitstream_word(data, bitpos);
+    if (begin > bitpos)
+        word &= ~0ull << (begin - bitpos);
+    if (end < bitpos + WORD_BIT_SIZE)
+        word &= ~(~0ull << (end - bitpos));
+    return word;
+}
+
+static int count_trailing_zeros(uint64_t word)
+{
+#ifdef __GNUC__
+    return __builtin_ctzll(word);
+#else
+    auto count = 0;
+    for (; !(word & 1); word >>= 1)
+        ++count;
+    return count;
+#endif
+}
+
+static int count_one_bits(uint64_t word)
 {
-    uint8_t last_bit{ 0 }, curr_bit{ 0 };
-    auto& bitbuf = trackdata.bitstream();
-    auto ns_per_bitcell = bitcell_ns(bitbuf.datarate);
-    bitbuf.seek(0);
+#ifdef __GNUC__
+    return __builtin_popcountll(word);
+#else
+    auto count = 0;
+    for (; word; word &= word - 1)
+        ++count;
+    return count;
+#endif
+}
 
-    uint32_t flux_time{ 0 };
-    FluxData flux_data{};
-    VectorX<uint32_t> flux_times{};
-    flux_times.reserve(bitbuf.size());
+/* Flux times for the one bits, with each transition emitted when the bit after
+ * it is read, as a bit-serial writer would. The final bit is therefore never
+ * emitted, and a transition just before an index falls after it. With write
+ * precompensation, a transition between a one and a zero bit is moved away
+ * from the neighbouring transition.
+ */
+FluxData generate_flux(const BitBuffer& bitbuf, int precomp_ns/* = 0*/)
+{
+    const auto& data = bitbuf.data();
+    const auto bitsize = bitbuf.size();
+    const auto ns_per_bitcell = static_cast<uint32_t>(bitcell_ns(bitbuf.datarate));
 
-    while (!bitbuf.wrapped())
+    auto bit = [&](int bitpos) {
+        return (bitpos >= 0) ? (data[bitpos / 8] >> (bitpos & 7)) & 1 : 0;
+    };
+
+    // Revolutions end where reading the bitstream reports an index, which
+    // is never at the end as the position has wrapped to the start by then.
+    auto next_index = [&](int bitpos) {
+        for (auto index : bitbuf.indexes())
+            if (index > bitpos)
+                return index;
+        return bitsize;
+    };
+
+    VectorX<int> rev_ends;
+    for (auto index = next_index(0); index < bitsize; index = next_index(index))
+        rev_ends.push_back(index);
+    rev_ends.push_back(bitsize);
+
+    FluxData flux_data;
+    auto prev_one = -2;
+    uint32_t flux_time_carry = 0;
+
+    for (auto rev = 0; rev < rev_ends.size(); ++rev)
     {
-        auto next_bit{ bitbuf.read1() };
+        // A one bit is emitted one bit later, so in the revolution current then.
+        auto begin = (rev > 0) ? rev_ends[rev - 1] - 1 : 0;
+        auto end = rev_ends[rev] - 1;
+        auto first_word = begin & ~(WORD_BIT_SIZE - 1);
+
+        auto ones = 0;
+        for (auto bitpos = first_word; bitpos < end; bitpos += WORD_BIT_SIZE)
+            ones += count_one_bits(bitstream_word(data, bitpos, begin, end));
 
-        flux_time += static_cast<uint32_t>(ns_per_bitcell);
-        if (curr_bit)
+        VectorX<uint32_t> flux_times;
+        flux_times.reserve(ones);
+
+        for (auto bitpos = first_word; bitpos < end; bitpos += WORD_BIT_SIZE)
         {
-            if (trackdata.cylhead.cyl < 40)
-            {
-                flux_times.push_back(flux_time);
-                flux_time = 0;
-            }
-            else
+            for (auto word = bitstream_word(data, bitpos, begin, end); word; word &= word - 1)
             {
-                auto pre_comp_ns{ (last_bit == next_bit) ? 0 : (last_bit ? +240 : -240) };
+                auto one = bitpos + count_trailing_zeros(word);
+                auto flux_time = static_cast<uint32_t>(one - prev_one) * ns_per_bitcell + flux_time_carry;
+
+                auto last_bit = bit(one - 1);
+                auto pre_comp_ns = (last_bit == bit(one + 1)) ? 0 : (last_bit ? +precomp_ns : -precomp_ns);
                 flux_times.push_back(flux_time + pre_comp_ns);
-                flux_time = 0 - pre_comp_ns;
+                flux_time_carry = 0 - pre_comp_ns;
+                prev_one = one;
             }
         }
 
-        last_bit = curr_bit;
-        curr_bit = next_bit;
-
-        if (bitbuf.index())
-        {
+        if (rev + 1 < rev_ends.size() || flux_data.empty() || !flux_times.empty())
             flux_data.push_back(std::move(flux_times));
-            flux_times.clear();
-        }
     }
 
-    if (flux_data.empty() || !flux_times.empty())
-        flux_data.push_back(std::move(flux_times));
+    return flux_data;
+}
 
-    trackdata.add(std::move(flux_data), true);
+void generate_flux(TrackData& trackdata)
+{
+    auto precomp_ns = (trackdata.cylhead.cyl < 40) ? 0 : FluxTrackBuilder::PRECOMP_NS;
+    trackdata.add(generate_flux(trackdata.bitstream(), precomp_ns), true);
 }
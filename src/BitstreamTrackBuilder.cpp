@@ -63,6 +63,18 @@ void BitstreamTrackBuilder::justAddedImportantBits()
     m_afterLastImportantRawBitPosition = m_buffer.tell();
 }
 
+void BitstreamTrackBuilder::justAddedDataAM()
+{
+    m_dataOffset = m_buffer.tell();
+}
+
+// Mark a byte range of the most recently added sector data as weak.
+void BitstreamTrackBuilder::setWeakData(int offset, int length)
+{
+    m_buffer.set_weak(m_dataOffset + DataBytePositionAsBitOffset(offset, m_buffer.encoding),
+        DataBytePositionAsBitOffset(length, m_buffer.encoding));
+}
+
 void BitstreamTrackBuilder::cutExcessUnimportantDataBitsAtTheEnd(const int trackLen)
 {
     const auto currentBitpos = m_buffer.tell();
@@ -42,6 +42,8 @@
 
 static auto& opt_force = getOpt<int>("force");
 
+static const int DIRECT_IO_BYTES = 8 * 1024 * 1024; // uncached request size, as there's no read-ahead
+
 // ToDo: split conditional code into separate classes
 
 BlockDevice::BlockDevice()
@@ -56,10 +58,15 @@ BlockDevice::~BlockDevice()
 
 bool BlockDevice::Open(const std::string& path, bool uncached)
 {
-    auto flags = O_BINARY | (uncached ? O_DIRECT : 0);
     // Open as read-write, falling back on read-only
-    if ((h = open(path.c_str(), O_RDWR | flags)) == -1 &&
-        (h = open(path.c_str(), O_RDONLY | flags)) == -1)
+    auto open_rw = [&](int flags) {
+        return (h = open(path.c_str(), O_RDWR | flags)) != -1 ||
+            (h = open(path.c_str(), O_RDONLY | flags)) != -1;
+    };
+
+    // Direct I/O is rejected by some drivers and filesystems, which fall back on cached I/O
+    direct_io = uncached && O_DIRECT != 0 && open_rw(O_BINARY | O_DIRECT);
+    if (!direct_io && !open_rw(O_BINARY))
     {
         // Win32 has a second attempt at opening, via SAMdiskHelper
 #ifdef _WIN32
@@ -180,14 +187,7 @@ bool BlockDevice::Open(const std::string& path, bool uncached)
 #endif // WIN32
     else
     {
-        if (IsFile(path))
-        {
-#ifdef _WIN32
-            SetLastError(ERROR_ACCESS_DENIED);
-#endif
-            return false;
-        }
-
+        // Plain file images, accepted by IsFileHDD, have no device size so use the file size
         sector_size = SECTOR_SIZE;
         total_bytes = FileSize(path) - data_offset;
         total_sectors = static_cast<unsigned>(total_bytes / sector_size);
@@ -197,6 +197,19 @@ bool BlockDevice::Open(const std::string& path, bool uncached)
     if (!total_sectors)
         return false;
 
+    // Uncached transfers use larger requests, and at least the device's optimal size
+    uncached_io = uncached;
+    if (uncached)
+        io_sectors = DIRECT_IO_BYTES / sector_size;
+#ifdef BLKIOOPT
+    unsigned int io_opt = 0;
+    if (ioctl(h, BLKIOOPT, &io_opt) == 0)
+        io_sectors = std::max(io_sectors, static_cast<int>(io_opt) / sector_size);
+#endif
+#ifdef HAVE_POSIX_FADVISE
+    posix_fadvise(h, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
     // Read the real identify data if possible
     if (ReadIdentifyData(hdev, sIdentify))
         SetIdentifyData(&sIdentify);
@@ -0,0 +1,279 @@
+// CRC-32 implementation, using slicing-by-8 tables with a PCLMULQDQ folding
+// path on x86 CPUs that support it.
+//
+// The folding constants and combine method follow zlib and Chromium's
+// crc32_simd, based on Intel's "Fast CRC Computation for Generic Polynomials
+// Using PCLMULQDQ Instruction" paper.
+
+#include "CRC32.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_CRC32_CLMUL
+#define CRC32_CLMUL_TARGET __attribute__((target("pclmul,sse2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define HAVE_CRC32_CLMUL
+#define CRC32_CLMUL_TARGET
+#include <intrin.h>
+#endif
+
+constexpr size_t CLMUL_MIN_LENGTH = 64;
+
+std::array<std::array<uint32_t, 256>, 8> CRC32::s_crc_lookup;
+std::array<uint32_t, 32> CRC32::s_x2n_lookup;
+bool CRC32::s_have_clmul = false;
+std::once_flag CRC32::flag;
+
+
+#ifdef HAVE_CRC32_CLMUL
+static bool cpu_has_clmul()
+{
+#ifdef _MSC_VER
+    int info[4]{};
+    __cpuid(info, 1);
+    return (info[2] & (1 << 1)) != 0;   // ECX.PCLMULQDQ
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("pclmul") != 0;
+#endif
+}
+
+// Fold a multiple of 16 bytes (at least 64) into the (non-inverted) CRC.
+CRC32_CLMUL_TARGET
+static uint32_t crc32_clmul(const uint8_t* pb, size_t len, uint32_t crc)
+{
+    alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+    alignas(16) static const uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+    alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+    alignas(16) static const uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb + 0x00));
+    x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb + 0x10));
+    x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb + 0x20));
+    x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+    pb += 64;
+    len -= 64;
+
+    // Fold 4 blocks of 16 bytes in parallel.
+    while (len >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb + 0x00));
+        y6 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb + 0x10));
+        y7 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb + 0x20));
+        y8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        pb += 64;
+        len -= 64;
+    }
+
+    // Fold the 4 blocks into one.
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+    for (auto x : { x2, x3, x4 })
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x), x5);
+    }
+
+    // Fold any remaining single blocks of 16 bytes.
+    while (len >= 16)
+    {
+        x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pb));
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        pb += 16;
+        len -= 16;
+    }
+
+    // Fold 128 bits to 64 bits.
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits.
+    x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(x1, 4)));
+}
+#endif // HAVE_CRC32_CLMUL
+
+
+CRC32::CRC32(uint32_t init_/* = INIT_CRC*/)
+{
+    std::call_once(flag, init_crc_tables);
+    init(init_);
+}
+
+CRC32::CRC32(const Data& data, uint32_t init/* = INIT_CRC*/)
+    : CRC32(data.data(), data.size(), init)
+{
+}
+
+/*static*/ void CRC32::init_crc_tables()
+{
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        auto crc = i;
+        for (int j = 0; j < 8; ++j)
+            crc = (crc >> 1) ^ ((crc & 1) ? POLYNOMIAL : 0);
+
+        s_crc_lookup[0][i] = crc;
+    }
+
+    // Each further table advances the previous entry by one zero byte.
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        for (size_t t = 1; t < s_crc_lookup.size(); ++t)
+        {
+            auto prev = s_crc_lookup[t - 1][i];
+            s_crc_lookup[t][i] = (prev >> 8) ^ s_crc_lookup[0][prev & 0xff];
+        }
+    }
+
+    // x^(2^n) modulo the polynomial, for combining.
+    uint32_t p = 1U << 30;  // x^1
+    for (auto& x2n : s_x2n_lookup)
+    {
+        x2n = p;
+        p = multmodp(p, p);
+    }
+
+#ifdef HAVE_CRC32_CLMUL
+    s_have_clmul = cpu_has_clmul();
+#endif
+}
+
+CRC32::operator uint32_t () const
+{
+    return m_crc;
+}
+
+void CRC32::init(uint32_t init_crc/* = INIT_CRC*/)
+{
+    m_crc = init_crc;
+}
+
+uint32_t CRC32::add(uint8_t byte)
+{
+    auto crc = ~m_crc;
+    crc = (crc >> 8) ^ s_crc_lookup[0][(crc ^ byte) & 0xff];
+    m_crc = ~crc;
+    return m_crc;
+}
+
+uint32_t CRC32::add(const Data& data)
+{
+    return add(data.data(), data.size());
+}
+
+void CRC32::add_block(const uint8_t* pb, size_t len)
+{
+    auto crc = ~m_crc;
+
+#ifdef HAVE_CRC32_CLMUL
+    if (s_have_clmul && len >= CLMUL_MIN_LENGTH)
+    {
+        auto chunk = len & ~static_cast<size_t>(15);
+        crc = crc32_clmul(pb, chunk, crc);
+        pb += chunk;
+        len -= chunk;
+    }
+#endif
+
+    // Slicing-by-8, assembling the words a byte at a time to stay endian neutral.
+    const auto& t = s_crc_lookup;
+    for (; len >= 8; pb += 8, len -= 8)
+    {
+        auto one = crc ^ (static_cast<uint32_t>(pb[0]) | (static_cast<uint32_t>(pb[1]) << 8) |
+            (static_cast<uint32_t>(pb[2]) << 16) | (static_cast<uint32_t>(pb[3]) << 24));
+        auto two = static_cast<uint32_t>(pb[4]) | (static_cast<uint32_t>(pb[5]) << 8) |
+            (static_cast<uint32_t>(pb[6]) << 16) | (static_cast<uint32_t>(pb[7]) << 24);
+
+        crc = t[7][one & 0xff] ^ t[6][(one >> 8) & 0xff] ^
+            t[5][(one >> 16) & 0xff] ^ t[4][one >> 24] ^
+            t[3][two & 0xff] ^ t[2][(two >> 8) & 0xff] ^
+            t[1][(two >> 16) & 0xff] ^ t[0][two >> 24];
+    }
+
+    while (len-- > 0)
+        crc = (crc >> 8) ^ t[0][(crc ^ *pb++) & 0xff];
+
+    m_crc = ~crc;
+}
+
+// Multiply a and b modulo the polynomial, in the reflected bit order.
+/*static*/ uint32_t CRC32::multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m = 1U << 31, p = 0;
+    for (;;)
+    {
+        if (a & m)
+        {
+            p ^= b;
+            if ((a & (m - 1)) == 0)
+                break;
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ POLYNOMIAL : b >> 1;
+    }
+    return p;
+}
+
+// x^(n * 2^k) modulo the polynomial.
+/*static*/ uint32_t CRC32::x2nmodp(uint64_t n, unsigned k)
+{
+    uint32_t p = 1U << 31;  // x^0
+    while (n)
+    {
+        if (n & 1)
+            p = multmodp(s_x2n_lookup[k & 31], p);
+        n >>= 1;
+        k++;
+    }
+    return p;
+}
+
+/*static*/ uint32_t CRC32::combine(uint32_t crc1, uint32_t crc2, uint64_t len2)
+{
+    std::call_once(flag, init_crc_tables);
+    return multmodp(x2nmodp(len2, 3), crc1) ^ crc2;
+}
+
+uint32_t CRC32::combine(uint32_t crc2, uint64_t len2)
+{
+    m_crc = combine(m_crc, crc2, len2);
+    return m_crc;
+}
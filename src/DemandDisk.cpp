@@ -7,6 +7,8 @@
 constexpr int DemandDisk::FIRST_READ_REVS;
 constexpr int DemandDisk::REMAIN_READ_REVS;
 
+static auto& opt_adaptive_retries = getOpt<bool>("adaptive_retries");
+static auto& opt_debug = getOpt<int>("debug");
 static auto& opt_rescans = getOpt<RetryPolicy>("rescans");
 static auto& opt_retries = getOpt<RetryPolicy>("retries");
 
@@ -50,12 +52,26 @@ TrackData& DemandDisk::readNC(const CylHead& cylhead, bool uncached,
         // If the disk supports rescans we won't duplicate them.
         auto rescans = supports_rescans() ? 0 : opt_rescans;
         rescans.wasChange = track.size() > 0;
+        auto retries_done = 0;
 
         // Consider rescans and error retries.
-        // If no more rescans are required, stop when there's nothing to fix.
-        while (rescans.HasMoreRetry() || (retries.HasMoreRetry() &&
-            !track.has_all_stable_data(deviceReadingPolicy.SkippableSectors())))
+        // If no more rescans are required, stop when there's nothing to fix,
+        // or with adaptive retries when fixing looks hopeless.
+        const auto more_retries_wanted = [&]() {
+            if (!retries.HasMoreRetry() || track.has_all_stable_data(deviceReadingPolicy.SkippableSectors()))
+                return false;
+            if (opt_adaptive_retries && !m_retry_learner.WorthRetrying(cylhead, RetryLearner::WHOLE_TRACK, retries_done))
+            {
+                if (opt_debug)
+                    util::cout << "adaptive retries: giving up " << cylhead << " after " << retries_done << " retries\n";
+                return false;
+            }
+            return true;
+        };
+        while (rescans.HasMoreRetry() || more_retries_wanted())
         {
+            const auto is_retry = !track.has_all_stable_data(deviceReadingPolicy.SkippableSectors());
+            auto improved = false;
             // Do not seek at second, third, etc. loading.
             auto rescan_trackdata = load(cylhead, false, -1, deviceReadingPolicy);
             auto& rescan_track = rescan_trackdata.track();
@@ -68,6 +84,13 @@ TrackData& DemandDisk::readNC(const CylHead& cylhead, bool uncached,
             {
                 std::swap(trackdata, rescan_trackdata);
                 rescans.wasChange = true;
+                improved = true;
+            }
+
+            if (opt_adaptive_retries && is_retry)
+            {
+                m_retry_learner.Record(cylhead, RetryLearner::WHOLE_TRACK, improved);
+                retries_done++;
             }
 
             // Flux reads include 5 revolutions, others just 1
@@ -351,6 +351,18 @@ const Sector* Disk::find_ignoring_size(const Header& header)
  * Merge: store src track in loaded dst track.
  * Repair: repair loaded dst track by src track.
  */
+// Make the stable sectors of the dst track skippable when reading the src track.
+// Return false if the dst track already contains all wanted sector ids (not empty).
+static bool SkipStableSectors(const Track& dst_track, const DeviceReadingPolicy& deviceReadingPolicy,
+                              DeviceReadingPolicy& deviceReadingPolicyLocal)
+{
+    deviceReadingPolicyLocal.SetSkippableSectors(deviceReadingPolicy.SkippableSectors());
+    deviceReadingPolicyLocal.AddSkippableSectors(dst_track.stable_sectors());
+    // If no looking for possible sectors then the track does not need repairing
+    // when containing all wanted sector ids (thus those are skippable).
+    return deviceReadingPolicyLocal.WantMoreSectors();
+}
+
 /*static*/ int Disk::TransferTrack(Disk& src_disk, const CylHead& cylhead,
                                    Disk& dst_disk, ScanContext& context,
                                    TransferMode transferMode, bool uncached/* = false*/,
@@ -388,11 +400,7 @@ const Sector* Disk::find_ignoring_size(const Header& header)
             // If repair mode and user specified skip_stable_sectors then skip processing those.
             if (skip_stable_sectors)
             {
-                deviceReadingPolicyLocal.SetSkippableSectors(deviceReadingPolicy.SkippableSectors());
-                deviceReadingPolicyLocal.AddSkippableSectors(dst_track.stable_sectors());
-                // If repair mode and user specified skip_stable_sectors and no looking for possible sectors
-                // then do not repair track already containing all wanted sector ids (not empty) (thus those are skippable).
-                if (!deviceReadingPolicyLocal.WantMoreSectors())
+                if (!SkipStableSectors(dst_track, deviceReadingPolicy, deviceReadingPolicyLocal))
                     break;
                 if (opt_verbose && !deviceReadingPolicyLocal.SkippableSectors().empty())
                 {
@@ -465,6 +473,40 @@ const Sector* Disk::find_ignoring_size(const Header& header)
     return trackFixesNumber;
 }
 
+/* Read the src tracks which TransferTrack will read first, so it finds them in
+ * the cache. The tracks are read in serpentine order, continuing the previous
+ * call's sweep direction, so the head of a device does not seek back across the
+ * disk for each disk round. The transfer itself and its output keep their order.
+ * The tracks to skip and the progress are reported through the optional callbacks.
+ */
+/*static*/ void Disk::PrefetchTransferTracks(Disk& src_disk, const Range& range, Disk& dst_disk,
+                                             TransferMode transferMode, const DeviceReadingPolicy& deviceReadingPolicy,
+                                             bool cyls_first, bool& downwards,
+                                             const std::function<bool(const CylHead& cylhead)>& is_track_skipped/* = nullptr*/,
+                                             const std::function<void(const CylHead& cylhead)>& on_track_read/* = nullptr*/)
+{
+    range.each_serpentine([&](const CylHead& cylhead) {
+        if (is_track_skipped && is_track_skipped(cylhead))
+            return;
+        // The same skipping and reading policy as the first reading in TransferTrack.
+        if (opt_minimal && !IsTrackUsed(cylhead.cyl, cylhead.head))
+            return;
+
+        DeviceReadingPolicy deviceReadingPolicyLocal{deviceReadingPolicy.WantedSectorHeaderSectors(), deviceReadingPolicy.LookForPossibleSectors()};
+        if (transferMode == Repair && opt_skip_stable_sectors)
+        {
+            auto dst_track = dst_disk.read_track(cylhead);
+            NormaliseTrack(cylhead, dst_track);
+            if (!SkipStableSectors(dst_track, deviceReadingPolicy, deviceReadingPolicyLocal))
+                return;
+        }
+        MessageCPP(msgStatus, "Reading disk", cylhead);
+        src_disk.read(cylhead * opt_step, false, -1, deviceReadingPolicyLocal);
+        if (on_track_read)
+            on_track_read(cylhead);
+    }, cyls_first, downwards);
+}
+
 bool Disk::WarnIfFileSystemFormatDiffers() const
 {
     const auto fileSystem = GetFileSystem();
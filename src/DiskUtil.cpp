@@ -475,6 +475,33 @@ bool NormaliseTrack(const CylHead& cylhead, Track& track)
         }
     }
 
+    // Add a second copy to weak sectors found by flux analysis whose revolutions happened to agree.
+    if (opt_fix != 0)
+    {
+        for (auto& sector : track)
+        {
+            if (sector.copies() != 1 || sector.weak_regions.empty() || !sector.has_baddatacrc())
+                continue;
+
+            // Are we to add the missing weak sector?
+            if (opt_fix == 1)
+            {
+                auto data = sector.data_copy();
+                for (const auto& region : sector.weak_regions)
+                {
+                    for (i = region.Start(); i <= region.End() && i < data.size(); ++i)
+                        data[i] = ~data[i];
+                }
+                sector.add(std::move(data), true);
+
+                Message(msgFix, "added second copy of weak sector %s from flux timing", strCHR(cylhead.cyl, cylhead.head, sector.header.sector).c_str());
+                changed = true;
+            }
+            else
+                Message(msgWarning, "missing multiple copies of weak sector %s found from flux timing", strCHR(cylhead.cyl, cylhead.head, sector.header.sector).c_str());
+        }
+    }
+
     // Check for missing OperaSoft 32K sector (CPDRead dumps).
     if (opt_fix != 0 && cylhead.cyl == 40 && track.size() == 9)
     {
@@ -6,6 +6,7 @@
 #include "Options.h"
 
 #include <cassert>
+#include <cstdlib>
 #include <algorithm>
 
 static auto& opt_pllphase = getOpt<int>("pllphase");
@@ -38,6 +39,12 @@ int FluxDecoder::flux_count() const
     return count;
 }
 
+// Phase error of the most recent 1 bit, as a percentage of the current clock.
+int FluxDecoder::jitter_percent() const
+{
+    return m_jitter_percent;
+}
+
 bool FluxDecoder::index()
 {
     auto ret = m_index;
@@ -77,6 +84,8 @@ int FluxDecoder::next_bit()
         return 0;
     }
 
+    m_jitter_percent = std::abs(m_flux) * 100 / m_clock;
+
     // PLL: Adjust clock frequency according to phase mismatch
     if (m_clocked_zeros <= 3)
     {
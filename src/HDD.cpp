@@ -4,17 +4,31 @@
 #include "PlatformConfig.h" // For disabling read, write, close deprecation.
 #endif
 #include "HDD.h"
+#include "FileIO.h"
 #include "Options.h"
 #include "BlockDevice.h"
 #include "HDFHDD.h"
+#include "HddManifest.h"
+#include "ThreadPool.h"
 #include "Util.h"
 
+#include <cerrno>
 #include <cstring>
 #include <algorithm>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <sys/stat.h>
 
 #define SECTOR_BLOCK    2048    // access CF/HDD devices in 1MB chunks
+#define COPY_BUFFERS    4       // blocks in flight between the copy reader and writer
+#define SPARSE_CHUNK    4096    // bytes checked for zeros at a time, a typical filesystem block
 
 static auto& opt_byteswap = getOpt<int>("byteswap");
+static auto& opt_directio = getOpt<int>("directio");
+static auto& opt_hddblock = getOpt<int>("hddblock");
+static auto& opt_sparse = getOpt<int>("sparse");
 static auto& opt_nocfa = getOpt<int>("nocfa");
 static auto& opt_noidentify = getOpt<int>("noidentify");
 
@@ -44,7 +58,7 @@ static auto& opt_noidentify = getOpt<int>("noidentify");
     else if (HDFHDD::IsRecognised(path))
         hdd.reset(new HDFHDD());
 
-    if (hdd && !hdd->Open(open_path))
+    if (hdd && !hdd->Open(open_path, opt_directio != 0))
         hdd.reset();
 
     return hdd;
@@ -58,6 +72,8 @@ void HDD::Reset()
     cyls = heads = sectors = 0;
     total_sectors = total_bytes = 0;
     sector_size = data_offset = 0;
+    io_sectors = 0;
+    uncached_io = direct_io = false;
 
     sIdentify = {};
 
@@ -113,7 +129,11 @@ int HDD::Read(void* pv, int sectors_, bool byte_swap) const
 {
     unsigned want = sectors_ * sector_size;
     auto n = read(h, pv, want);
+    if (n < 0 && errno == EINVAL && EndDirectIO())
+        n = read(h, pv, want);
     if (n < 0) n = 0;
+    if (n > 0 && uncached_io && !direct_io)
+        DropCachedData(n);
     if (byte_swap) ByteSwap(pv, n);
     return n / sector_size;
 }
@@ -123,11 +143,49 @@ int HDD::Write(void* pv, int sectors_, bool byte_swap)
     unsigned have = sectors_ * sector_size;
     if (byte_swap) ByteSwap(pv, have);
     auto n = write(h, pv, have);
+    if (n < 0 && errno == EINVAL && EndDirectIO())
+        n = write(h, pv, have);
     if (n < 0) n = 0;
     if (byte_swap) ByteSwap(pv, have);
     return n / sector_size;
 }
 
+// Direct I/O rejects buffers and offsets not aligned to the logical block size,
+// so switch to cached I/O for the rest of the transfer.
+bool HDD::EndDirectIO() const
+{
+#if defined(F_GETFL) && defined(F_SETFL)
+    if (!direct_io)
+        return false;
+
+    direct_io = false;
+    auto flags = fcntl(h, F_GETFL);
+    return flags != -1 && fcntl(h, F_SETFL, flags & ~O_DIRECT) == 0;
+#else
+    return false;
+#endif
+}
+
+// Ask the OS to drop the data just read from its cache.
+void HDD::DropCachedData(int64_t len) const
+{
+#ifdef HAVE_POSIX_FADVISE
+    posix_fadvise(h, lseek(h, 0, SEEK_CUR) - len, len, POSIX_FADV_DONTNEED);
+#else
+    (void)len;
+#endif
+}
+
+// Sectors per block for copying, the larger of the preferred request sizes.
+int HDD::CopyBlockSectors(const HDD* phSrc_) const
+{
+    if (opt_hddblock)
+        return opt_hddblock;
+
+    auto block_sectors = std::max(SECTOR_BLOCK, io_sectors);
+    return phSrc_ ? std::max(block_sectors, phSrc_->io_sectors) : block_sectors;
+}
+
 
 void HDD::SetIdentifyData(const IDENTIFYDEVICE* pIdentify_)
 {
@@ -231,58 +289,322 @@ bool HDD::SafetyCheck()
 }
 
 
-bool HDD::Copy(HDD* phSrc_, int64_t uSectors_, int64_t uSrcOffset_/*=0*/, int64_t uDstOffset_/*=0*/, int64_t uTotal_/*=0*/, const char* pcszAction_)
+namespace
+{
+// A block of sectors read for copying, or the end of the copy if it has none.
+struct CopyBlock
+{
+    int64_t pos = 0;
+    int sectors = 0;
+    MEMORY* mem = nullptr;
+    std::shared_future<void> checksummed{};
+};
+
+// Blocks passed in order from one copying thread to the other.
+class CopyBlockQueue
+{
+public:
+    void push(const CopyBlock& block)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_blocks.push(block);
+        }
+        m_cv.notify_one();
+    }
+
+    // Wait for the next block, or return one without a buffer once closed and empty.
+    CopyBlock pop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&] { return !m_blocks.empty() || m_closed; });
+        if (m_blocks.empty())
+            return {};
+        auto block = m_blocks.front();
+        m_blocks.pop();
+        return block;
+    }
+
+    // No more blocks will be pushed, so release any thread waiting for one.
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+        }
+        m_cv.notify_all();
+    }
+
+private:
+    std::mutex m_mutex{};
+    std::condition_variable m_cv{};
+    std::queue<CopyBlock> m_blocks{};
+    bool m_closed = false;
+};
+
+// Closes a queue when leaving scope, however that happens.
+class CopyBlockQueueCloser
 {
-    MEMORY mem(SECTOR_BLOCK * sector_size);
+public:
+    explicit CopyBlockQueueCloser(CopyBlockQueue& queue) : m_queue(queue) {}
+    CopyBlockQueueCloser(const CopyBlockQueueCloser&) = delete;
+    CopyBlockQueueCloser& operator=(const CopyBlockQueueCloser&) = delete;
+    ~CopyBlockQueueCloser() { m_queue.close(); }
+
+private:
+    CopyBlockQueue& m_queue;
+};
+
+// Whether the handle is a regular file, which can leave holes, rather than a device.
+bool IsRegularFile(int h)
+{
+    struct stat st {};
+    return fstat(h, &st) == 0 && (st.st_mode & S_IFMT) == S_IFREG;
+}
+
+int64_t FileEnd(int h)
+{
+#ifdef _WIN32
+    return _lseeki64(h, 0, SEEK_END);
+#else
+    return lseek(h, 0, SEEK_END);
+#endif
+}
+
+bool ExtendFile(int h, int64_t size)
+{
+#ifdef _WIN32
+    return _chsize_s(h, size) == 0;
+#else
+    return ftruncate(h, size) == 0;
+#endif
+}
+} // namespace
+
+bool HDD::Copy(HDD* phSrc_, int64_t uSectors_, int64_t uSrcOffset_/*=0*/, int64_t uDstOffset_/*=0*/, int64_t uTotal_/*=0*/, const char* pcszAction_, HddManifest* manifest/*=nullptr*/)
+{
+    auto block_sectors = CopyBlockSectors(phSrc_);
 
     if (!uTotal_) uTotal_ = uSectors_;
 
-    for (int64_t uPos = 0;;)
+    // The source is read in a separate thread, so it reads the next blocks while this one writes.
+    std::unique_ptr<MEMORY> buffers[COPY_BUFFERS];
+    CopyBlockQueue free_blocks, read_blocks;
+    for (auto& mem : buffers)
     {
-        // Sync source and destinations
-        if (phSrc_) phSrc_->Seek(uSrcOffset_ + uPos);
-        Seek(uDstOffset_ + uPos);
+        mem.reset(new MEMORY(block_sectors * sector_size));
+        free_blocks.push({ 0, 0, mem.get() });
+    }
+
+    // Manifest checksums are calculated by a pool of threads, each block before its buffer is reused.
+    // The pool is declared after the buffers, so it finishes with them before they are freed.
+    std::unique_ptr<ThreadPool> checksum_pool;
+    if (manifest)
+        checksum_pool.reset(new ThreadPool());
+
+    auto reader = std::async(std::launch::async, [&]() {
+        int64_t uPos = 0;
+        try
+        {
+            for (;;)
+            {
+                auto block = free_blocks.pop();
+                if (!block.mem)
+                    break;
+
+                auto uBlock = static_cast<int>(std::min(uSectors_ - uPos, static_cast<int64_t>(block_sectors)));
+                if (uBlock <= 0)
+                    break;
+
+                // Read from source disk, or leave the zero-filled buffer for no source
+                auto uRead = uBlock;
+                if (phSrc_)
+                {
+                    phSrc_->Seek(uSrcOffset_ + uPos);
+                    uRead = phSrc_->Read(*block.mem, uBlock);
+                    if (uRead != uBlock)
+                    {
+                        Message(msgStatus, "Read error at sector %lu: %s", uSrcOffset_ + uPos + uRead, LastError());
+
+                        // Clear the bad block, but include it in the read data
+                        memset(*block.mem + (uRead * sector_size), 0, sector_size);
+                        ++uRead;
+                    }
+                }
+
+                // Forced byte-swapping?
+                if (opt_byteswap)
+                    ByteSwap(*block.mem, uRead * sector_size);
+
+                block.pos = uPos;
+                block.sectors = uRead;
+                if (manifest)
+                {
+                    auto sector = uDstOffset_ + uPos;
+                    const uint8_t* pb = *block.mem;
+                    block.checksummed = checksum_pool->enqueue([manifest, sector, pb, uRead]() {
+                        manifest->AddSectors(sector, pb, uRead);
+                        }).share();
+                }
+                read_blocks.push(block);
+                uPos += uRead;
+            }
+        }
+        catch (...)
+        {
+            read_blocks.push({ uPos, 0, nullptr });
+            throw;
+        }
+        read_blocks.push({ uPos, 0, nullptr });
+    });
+
+    // If writing ends early, through an exception, stop the reader waiting for a free buffer,
+    // before the reader future is destroyed waiting for it.
+    CopyBlockQueueCloser close_free_blocks(free_blocks);
+
+    // Write a run of sectors to the target disk, skipping past any write errors
+    auto write_run = [&](int64_t uPos, uint8_t* pb, int uSectors) {
+        for (auto uDone = 0; uDone < uSectors; )
+        {
+            Seek(uDstOffset_ + uPos + uDone);
+            auto uWritten = Write(pb + (uDone * sector_size), uSectors - uDone);
+            if (uWritten != uSectors - uDone)
+            {
+                Message(msgStatus, "Write error at sector %lu: %s", uDstOffset_ + uPos + uDone + uWritten, LastError());
+                ++uWritten;
+            }
+            uDone += uWritten;
+        }
+    };
 
-        // Determine how much to transfer in one go
-        if (uPos > uSectors_) uPos = uSectors_;
-        auto uBlock = std::min(static_cast<int>(uSectors_ - uPos), SECTOR_BLOCK);
+    // Sparse output skips zero chunks beyond the end of a target file, leaving holes.
+    // Existing data before the end must still be overwritten.
+    auto sparse = opt_sparse && IsRegularFile(h);
+    auto file_end = sparse ? FileEnd(h) : 0;
+    auto chunk_sectors = std::max(SPARSE_CHUNK / sector_size, 1);
+    int64_t uEndPos = 0;
+
+    for (;;)
+    {
+        auto block = read_blocks.pop();
 
         Message(msgStatus, "%s... %d%%", pcszAction_ ? pcszAction_ : "Copying",
-            static_cast<int>((static_cast<uint64_t>(uDstOffset_ + uPos) * 100 / uTotal_)));
+            static_cast<int>((static_cast<uint64_t>(uDstOffset_ + block.pos) * 100 / uTotal_)));
 
-        if (!uBlock)
+        if (!block.sectors)
+        {
+            uEndPos = block.pos;
             break;
+        }
 
-        // Read from source disk
-        auto uRead = phSrc_ ? phSrc_->Read(mem, uBlock) : uBlock;
-        if (uRead != uBlock)
+        if (!sparse)
+            write_run(block.pos, *block.mem, block.sectors);
+        else
         {
-            Message(msgStatus, "Read error at sector %lu: %s", uSrcOffset_ + uPos + uRead, LastError());
+            auto is_hole = [&](int uSector) {
+                auto uChunk = std::min(chunk_sectors, block.sectors - uSector);
+                auto offset = (uDstOffset_ + block.pos + uSector) * sector_size + data_offset;
+                return offset >= file_end && IsZeroFilled(*block.mem + (uSector * sector_size), uChunk * sector_size);
+            };
+
+            // Write the runs of chunks that aren't holes
+            for (auto uStart = 0; uStart < block.sectors; )
+            {
+                auto hole = is_hole(uStart);
+                auto uEnd = std::min(uStart + chunk_sectors, block.sectors);
+                while (uEnd < block.sectors && is_hole(uEnd) == hole)
+                    uEnd = std::min(uEnd + chunk_sectors, block.sectors);
+
+                if (!hole)
+                {
+                    write_run(block.pos + uStart, *block.mem + (uStart * sector_size), uEnd - uStart);
+                    file_end = std::max(file_end, (uDstOffset_ + block.pos + uEnd) * sector_size + data_offset);
+                }
+                uStart = uEnd;
+            }
+        }
+
+        if (block.checksummed.valid())
+            block.checksummed.get();
+        free_blocks.push(block);
+    }
+
+    // Extend the file over any trailing holes
+    auto end_offset = (uDstOffset_ + uEndPos) * sector_size + data_offset;
+    if (sparse && file_end < end_offset && !ExtendFile(h, end_offset))
+        Message(msgStatus, "Write error at sector %lu: %s", uDstOffset_ + uEndPos - 1, LastError());
+
+    reader.get();
+    return true;
+}
+
+bool HDD::Verify(HDD* phSrc_, int64_t uSectors_, int64_t uSrcOffset_/*=0*/, int64_t uDstOffset_/*=0*/, int64_t uTotal_/*=0*/)
+{
+    auto block_sectors = CopyBlockSectors(phSrc_);
+    MEMORY src_mem(block_sectors * sector_size), dst_mem(block_sectors * sector_size);
+    auto f = true;
+
+    if (!uTotal_) uTotal_ = uSectors_;
 
-            // Clear the bad block, but include it in the read data
-            memset(mem + (uRead * sector_size), 0, sector_size);
-            ++uRead;
+    for (int64_t uPos = 0; uPos < uSectors_; )
+    {
+        auto uBlock = static_cast<int>(std::min(uSectors_ - uPos, static_cast<int64_t>(block_sectors)));
+
+        Message(msgStatus, "Verifying... %d%%",
+            static_cast<int>((static_cast<uint64_t>(uDstOffset_ + uPos) * 100 / uTotal_)));
+
+        // Read source, expecting zeros where Copy would have zero-filled it
+        if (phSrc_)
+        {
+            for (auto uDone = 0; uDone < uBlock; )
+            {
+                phSrc_->Seek(uSrcOffset_ + uPos + uDone);
+                uDone += phSrc_->Read(src_mem + (uDone * sector_size), uBlock - uDone);
+                if (uDone < uBlock)
+                    memset(src_mem + (uDone++ * sector_size), 0, sector_size);
+            }
+
+            if (opt_byteswap)
+                ByteSwap(src_mem, uBlock * sector_size);
         }
 
-        // Forced byte-swapping?
-        if (opt_byteswap)
-            ByteSwap(mem, uRead * sector_size);
+        // Sectors within holes of a sparse target read as zeros without touching the disk
+        auto uHoleEnd = 0;
+#ifdef SEEK_DATA
+        auto offset = (uDstOffset_ + uPos) * sector_size + data_offset;
+        auto data_pos = lseek(h, offset, SEEK_DATA);
+        if (data_pos < 0 && errno == ENXIO)
+            data_pos = offset + uBlock * sector_size;
+        if (data_pos > offset)
+            uHoleEnd = static_cast<int>(std::min((data_pos - offset) / sector_size, static_cast<int64_t>(uBlock)));
+#endif
+        memset(dst_mem, 0, uHoleEnd * sector_size);
 
-        // Write to target disk
-        auto uWritten = Write(mem, uRead);
-        if (uWritten != uRead)
+        Seek(uDstOffset_ + uPos + uHoleEnd);
+        auto uRead = uHoleEnd + Read(dst_mem + (uHoleEnd * sector_size), uBlock - uHoleEnd);
+        if (uRead != uBlock)
         {
-            Message(msgStatus, "Write error at sector %lu: %s", uDstOffset_ + uPos + uWritten, LastError());
+            Message(msgWarning, "read error at target sector %lu: %s", uDstOffset_ + uPos + uRead, LastError());
+            f = false;
+            uBlock = uRead + 1;
+        }
 
-            // Skip past the write error
-            ++uWritten;
+        // Compare a sector at a time to report the first difference in the block
+        for (auto i = 0; i < uRead; ++i)
+        {
+            auto pdst = dst_mem + (i * sector_size);
+            if (phSrc_ ? memcmp(src_mem + (i * sector_size), pdst, sector_size) : !IsZeroFilled(pdst, sector_size))
+            {
+                Message(msgWarning, "verify mismatch at target sector %lu", uDstOffset_ + uPos + i);
+                f = false;
+                break;
+            }
         }
 
-        // Advance by the amount written
-        uPos += uWritten;
+        uPos += uBlock;
     }
 
-    return true;
+    return f;
 }
 
 
@@ -0,0 +1,127 @@
+// Block checksums of an HDD image, for verifying it
+
+#include "HddManifest.h"
+#include "CRC32.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+static const char* MANIFEST_SIGNATURE = "SAMdisk-hdd-manifest-1";
+static const int CRCS_PER_LINE = 8;
+
+
+HddManifest::HddManifest(const std::string& path)
+    : m_path(path)
+{
+}
+
+/*static*/ std::string HddManifest::DefaultPath(const std::string& hdd_path)
+{
+    return hdd_path + ".manifest";
+}
+
+void HddManifest::Start(int64_t total_sectors, int sector_size)
+{
+    if (sector_size <= 0 || BLOCK_BYTES % sector_size)
+        throw util::exception("unsupported sector size (", sector_size, ") for manifest");
+
+    m_total_sectors = total_sectors;
+    m_sector_size = sector_size;
+    m_extents.clear();
+    m_block_crcs.clear();
+    m_image_crc = 0;
+}
+
+void HddManifest::AddSectors(int64_t sector, const uint8_t* pb, int sectors)
+{
+    // Split at block boundaries so each extent belongs to a single block.
+    while (sectors > 0 && sector < m_total_sectors)
+    {
+        auto extent_sectors = static_cast<int>(std::min({ static_cast<int64_t>(sectors),
+            block_sectors() - sector % block_sectors(), m_total_sectors - sector }));
+        Extent extent{ extent_sectors, CRC32(pb, extent_sectors * m_sector_size) };
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_extents[sector] = extent;
+        }
+
+        sector += extent_sectors;
+        pb += extent_sectors * m_sector_size;
+        sectors -= extent_sectors;
+    }
+}
+
+void HddManifest::Finish()
+{
+    m_block_crcs.clear();
+    m_image_crc = 0;
+
+    for (int64_t block_start = 0; block_start < m_total_sectors; block_start += block_sectors())
+    {
+        auto block_end = std::min(block_start + block_sectors(), m_total_sectors);
+        uint32_t block_crc = CRC32::INIT_CRC;
+
+        for (auto sector = block_start; sector < block_end; )
+        {
+            auto it = m_extents.find(sector);
+            if (it == m_extents.end())
+                throw util::exception("manifest is missing sector ", sector);
+
+            block_crc = CRC32::combine(block_crc, it->second.crc, static_cast<uint64_t>(it->second.sectors) * m_sector_size);
+            sector += it->second.sectors;
+        }
+
+        m_block_crcs.push_back(block_crc);
+        m_image_crc = CRC32::combine(m_image_crc, block_crc, static_cast<uint64_t>(block_end - block_start) * m_sector_size);
+    }
+
+    m_extents.clear();
+}
+
+bool HddManifest::Load()
+{
+    std::ifstream file(m_path);
+    if (!file)
+        return false;
+
+    std::string signature, key;
+    int block_sectors_ = 0;
+    if (!(file >> signature) || signature != MANIFEST_SIGNATURE ||
+        !(file >> key >> m_total_sectors >> m_sector_size >> block_sectors_) || key != "sectors" ||
+        m_total_sectors < 0 || m_sector_size <= 0 || BLOCK_BYTES % m_sector_size || block_sectors_ != block_sectors() ||
+        !(file >> key >> std::hex >> m_image_crc) || key != "crc32")
+    {
+        throw util::exception("invalid manifest file (", m_path, ")");
+    }
+
+    m_block_crcs.clear();
+    uint32_t crc;
+    while (file >> crc)
+        m_block_crcs.push_back(crc);
+
+    if (!file.eof() || blocks() != (m_total_sectors + block_sectors() - 1) / block_sectors())
+        throw util::exception("invalid manifest file (", m_path, ")");
+    return true;
+}
+
+void HddManifest::Save() const
+{
+    // Write a new file and rename it so an interruption leaves any previous manifest.
+    const auto tmp_path = m_path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        file << MANIFEST_SIGNATURE << "\n";
+        file << "sectors " << m_total_sectors << ' ' << m_sector_size << ' ' << block_sectors() << "\n";
+        file << std::hex << std::setfill('0');
+        file << "crc32 " << std::setw(8) << m_image_crc << "\n";
+        for (size_t i = 0; i < m_block_crcs.size(); ++i)
+            file << std::setw(8) << m_block_crcs[i] << (((i + 1) % CRCS_PER_LINE && i + 1 != m_block_crcs.size()) ? ' ' : '\n');
+        if (!file.flush())
+            throw util::exception("write error (manifest ", tmp_path, ")");
+    }
+    if (!RenameReplacing(tmp_path, m_path))
+        throw util::exception("failed to rename ", tmp_path, " to ", m_path);
+}
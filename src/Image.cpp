@@ -3,6 +3,7 @@
 #include "PlatformConfig.h" // For disabling fopen deprecation.
 #include "Image.h"
 #include "FileSystem.h"
+#include "ImageDetect.h"
 #include "Options.h"
 #include "SpectrumPlus3.h"
 #include "Util.h"
@@ -13,7 +14,10 @@
 #include "types/sdf.h"
 #endif
 
+#include <chrono>
+
 static auto& opt_cpm = getOpt<int>("cpm");
+static auto& opt_debug = getOpt<int>("debug");
 static auto& opt_fix = getOpt<int>("fix");
 static auto& opt_flip = getOpt<int>("flip");
 static auto& opt_head0 = getOpt<int>("head0");
@@ -41,9 +45,25 @@ void ReadImage(const std::string& path, std::shared_ptr<Disk>& disk, bool srcDis
         // Next try regular files (and archives)
         file.open(path, !opt_nozip);
 
-        // Present the image to all types with read support
-        for (auto p = aImageTypes; p->pszType; ++p)
-            if (p->pfnRead && p->pfnRead(file, disk))
+        // Present the image to the types with read support whose signatures allow it
+        auto candidates = ImageCandidates(file);
+        if (opt_debug)
+            util::cout << "image detection: " << candidates.size() << " candidate types for " << file.name() << "\n";
+
+        for (auto p : candidates)
+        {
+            auto start_time = std::chrono::steady_clock::now();
+            auto accepted = p->pfnRead(file, disk);
+
+            if (opt_debug)
+            {
+                auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start_time).count();
+                util::cout << "  " << (*p->pszType ? p->pszType : "(hidden)") << ": " <<
+                    (accepted ? "accepted" : "rejected") << " in " << elapsed_us << "us\n";
+            }
+
+            if (accepted)
             {
                 // Store the archive type the image was found in, if any
                 if (file.compression() != Compress::None)
@@ -52,6 +72,7 @@ void ReadImage(const std::string& path, std::shared_ptr<Disk>& disk, bool srcDis
                     disk->metadata()["filename"] = file.name();
                 goto diskRead;
             }
+        }
 
 #if 0
         // Unwrap any sub-containers
@@ -0,0 +1,101 @@
+// Signature-based pre-selection of image readers
+
+#include "ImageDetect.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cstring>
+
+// Each entry must be a necessary condition for its reader to accept (or throw
+// on) a file, otherwise detection would no longer match trying every reader.
+static const ImageSignature aImageSignatures[] =
+{
+    // Types with a header signature
+    { "DSK", { { 0, "MV - CPC" }, { 0, "EXTENDED" } } },
+    { "RDSK", { { 0, "MV - CPC" }, { 0, "EXTENDED" }, { 0, "REPAIRER" } } },
+    { "TD0", { { 0, "TD" }, { 0, "td" } } },
+    { "SAD", { { 0, "Aley's disk backup" } } },
+    { "SCL", { { 0, "SINCLAIR" } } },
+    { "FDI", { { 0, "FDI" } } },
+    { "DTI", { { 0, "H2G2" } } },
+    { "IPF", { { 0, "CAPS" } } },
+    { "MSA", { { 0, "\x0e\x0f" } } },
+    { "CQM", { { 0, "CQ\x14" } } },
+    { "CWTOOL", { { 0, "cwtool raw data" } } },
+    { "UDI", { { 0, "UDI" }, { 0, "udi!" } } },
+    { "IMD", { { 0, "IMD " } } },
+    { "DFI", { { 0, "DFE2" }, { 0, "DFER" } } },
+    { "SCP", { { 0, "SCP" } } },
+    { "HFE", { { 0, "HXCPICFE" }, { 0, "HXCHFEV3" } } },
+    { "MFI", { { 0, "MESSFLOPPYIMAGE" } } },
+    { "QDOS", { { 0, "QL5A" }, { 0, "QL5B" } } },
+    { "SAP", { { 1, "SYSTEME D'ARCHIVAGE PUKALL" } } },
+    { "WOZ", { { 0, "WOZ1" } } },
+    { "PDI", { { 0, "PDITYPE" } } },
+    { "A2R", { { 0, "A2R2" } } },
+
+    // Types with distinctive fields
+    { "D80", { { 204, "SDOS" } } },
+
+    // Raw types, identified by size or extension only
+    { "2D", {}, { "2d" } },
+    { "TRD", {}, { "trd" } },
+    { "LIF", {}, { "lif" } },
+    { "CFI", {}, { "cfi" } },
+    { "CPM", {}, { "cpm" } },
+    { "FD", {}, { "fd" } },
+};
+
+
+static const ImageSignature* FindSignature(const IMAGE_ENTRY& entry)
+{
+    auto it = std::find_if(std::begin(aImageSignatures), std::end(aImageSignatures),
+        [&](const ImageSignature& sig) { return !strcmp(sig.pszType, entry.pszType); });
+
+    return (it != std::end(aImageSignatures)) ? &*it : nullptr;
+}
+
+static bool MatchMagic(const ImageSignature::Magic& magic, const MemFile& file)
+{
+    auto len = static_cast<int>(magic.bytes.size());
+    if (magic.offset + len > file.size())
+        return false;
+
+    return std::equal(magic.bytes.begin(), magic.bytes.end(),
+        file.data().begin() + magic.offset,
+        [](char c, uint8_t b) { return static_cast<uint8_t>(c) == b; });
+}
+
+bool IsImageCandidate(const IMAGE_ENTRY& entry, const MemFile& file)
+{
+    auto sig = FindSignature(entry);
+    if (!sig)
+        return true;
+
+    if (!sig->magics.empty() &&
+        std::none_of(sig->magics.begin(), sig->magics.end(),
+            [&](const ImageSignature::Magic& magic) { return MatchMagic(magic, file); }))
+        return false;
+
+    if (!sig->extensions.empty() &&
+        std::none_of(sig->extensions.begin(), sig->extensions.end(),
+            [&](const std::string& ext) { return IsFileExt(file.name(), ext); }))
+        return false;
+
+    return true;
+}
+
+// Readers that may accept the file, in registration order so the first match
+// is the same as presenting the file to every reader.
+VectorX<const IMAGE_ENTRY*> ImageCandidates(const MemFile& file)
+{
+    VectorX<const IMAGE_ENTRY*> candidates;
+
+    for (auto p = aImageTypes; p->pszType; ++p)
+    {
+        if (p->pfnRead && IsImageCandidate(*p, file))
+            candidates.push_back(p);
+    }
+
+    return candidates;
+}
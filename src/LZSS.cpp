@@ -0,0 +1,313 @@
+// LZSS decompression for Teledisk images
+
+#include "LZSS.h"
+#include "utils.h"
+
+#include <algorithm>
+
+namespace LZSS
+{
+static const uint8_t d_len[] = { 3,3,4,4,4,5,5,5,5,6,6,6,7,7,7,8 };
+
+static const uint8_t d_code[] =
+{
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02,
+    0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03,
+    0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05,
+    0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07,
+    0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09,
+    0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0B, 0x0B, 0x0B, 0x0B, 0x0B, 0x0B, 0x0B, 0x0B,
+    0x0C, 0x0C, 0x0C, 0x0C, 0x0D, 0x0D, 0x0D, 0x0D, 0x0E, 0x0E, 0x0E, 0x0E, 0x0F, 0x0F, 0x0F, 0x0F,
+    0x10, 0x10, 0x10, 0x10, 0x11, 0x11, 0x11, 0x11, 0x12, 0x12, 0x12, 0x12, 0x13, 0x13, 0x13, 0x13,
+    0x14, 0x14, 0x14, 0x14, 0x15, 0x15, 0x15, 0x15, 0x16, 0x16, 0x16, 0x16, 0x17, 0x17, 0x17, 0x17,
+    0x18, 0x18, 0x19, 0x19, 0x1A, 0x1A, 0x1B, 0x1B, 0x1C, 0x1C, 0x1D, 0x1D, 0x1E, 0x1E, 0x1F, 0x1F,
+    0x20, 0x20, 0x21, 0x21, 0x22, 0x22, 0x23, 0x23, 0x24, 0x24, 0x25, 0x25, 0x26, 0x26, 0x27, 0x27,
+    0x28, 0x28, 0x29, 0x29, 0x2A, 0x2A, 0x2B, 0x2B, 0x2C, 0x2C, 0x2D, 0x2D, 0x2E, 0x2E, 0x2F, 0x2F,
+    0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+};
+
+
+// Initialise the trees and state variables
+Decoder::Decoder(const uint8_t* pb, int len)
+    : m_pb(pb), m_end(pb + len), m_len(len)
+{
+    int i;
+
+    for (i = 0; i < N_CHAR; i++)
+    {
+        freq[i] = 1;
+        son[i] = static_cast<short>(i + T);
+        parent[i + T] = static_cast<short>(i);
+    }
+
+    i = 0;
+    for (int j = N_CHAR; j <= R; i += 2, j++)
+    {
+        freq[j] = freq[i] + freq[i + 1];
+        son[j] = static_cast<short>(i);
+        parent[i] = parent[i + 1] = static_cast<short>(j);
+    }
+
+    ring_buff.fill(' ');
+
+    freq[T] = 0xffff;
+    parent[R] = 0;
+}
+
+// Rebuilt the tree
+void Decoder::RebuildTree()
+{
+    int i, j, k, l;
+    unsigned f;
+
+    // Collect leaf nodes in the first half of the table and replace the freq by (freq + 1) / 2
+    for (i = j = 0; i < T; i++)
+    {
+        if (son[i] >= T)
+        {
+            freq[j] = (freq[i] + 1) / 2;
+            son[j] = son[i];
+            j++;
+        }
+    }
+
+    // Begin constructing tree by connecting sons
+    for (i = 0, j = N_CHAR; j < T; i += 2, j++)
+    {
+        k = i + 1;
+        f = freq[j] = freq[i] + freq[k];
+        for (k = j - 1; f < freq[k]; k--);
+        k++;
+        l = j - k;
+
+        std::copy_backward(freq.begin() + k, freq.begin() + k + l, freq.begin() + k + l + 1);
+        freq[k] = static_cast<uint16_t>(f);
+        std::copy_backward(son.begin() + k, son.begin() + k + l, son.begin() + k + l + 1);
+        son[k] = static_cast<short>(i);
+    }
+
+    // Connect parent
+    for (i = 0; i < T; i++)
+        if ((k = son[i]) >= T)
+            parent[k] = static_cast<short>(i);
+        else
+            parent[k] = parent[k + 1] = static_cast<short>(i);
+
+    m_table_dirty = true;
+}
+
+// Increment frequency of given code by one, and update tree
+void Decoder::UpdateTree(int c)
+{
+    int i, j, l;
+    unsigned k;
+
+    if (freq[R] == MAX_FREQ)
+        RebuildTree();
+
+    c = parent[c + T];
+
+    do
+    {
+        k = ++freq[c];
+
+        // If the order is disturbed, exchange nodes
+        if (k > freq[l = c + 1])
+        {
+            while (k > freq[++l]);
+            l--;
+            freq[c] = freq[l];
+            freq[l] = static_cast<uint16_t>(k);
+
+            i = son[c];
+            parent[i] = static_cast<short>(l);
+            if (i < T)
+                parent[i + 1] = static_cast<short>(l);
+
+            j = son[l];
+            son[l] = static_cast<short>(i);
+
+            parent[j] = static_cast<short>(c);
+            if (j < T)
+                parent[j + 1] = static_cast<short>(c);
+            son[c] = static_cast<short>(j);
+
+            // The lookup table is stale if it examined either node
+            if (m_in_table[c] || m_in_table[l])
+                m_table_dirty = true;
+
+            c = l;
+        }
+    } while ((c = parent[c]) != 0);  // Repeat up to root
+}
+
+// Fill the lookup table entries for the codes passing through the given node
+void Decoder::BuildTable(int node, int depth, unsigned prefix)
+{
+    if (depth < TABLE_BITS && son[node] < T)
+    {
+        m_in_table[node] = true;
+        BuildTable(son[node], depth + 1, prefix << 1);
+        BuildTable(son[node] + 1, depth + 1, (prefix << 1) | 1);
+        return;
+    }
+
+    // Leaf or table depth reached, so the remaining bits belong to other codes
+    m_in_table[node] = depth < TABLE_BITS;
+    auto shift = TABLE_BITS - depth;
+    auto it = m_table.begin() + (prefix << shift);
+    std::fill(it, it + (1 << shift), TableEntry{ static_cast<uint16_t>(node), static_cast<uint8_t>(depth) });
+}
+
+// Top up the bit buffer to at least 57 bits, reading past the end as zeros
+inline void Decoder::Refill()
+{
+    if (m_end - m_pb >= 8)
+    {
+        // Bits beyond m_bitcount are re-read next time, and OR in unchanged
+        uint64_t word = 0;
+        for (int i = 0; i < 8; ++i)
+            word = (word << 8) | m_pb[i];
+
+        m_bitbuf |= word >> m_bitcount;
+        m_pb += (63 - m_bitcount) >> 3;
+        m_bitcount |= 56;
+    }
+    else
+    {
+        for (; m_bitcount <= 56; m_bitcount += 8)
+            m_bitbuf |= static_cast<uint64_t>((m_pb < m_end) ? *m_pb++ : 0) << (56 - m_bitcount);
+    }
+}
+
+// Get one bit
+inline unsigned Decoder::GetBit()
+{
+    if (!m_bitcount)
+        Refill();
+
+    auto bit = static_cast<unsigned>(m_bitbuf >> 63);
+    m_bitbuf <<= 1;
+    m_bitcount--;
+    m_bitpos++;
+    return bit;
+}
+
+// Get up to 32 bits
+inline unsigned Decoder::GetBits(int count)
+{
+    if (m_bitcount < count)
+        Refill();
+
+    auto bits = static_cast<unsigned>(m_bitbuf >> 32 >> (32 - count));
+    m_bitbuf <<= count;
+    m_bitcount -= count;
+    m_bitpos += static_cast<unsigned>(count);
+    return bits;
+}
+
+// Input is only read a byte at a time as bits are needed, so any bits consumed
+// from the final byte mean the end has been reached.
+bool Decoder::eof() const
+{
+    return (m_bitpos + 7) / 8 >= static_cast<uint64_t>(m_len);
+}
+
+int Decoder::consumed() const
+{
+    return static_cast<int>(std::min((m_bitpos + 7) / 8, static_cast<uint64_t>(m_len)));
+}
+
+unsigned Decoder::DecodeChar()
+{
+    if (m_table_dirty)
+    {
+        m_in_table.fill(false);
+        BuildTable(R, 0, 0);
+        m_table_dirty = false;
+    }
+
+    if (m_bitcount < TABLE_BITS)
+        Refill();
+
+    const auto& entry = m_table[m_bitbuf >> (64 - TABLE_BITS)];
+    m_bitbuf <<= entry.bits;
+    m_bitcount -= entry.bits;
+    m_bitpos += entry.bits;
+
+    // Travel from there to leaf, choosing the smaller child node (son[]) if the
+    // read bit is 0, the bigger (son[]+1} if 1
+    unsigned c = son[entry.node];
+    while (c < T)
+        c = son[c + GetBit()];
+
+    c -= T;
+    UpdateTree(static_cast<int>(c));
+    return c;
+}
+
+unsigned Decoder::DecodePosition()
+{
+    // Recover upper 6 bits from table
+    auto i = GetBits(8);
+    auto c = static_cast<unsigned>(d_code[i]) << 6;
+    auto j = d_len[i >> 4];
+
+    // Read lower 6 bits verbatim
+    i = (i << (j - 2)) | GetBits(j - 2);
+
+    return c | (i & 0x3f);
+}
+
+// Unpack all remaining input into the supplied output buffer
+int Decoder::Unpack(uint8_t* pOut_, int out_size)
+{
+    unsigned i, j, c;
+    auto uCount = 0;
+
+    // Loop until we've processed all the input
+    while (!eof())
+    {
+        c = DecodeChar();
+
+        // Single output character?
+        if (c < 256)
+        {
+            if (uCount == out_size)
+                throw util::exception("compressed data is too large");
+
+            pOut_[uCount++] = static_cast<uint8_t>(c);
+
+            // Update the ring buffer and position (wrapping if necessary)
+            ring_buff[r++] = static_cast<uint8_t>(c);
+            r &= (N - 1);
+        }
+        else
+        {
+            // Position in ring buffer and length
+            i = (r - DecodePosition() - 1) & (N - 1);
+            j = c - 255 + THRESHOLD;
+
+            if (static_cast<int>(j) > out_size - uCount)
+                throw util::exception("compressed data is too large");
+
+            // Output the block
+            for (unsigned k = 0; k < j; ++k)
+            {
+                c = ring_buff[(i + k) & (N - 1)];
+                pOut_[uCount++] = static_cast<uint8_t>(c);
+
+                ring_buff[r++] = static_cast<uint8_t>(c);
+                r &= (N - 1);
+            }
+        }
+    }
+
+    // Return the unpacked size
+    return uCount;
+}
+
+} // namespace LZSS
@@ -43,6 +43,67 @@ std::string to_string(const Compress& compression)
 }
 
 
+#ifdef HAVE_ZLIB
+static bool IsZipFile(const std::string& path)
+{
+    char sig[2]{};
+    util::unique_FILE_t f{ fopen(path.c_str(), "rb") };
+    return f && fread(sig, 1, sizeof(sig), f.get()) == sizeof(sig) && sig[0] == 'P' && sig[1] == 'K';
+}
+
+// Split an "archive.zip:name" path into the archive path and entry name.
+static bool SplitZipEntryPath(const std::string& path, std::string& zip_path, std::string& entry)
+{
+    auto pos = path.rfind(':');
+    if (pos == std::string::npos || pos + 1 == path.size() || IsFile(path))
+        return false;
+
+    auto archive = path.substr(0, pos);
+    if (!IsFile(archive) || !IsZipFile(archive))
+        return false;
+
+    zip_path = archive;
+    entry = path.substr(pos + 1);
+    return true;
+}
+#endif
+
+/*static*/ std::vector<std::string> MemFile::zip_entries(const std::string& path)
+{
+    std::vector<std::string> entries;
+
+#ifdef HAVE_ZLIB
+    if (!IsZipFile(path))
+        return entries;
+
+    unzFile hfZip = unzOpen(path.c_str());
+    if (!hfZip)
+        throw util::exception("bad zip file");
+
+    int nRet;
+    for (nRet = unzGoToFirstFile(hfZip); nRet == UNZ_OK; nRet = unzGoToNextFile(hfZip))
+    {
+        char szFile[MAX_PATH];
+        unz_file_info sInfo;
+        unzGetCurrentFileInfo(hfZip, &sInfo, szFile, MAX_PATH, nullptr, 0, nullptr, 0);
+
+        // Ignore directories and empty files
+        if (sInfo.uncompressed_size)
+            entries.push_back(szFile);
+    }
+
+    unzClose(hfZip);
+
+    if (nRet != UNZ_END_OF_LIST_OF_FILE)
+        throw util::exception("zip listing failed (", nRet, ")");
+#else
+    (void)path;
+#endif
+
+    return entries;
+}
+
+
 void MemFile::open(const std::string& path_, bool uncompress)
 {
     std::string filename;
@@ -55,10 +116,15 @@ void MemFile::open(const std::string& path_, bool uncompress)
 #else
     bool have_zlib = zlibVersion()[0] == ZLIB_VERSION[0];
 
+    // Check for a path naming a file inside a zip archive.
+    std::string zip_path = path_, entry;
+    if (uncompress && have_zlib)
+        SplitZipEntryPath(path_, zip_path, entry);
+
     // Read start of file to check for compression signatures.
     if (uncompress && have_zlib)
     {
-        FILE* f = fopen(path_.c_str(), "rb");
+        FILE* f = fopen(zip_path.c_str(), "rb");
         if (!f)
             throw posix_error(errno, path_.c_str());
 
@@ -73,7 +139,7 @@ void MemFile::open(const std::string& path_, bool uncompress)
         // Require zip file header magic.
         if (mem[0U] == 'P' && mem[1U] == 'K')
         {
-            unzFile hfZip = unzOpen(path_.c_str());
+            unzFile hfZip = unzOpen(zip_path.c_str());
             if (!hfZip)
                 throw util::exception("bad zip file");
 
@@ -93,9 +159,10 @@ void MemFile::open(const std::string& path_, bool uncompress)
                 if (!sInfo.uncompressed_size)
                     continue;
 
-                // If the file extension is recognised, read the file contents
+                // If the file is the one named, or its extension is recognised, read the file contents
                 // ToDo: GetFileType doesn't really belong here?
-                if (GetFileType(szFile) != ftUnknown && unzOpenCurrentFile(hfZip) == UNZ_OK)
+                if ((entry.empty() ? GetFileType(szFile) != ftUnknown : entry == szFile) &&
+                    unzOpenCurrentFile(hfZip) == UNZ_OK)
                 {
                     nRet = unzReadCurrentFile(hfZip, mem, static_cast<unsigned int>(mem.size));
                     unzCloseCurrentFile(hfZip);
@@ -108,6 +175,13 @@ void MemFile::open(const std::string& path_, bool uncompress)
                     ulMaxSize = sInfo.uncompressed_size;
             }
 
+            // Did we fail to find the named file?
+            if (nRet == UNZ_END_OF_LIST_OF_FILE && !entry.empty())
+            {
+                unzClose(hfZip);
+                throw util::exception("file not found in zip (", entry, ")");
+            }
+
             // Did we fail to find a matching extension?
             if (nRet == UNZ_END_OF_LIST_OF_FILE)
             {
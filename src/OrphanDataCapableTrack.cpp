@@ -1,6 +1,7 @@
 #include "OrphanDataCapableTrack.h"
 #include "Options.h"
 #include "RingedInt.h"
+#include "SectorOffsetIndex.h"
 #include "Util.h"
 
 static auto& opt_byte_tolerance_of_time = getOpt<int>("byte_tolerance_of_time");
@@ -130,43 +131,42 @@ int OrphanDataCapableTrack::Score() const
         return;
 
     // An orphan data and a parent sector are matched if they cohere and there is no closer to one of them that also coheres.
+    // Merging sector data to parent changes neither the parents nor their offsets so they are indexed once.
     const auto trackLen = parentsTrack.tracklen;
-    const auto itParentBegin = parentsTrack.begin();
-    const auto itParentEnd = parentsTrack.end(); // The parents end is constant since merging sector data to parent does not change the parents.
+    auto& parentSectors = parentsTrack.sectors();
+    const auto parentsSize = parentSectors.size();
+    const SectorOffsetIndex parentOffsetIndex(parentSectors);
     auto itOrphan = orphansTrack.begin();
     while (itOrphan != orphansTrack.end()) // The orphans end is variable since possibly erasing sector from orphans.
     {
         auto& orphanDataSector = *itOrphan;
         const auto parentOffsetInterval = orphanDataSector.GetOffsetIntervalSuitableForParent(trackLen);
-        auto itParent = itParentBegin;
-        for (; itParent != itParentEnd; itParent++)
+        auto merged = false;
+        for (const auto parentIndex : parentOffsetIndex.FindRingedWithin(parentOffsetInterval))
         {
-            auto& parentSector = *itParent;
+            auto& parentSector = parentSectors[parentIndex];
             if (considerParentSectorPredicate && !considerParentSectorPredicate(parentSector))
                 continue;
-            if (parentOffsetInterval.IsRingedWithin(parentSector.offset))
+            if (parentIndex + 1 < parentsSize && parentOffsetInterval.IsRingedWithin(parentSectors[parentIndex + 1].offset))
+                continue;
+            if (opt_debug)
+                util::cout << "MergeOrphansIntoParents: adding orphan data sector (offset=" << orphanDataSector.offset
+                << ", id.sector=" << orphanDataSector.header.sector << ") to parent (offset=" << parentSector.offset
+                << ", id.sector=" << parentSector.header.sector << ")\n";
+            if (removeOrphanAfterMerge)
             {
-                const auto itParentNext = itParent + 1;
-                if (itParentNext != itParentEnd && parentOffsetInterval.IsRingedWithin(itParentNext->offset))
-                    continue;
-                if (opt_debug)
-                    util::cout << "MergeOrphansIntoParents: adding orphan data sector (offset=" << orphanDataSector.offset
-                    << ", id.sector=" << orphanDataSector.header.sector << ") to parent (offset=" << parentSector.offset
-                    << ", id.sector=" << parentSector.header.sector << ")\n";
-                if (removeOrphanAfterMerge)
-                {
-                    parentSector.MergeOrphanDataSector(std::move(orphanDataSector));
-                    itOrphan = orphansTrack.sectors().erase(itOrphan);
-                }
-                else
-                {
-                    parentSector.MergeOrphanDataSector(orphanDataSector);
-                    itOrphan++;
-                }
-                break;
+                parentSector.MergeOrphanDataSector(std::move(orphanDataSector));
+                itOrphan = orphansTrack.sectors().erase(itOrphan);
+            }
+            else
+            {
+                parentSector.MergeOrphanDataSector(orphanDataSector);
+                itOrphan++;
             }
+            merged = true;
+            break;
         }
-        if (itParent == itParentEnd)
+        if (!merged)
             itOrphan++;
     }
 }
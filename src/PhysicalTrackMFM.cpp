@@ -1,4 +1,5 @@
 #include "PhysicalTrackMFM.h"
+#include "BitCorrelator.h"
 #include "Options.h"
 #include "Track.h"
 #include "IBMPCBase.h"
@@ -165,25 +166,19 @@ BitBuffer PhysicalTrackMFM::AsMFMBitstream()
     const auto readLengthMin = intsizeof(AddressMarkSyncInTrack); // Looking for address mark sync only.
     BitPositionableByteVector rawTrackContentForBitBuffer;
     ByteBitPosition lastAddressMarkPosition(0);
-    Data addressMarkSyncInPhysicalTrackBytes(readLengthMin);
-    const auto addressMarkSyncInTrack = reinterpret_cast<AddressMarkSyncInTrack*>(addressMarkSyncInPhysicalTrackBytes.data());
-    while (m_physicalTrackContent.RemainingByteLength() >= readLengthMin)
+    while (m_physicalTrackContent.StepToBits(AddressMarkSyncInTrack::BITS, AddressMarkSyncInTrack::BITS_LEN, readLengthMin))
     {
-        if (AddressMarkSyncInTrack::IsValid(m_physicalTrackContent.PeekByte())) // Bit of optimisation for speed.
+        const auto byteBitPositionFound = m_physicalTrackContent.GetByteBitPosition();
+        m_physicalTrackContent.StepBytes(readLengthMin);
+        if (AddressMarkInTrack::IsValid(m_physicalTrackContent.PeekByte()))
         {
-            const auto byteBitPositionFound = m_physicalTrackContent.GetByteBitPosition();
-            m_physicalTrackContent.ReadBytes(addressMarkSyncInPhysicalTrackBytes);
-            if (addressMarkSyncInTrack->IsValid() && AddressMarkInTrack::IsValid(m_physicalTrackContent.PeekByte()))
-            {
-                const auto bitsLen = byteBitPositionFound - lastAddressMarkPosition;
-                rawTrackContentForBitBuffer.CopyBitsDoubledFrom(m_physicalTrackContent, bitsLen.TotalBitPosition(), &lastAddressMarkPosition);
-                rawTrackContentForBitBuffer.WriteBytes(addressMarkBytes);
-                lastAddressMarkPosition = m_physicalTrackContent.GetByteBitPosition();
-                continue;
-            }
-            else
-                m_physicalTrackContent.SetByteBitPosition(byteBitPositionFound);
+            const auto bitsLen = byteBitPositionFound - lastAddressMarkPosition;
+            rawTrackContentForBitBuffer.CopyBitsDoubledFrom(m_physicalTrackContent, bitsLen.TotalBitPosition(), &lastAddressMarkPosition);
+            rawTrackContentForBitBuffer.WriteBytes(addressMarkBytes);
+            lastAddressMarkPosition = m_physicalTrackContent.GetByteBitPosition();
+            continue;
         }
+        m_physicalTrackContent.SetByteBitPosition(byteBitPositionFound);
         m_physicalTrackContent.StepBit();
     }
     const auto bitsLen = m_physicalTrackContent.BytesBitEndPosition() - lastAddressMarkPosition;
@@ -271,37 +266,30 @@ OrphanDataCapableTrack PhysicalTrackMFM::DecodeTrack(const CylHead& cylHead)
     const auto trackLen = DataBitPositionAsBitOffset(m_physicalTrackContent.BytesBitSize(), m_encoding); // Counted in mfmbits (rawbits).
     orphanDataCapableTrack.setTrackLen(trackLen * 2); // Setting double the tracklen to avoid wrapping.
     constexpr const auto addressMarkSyncInPhysicalTrackLength = intsizeof(AddressMarkSyncInTrack);
-    Data addressMarkSyncInPhysicalTrackBytes(addressMarkSyncInPhysicalTrackLength);
-    const auto addressMarkSyncInTrack = reinterpret_cast<AddressMarkSyncInTrack*>(addressMarkSyncInPhysicalTrackBytes.data());
     constexpr const auto addressMarkOverheadInPhysicalTrackLength = addressMarkSyncInPhysicalTrackLength + 1;
-    while (m_physicalTrackContent.RemainingByteLength() >= addressMarkOverheadInPhysicalTrackLength)
+    while (m_physicalTrackContent.StepToBits(AddressMarkSyncInTrack::BITS, AddressMarkSyncInTrack::BITS_LEN,
+        addressMarkOverheadInPhysicalTrackLength))
     {
-        if (AddressMarkSyncInTrack::IsValid(m_physicalTrackContent.PeekByte())) // Bit of optimisation for speed.
+        auto byteBitPosition = m_physicalTrackContent.GetByteBitPosition();
+        m_physicalTrackContent.StepBytes(addressMarkSyncInPhysicalTrackLength);
+        const auto addressMarkValue = m_physicalTrackContent.PeekByte();
+        const auto availableBytes = m_physicalTrackContent.RemainingByteLength();
+        if (TrackIndexInPhysicalTrack::IsSuitable(addressMarkValue, availableBytes))
         {
-            auto byteBitPosition = m_physicalTrackContent.GetByteBitPosition();
-            m_physicalTrackContent.ReadBytes(addressMarkSyncInPhysicalTrackBytes);
-            if (addressMarkSyncInTrack->IsValid())
-            {
-                const auto addressMarkValue = m_physicalTrackContent.PeekByte();
-                const auto availableBytes = m_physicalTrackContent.RemainingByteLength();
-                if (TrackIndexInPhysicalTrack::IsSuitable(addressMarkValue, availableBytes))
-                {
-                    TrackIndexInPhysicalTrack::ProcessInto(orphanDataCapableTrack, m_physicalTrackContent, physicalTrackContext, m_encoding);
-                    continue;
-                }
-                else if (SectorIdInPhysicalTrack::IsSuitable(addressMarkValue, availableBytes))
-                {
-                    SectorIdInPhysicalTrack::ProcessInto(orphanDataCapableTrack, m_physicalTrackContent, physicalTrackContext, m_encoding);
-                    continue;
-                }
-                else if (SectorDataRefInPhysicalTrack::IsSuitable(addressMarkValue, availableBytes))
-                {
-                    SectorDataRefInPhysicalTrack::ProcessInto(orphanDataCapableTrack, m_physicalTrackContent, physicalTrackContext, m_encoding);
-                    continue;
-                }
-            }
-            m_physicalTrackContent.SetByteBitPosition(byteBitPosition);
+            TrackIndexInPhysicalTrack::ProcessInto(orphanDataCapableTrack, m_physicalTrackContent, physicalTrackContext, m_encoding);
+            continue;
         }
+        else if (SectorIdInPhysicalTrack::IsSuitable(addressMarkValue, availableBytes))
+        {
+            SectorIdInPhysicalTrack::ProcessInto(orphanDataCapableTrack, m_physicalTrackContent, physicalTrackContext, m_encoding);
+            continue;
+        }
+        else if (SectorDataRefInPhysicalTrack::IsSuitable(addressMarkValue, availableBytes))
+        {
+            SectorDataRefInPhysicalTrack::ProcessInto(orphanDataCapableTrack, m_physicalTrackContent, physicalTrackContext, m_encoding);
+            continue;
+        }
+        m_physicalTrackContent.SetByteBitPosition(byteBitPosition);
         m_physicalTrackContent.StepBit();
     }
 
@@ -318,4 +306,26 @@ OrphanDataCapableTrack PhysicalTrackMFM::DecodeTrack(const CylHead& cylHead) con
     return physicalTrack.DecodeTrack(cylHead);
 }
 
+/* Determine best track length (in mfmbits) by correlating the content of this
+ * multi revolution track with itself around trackLenAbout. Returns 0 if the
+ * content is not long enough or does not repeat well enough.
+ */
+int PhysicalTrackMFM::DetermineBestTrackLen(const int trackLenAbout) const
+{
+    constexpr auto matchingRatioMin = 0.9; // Unrelated bits match about half the time.
+    const auto encoding = Encoding::MFM;
+    const auto revolutionBits = BitOffsetAsDataBitPosition(trackLenAbout, encoding);
+    const auto toleranceBits = Track::COMPARE_TOLERANCE_BYTES * UINT8_T_BIT_SIZE;
+    const BitCorrelator bitCorrelator(m_physicalTrackContent.Bytes());
+    const auto comparedBits = bitCorrelator.BitSize() - (revolutionBits + toleranceBits);
+    if (revolutionBits <= toleranceBits || comparedBits < revolutionBits / 4) // Compare at least quarter revolution.
+        return 0;
+    const auto correlation = bitCorrelator.FindBestShift(revolutionBits - toleranceBits,
+        revolutionBits + toleranceBits, comparedBits);
+    if (opt_debug)
+        util::cout << "DetermineBestTrackLen found revolution of " << correlation.shift << " bits with matching ratio "
+            << correlation.MatchingRatio() << "\n";
+    return correlation.MatchingRatio() >= matchingRatioMin ? DataBitPositionAsBitOffset(correlation.shift, encoding) : 0;
+}
+
 //---------------------------------------------------------------------------
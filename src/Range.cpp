@@ -52,6 +52,28 @@ void Range::each(const std::function<void(const CylHead & cylhead)>& func, bool
     }
 }
 
+void Range::each_serpentine(const std::function<void(const CylHead & cylhead)>& func, bool cyls_first, bool& downwards) const
+{
+    const auto sweep = [&](const std::function<void(int cyl)>& cylFunc) {
+        for (auto i = 0; i < cyls(); ++i)
+            cylFunc(downwards ? cyl_end - 1 - i : cyl_begin + i);
+        downwards = !downwards;
+    };
+
+    if (cyls_first && heads() > 1)
+    {
+        for (auto head = head_begin; head < head_end; ++head)
+            sweep([&](int cyl) { func(CylHead(cyl, head)); });
+    }
+    else
+    {
+        sweep([&](int cyl) {
+            for (auto head = head_begin; head < head_end; ++head)
+                func(CylHead(cyl, head));
+        });
+    }
+}
+
 std::string Range::ToString(bool /*onlyRelevantData*//* = true*/) const
 {
     if (empty())
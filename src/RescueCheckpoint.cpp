@@ -0,0 +1,157 @@
+// Checkpoint of copying a device disk, for resuming it
+
+#include "RescueCheckpoint.h"
+#include "Util.h"
+
+#include <cstdio>
+#include <fstream>
+
+static const char* CHECKPOINT_SIGNATURE = "SAMdisk-rescue-checkpoint-1";
+
+
+RescueCheckpoint::RescueCheckpoint(const std::string& dst_path)
+    : m_path(dst_path + ".checkpoint")
+{
+}
+
+bool RescueCheckpoint::Load()
+{
+    std::ifstream file(m_path);
+    if (!file)
+        return false;
+
+    std::string signature;
+    if (!(file >> signature) || signature != CHECKPOINT_SIGNATURE)
+        throw util::exception("invalid checkpoint file (", m_path, ")");
+
+    m_tracks_done.reset();
+    m_sector_read_stats.clear();
+    std::string key;
+    while (file >> key)
+    {
+        if (key == "round")
+            file >> round >> disk_retries_left >> disk_retries_changed >> sweep_downwards;
+        else if (key == "done")
+        {
+            CylHead cylhead;
+            if (file >> cylhead.cyl >> cylhead.head)
+            {
+                if (cylhead.cyl < 0 || cylhead.cyl >= MAX_DISK_CYLS || cylhead.head < 0 || cylhead.head >= MAX_DISK_HEADS)
+                    throw util::exception("invalid checkpoint file (", m_path, ") at track ", cylhead);
+                SetTrackDone(cylhead);
+            }
+        }
+        else if (key == "stats")
+        {
+            SectorReadStats stats;
+            int copies = 0;
+            file >> stats.cylhead.cyl >> stats.cylhead.head
+                >> stats.header.cyl >> stats.header.head >> stats.header.sector >> stats.header.size
+                >> stats.read_attempts >> copies;
+            for (auto i = 0; file && i < copies; ++i)
+            {
+                int read_count;
+                if (file >> read_count)
+                    stats.read_counts.push_back(read_count);
+            }
+            if (file)
+                m_sector_read_stats.push_back(std::move(stats));
+        }
+        else
+            throw util::exception("invalid checkpoint file (", m_path, ") at ", key);
+        // A record cut short means the checkpoint file is truncated or corrupt.
+        if (!file)
+            throw util::exception("invalid checkpoint file (", m_path, ") at ", key);
+    }
+    return true;
+}
+
+void RescueCheckpoint::Save(Disk& dst_disk)
+{
+    m_sector_read_stats.clear();
+    dst_disk.each([&](const CylHead& cylhead, const Track& track) {
+        for (const auto& sector : track)
+        {
+            if (sector.copies() == 0)
+                continue;
+            SectorReadStats stats{ cylhead, sector.header, sector.read_attempts(), {} };
+            for (auto i = 0; i < sector.copies(); ++i)
+                stats.read_counts.push_back(sector.data_copy_read_stats(i).ReadCount());
+            m_sector_read_stats.push_back(std::move(stats));
+        }
+    });
+
+    // Write a new file and rename it so an interruption leaves the previous checkpoint.
+    const auto tmp_path = m_path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        file << CHECKPOINT_SIGNATURE << "\n";
+        file << "round " << round << ' ' << disk_retries_left << ' ' << disk_retries_changed << ' ' << sweep_downwards << "\n";
+        for (auto i = 0; i < MAX_DISK_CYLS * MAX_DISK_HEADS; ++i)
+            if (m_tracks_done[lossless_static_cast<size_t>(i)])
+                file << "done " << i / MAX_DISK_HEADS << ' ' << i % MAX_DISK_HEADS << "\n";
+        for (const auto& stats : m_sector_read_stats)
+        {
+            file << "stats " << stats.cylhead.cyl << ' ' << stats.cylhead.head << ' '
+                << stats.header.cyl << ' ' << stats.header.head << ' ' << stats.header.sector << ' ' << stats.header.size << ' '
+                << stats.read_attempts << ' ' << stats.read_counts.size();
+            for (const auto read_count : stats.read_counts)
+                file << ' ' << read_count;
+            file << "\n";
+        }
+        if (!file.flush())
+            throw util::exception("write error (checkpoint ", tmp_path, ")");
+    }
+    if (!RenameReplacing(tmp_path, m_path))
+        throw util::exception("failed to rename ", tmp_path, " to ", m_path);
+}
+
+void RescueCheckpoint::Remove() const
+{
+    std::remove(m_path.c_str());
+}
+
+// Restore the read stats of the destination sectors whose data copies are as recorded.
+void RescueCheckpoint::ApplyReadStats(Disk& dst_disk) const
+{
+    auto it = m_sector_read_stats.begin();
+    while (it != m_sector_read_stats.end())
+    {
+        const auto cylhead = it->cylhead;
+        auto track = dst_disk.read_track(cylhead);
+        for (; it != m_sector_read_stats.end() && it->cylhead == cylhead; ++it)
+        {
+            for (auto& sector : track)
+            {
+                if (sector.header == it->header && sector.copies() == it->read_counts.size())
+                {
+                    sector.fix_readstats();
+                    sector.set_read_attempts(it->read_attempts);
+                    for (auto i = 0; i < sector.copies(); ++i)
+                        sector.set_read_stats(i, DataReadStats(it->read_counts[i]));
+                    break;
+                }
+            }
+        }
+        dst_disk.write(TrackData(cylhead, std::move(track)));
+    }
+}
+
+void RescueCheckpoint::StartRound(int round_, const RetryPolicy& disk_retries, bool sweep_downwards_)
+{
+    round = round_;
+    disk_retries_left = disk_retries.retryTimes;
+    disk_retries_changed = disk_retries.wasChange;
+    sweep_downwards = sweep_downwards_;
+    m_tracks_done.reset();
+}
+
+bool RescueCheckpoint::IsTrackDone(const CylHead& cylhead) const
+{
+    return m_tracks_done[lossless_static_cast<size_t>(cylhead.operator int())];
+}
+
+void RescueCheckpoint::SetTrackDone(const CylHead& cylhead)
+{
+    m_tracks_done[lossless_static_cast<size_t>(cylhead.operator int())] = true;
+}
@@ -0,0 +1,61 @@
+// Adaptive retry decisions learned from earlier retries
+
+#include "RetryLearner.h"
+
+// Storage for class statics.
+constexpr int RetryLearner::WHOLE_TRACK;
+constexpr int RetryLearner::MIN_RETRIES;
+constexpr double RetryLearner::MIN_IMPROVEMENT_PROBABILITY;
+
+// The weights, in retries, of the neighbour and the disk estimates.
+constexpr double NEIGHBOUR_PRIOR_WEIGHT = 2.0;
+constexpr double DISK_PRIOR_WEIGHT = 2.0;
+
+
+/*static*/ double RetryLearner::Estimate(const Stats& stats, double prior, double prior_weight)
+{
+    return (stats.improvements + prior * prior_weight) / (stats.retries + prior_weight);
+}
+
+RetryLearner::Stats RetryLearner::Get(int cyl, int head, int sector_id) const
+{
+    const auto it = m_stats.find(Key(cyl, head, sector_id));
+    return it == m_stats.end() ? Stats() : it->second;
+}
+
+void RetryLearner::Record(const CylHead& cylhead, int sector_id, bool improved)
+{
+    auto& stats = m_stats[Key(cylhead.cyl, cylhead.head, sector_id)];
+    auto& total = (sector_id == WHOLE_TRACK) ? m_track_total : m_sector_total;
+    for (auto s : { &stats, &total })
+    {
+        s->retries++;
+        if (improved)
+            s->improvements++;
+    }
+}
+
+double RetryLearner::ImprovementProbability(const CylHead& cylhead, int sector_id) const
+{
+    // Laplace's rule of succession for the disk, starting from an even chance.
+    const auto& total = (sector_id == WHOLE_TRACK) ? m_track_total : m_sector_total;
+    const auto disk = Estimate(total, 0.5, DISK_PRIOR_WEIGHT);
+
+    // Damage is often spread over adjacent cylinders, so they predict each other.
+    Stats neighbours;
+    for (auto cyl : { cylhead.cyl - 1, cylhead.cyl + 1 })
+    {
+        const auto stats = Get(cyl, cylhead.head, sector_id);
+        neighbours.retries += stats.retries;
+        neighbours.improvements += stats.improvements;
+    }
+    const auto neighbour = Estimate(neighbours, disk, NEIGHBOUR_PRIOR_WEIGHT);
+
+    return Estimate(Get(cylhead.cyl, cylhead.head, sector_id), neighbour, NEIGHBOUR_PRIOR_WEIGHT);
+}
+
+bool RetryLearner::WorthRetrying(const CylHead& cylhead, int sector_id, int retries_done) const
+{
+    return retries_done < MIN_RETRIES ||
+        ImprovementProbability(cylhead, sector_id) >= MIN_IMPROVEMENT_PROBABILITY;
+}
@@ -6,8 +6,12 @@
 #include "SAMCoupe.h"
 #include "Options.h"
 
-#include <cstring>
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <mutex>
 
 static auto& opt_fix = getOpt<int>("fix");
 static auto& opt_nosig = getOpt<int>("nosig");
@@ -353,37 +357,208 @@ void GetBDOSCaps(int64_t sectors, BDOS_CAPS& bdc)
     }
 }
 
-int FindBDOSRecord(HDD& hdd, const char* pcsz_, BDOS_CAPS& bdc)
+static const char* BDOS_INDEX_SIGNATURE = "SAMdisk-bdos-index-1";
+
+struct CachedBDOSIndex
 {
-    // No label means no match
-    if (!*pcsz_)
-        return 0;
+    int64_t total_sectors = 0;
+    int64_t file_size = -1;
+    int64_t file_time = -1;
+    std::shared_ptr<const BDOS_INDEX> index{};
+};
 
-    auto record = 0;
-    char szFind[BDOS_LABEL_SIZE + 1] = {}, sz[BDOS_LABEL_SIZE + 1] = {};
+static std::mutex bdos_index_mutex;
+static std::map<std::string, CachedBDOSIndex> bdos_index_cache;
+
+static std::string BDOSIndexPath(const std::string& hdd_path)
+{
+    return hdd_path + ".bdosidx";
+}
+
+static void SetBDOSLabel(BDOS_INDEX& index, int record, const std::string& label)
+{
+    index.labels[static_cast<size_t>(record - 1)] = label;
+
+    // Duplicate labels are found as the lowest numbered record
+    if (!label.empty())
+        index.records.emplace(util::lowercase(label), record);
+}
+
+static std::shared_ptr<BDOS_INDEX> ReadBDOSIndex(const HDD& hdd)
+{
+    auto index = std::make_shared<BDOS_INDEX>();
+    auto& bdc = index->caps;
+
+    if (!IsBDOSDisk(hdd, bdc))
+        return nullptr;
+
+    // The record list is contiguous, so read it in one go
+    MEMORY mem(bdc.list_sectors * hdd.sector_size);
+    if (!hdd.Seek(bdc.base_sectors - bdc.list_sectors) ||
+        hdd.Read(mem, bdc.list_sectors, bdc.need_byteswap) != bdc.list_sectors)
+        throw posix_error(errno, "read");
 
-    size_t nLen = strlen(pcsz_);
-    memset(szFind, ' ', BDOS_LABEL_SIZE);
-    memcpy(szFind, pcsz_, std::min(nLen, static_cast<size_t>(BDOS_LABEL_SIZE)));
+    auto entries = mem.size / BDOS_LABEL_SIZE;
+    index->labels.resize(static_cast<size_t>(entries));
 
-    auto uRecordList = bdc.list_sectors * hdd.sector_size;
-    MEMORY mem(uRecordList);
+    for (auto i = 0; i < entries; ++i)
+    {
+        char label[BDOS_LABEL_SIZE + 1] = {};
+        memcpy(label, mem + i * BDOS_LABEL_SIZE, BDOS_LABEL_SIZE);
+
+        // Bit 7 should be ignored on label names
+        for (auto& c : label)
+            c &= 0x7f;
 
-    if (hdd.Seek(1) && (hdd.Read(mem, bdc.list_sectors) == uRecordList))
+        SetBDOSLabel(*index, i + 1, util::trim(label));
+    }
+
+    return index;
+}
+
+static std::shared_ptr<BDOS_INDEX> LoadBDOSIndex(const std::string& hdd_path, int64_t file_size, int64_t file_time)
+{
+    std::ifstream file(BDOSIndexPath(hdd_path));
+    if (!file)
+        return nullptr;
+
+    auto index = std::make_shared<BDOS_INDEX>();
+    auto& bdc = index->caps;
+    std::string signature, key;
+    int64_t size = -1, time = -1;
+
+    // Ignore the index if it's unreadable or out of date
+    if (!(file >> signature) || signature != BDOS_INDEX_SIGNATURE ||
+        !(file >> key >> size >> time) || key != "file" || size != file_size || time != file_time ||
+        !(file >> key >> bdc.list_sectors >> bdc.base_sectors >> bdc.records >> bdc.extra_sectors >>
+            bdc.need_byteswap >> bdc.bootable >> bdc.lba) || key != "caps" ||
+        bdc.list_sectors <= 0 || bdc.list_sectors > 0x10000 || bdc.records < 0)
     {
-        uint8_t* pb = mem;
+        return nullptr;
+    }
+
+    index->labels.resize(static_cast<size_t>(bdc.list_sectors * (BDOS_SECTOR_SIZE / BDOS_LABEL_SIZE)));
 
-        for (auto i = 0; i < bdc.records; ++i, pb += BDOS_LABEL_SIZE)
+    int record;
+    std::string hex;
+    while (file >> record >> hex)
+    {
+        if (record < 1 || record > static_cast<int>(index->labels.size()) || hex.length() > BDOS_LABEL_SIZE * 2 || (hex.length() & 1))
+            return nullptr;
+
+        std::string label;
+        for (size_t i = 0; i < hex.length(); i += 2)
+            label += static_cast<char>(std::stoul(hex.substr(i, 2), nullptr, 16) & 0x7f);
+
+        SetBDOSLabel(*index, record, label);
+    }
+
+    return file.eof() ? index : nullptr;
+}
+
+static void SaveBDOSIndex(const std::string& hdd_path, int64_t file_size, int64_t file_time, const BDOS_INDEX& index)
+{
+    // Skip files modified too recently for the timestamp to reveal a later change
+    if (file_time >= static_cast<int64_t>(std::time(nullptr)) - 1)
+        return;
+
+    auto& bdc = index.caps;
+    const auto index_path = BDOSIndexPath(hdd_path);
+    const auto tmp_path = index_path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        file << BDOS_INDEX_SIGNATURE << "\n";
+        file << "file " << file_size << ' ' << file_time << "\n";
+        file << "caps " << bdc.list_sectors << ' ' << bdc.base_sectors << ' ' << bdc.records << ' ' << bdc.extra_sectors << ' ' <<
+            bdc.need_byteswap << ' ' << bdc.bootable << ' ' << bdc.lba << "\n";
+
+        for (size_t i = 0; i < index.labels.size(); ++i)
         {
-            memcpy(sz, pb, BDOS_LABEL_SIZE);
+            if (index.labels[i].empty())
+                continue;
 
-            if (!strcasecmp(szFind, sz))
-            {
-                record = i;
-                break;
-            }
+            file << (i + 1) << ' ';
+            for (auto c : index.labels[i])
+                file << util::fmt("%02X", static_cast<uint8_t>(c));
+            file << "\n";
+        }
+
+        // The index is only an optimisation, so failing to write it isn't an error
+        if (!file.flush())
+        {
+            file.close();
+            std::remove(tmp_path.c_str());
+            return;
         }
     }
 
-    return record;
+    std::remove(index_path.c_str());
+    if (std::rename(tmp_path.c_str(), index_path.c_str()) != 0)
+        std::remove(tmp_path.c_str());
+}
+
+std::shared_ptr<const BDOS_INDEX> GetBDOSIndex(const HDD& hdd, const std::string& hdd_path)
+{
+    std::lock_guard<std::mutex> lock(bdos_index_mutex);
+
+    // Image files are re-checked against their size and modification time
+    bool is_file = IsFile(hdd_path);
+    auto file_size = is_file ? FileSize(hdd_path) : -1;
+    auto file_time = is_file ? FileModTime(hdd_path) : -1;
+
+    auto& cached = bdos_index_cache[hdd_path];
+    if (cached.index && cached.total_sectors == hdd.total_sectors &&
+        cached.file_size == file_size && cached.file_time == file_time)
+    {
+        return cached.index;
+    }
+
+    std::shared_ptr<BDOS_INDEX> index;
+    if (is_file)
+        index = LoadBDOSIndex(hdd_path, file_size, file_time);
+
+    if (!index)
+    {
+        index = ReadBDOSIndex(hdd);
+        if (!index)
+        {
+            bdos_index_cache.erase(hdd_path);
+            return nullptr;
+        }
+
+        if (is_file)
+            SaveBDOSIndex(hdd_path, file_size, file_time, *index);
+    }
+
+    cached.total_sectors = hdd.total_sectors;
+    cached.file_size = file_size;
+    cached.file_time = file_time;
+    cached.index = index;
+    return index;
+}
+
+int FindBDOSRecord(const HDD& hdd, const std::string& path, BDOS_CAPS& bdc)
+{
+    // Split the record number or label from the disk path
+    auto it = path.rfind(':');
+    if (it == std::string::npos)
+        return 0;
+
+    auto index = GetBDOSIndex(hdd, path.substr(0, it));
+    if (!index)
+        throw util::exception("drive is not BDOS format");
+
+    bdc = index->caps;
+
+    auto record = 0;
+    if (IsRecord(path, &record) && record >= 0)
+        return record;
+
+    // No label means no match
+    auto label = util::lowercase(util::trim(path.substr(it + 1)));
+    if (label.empty())
+        return 0;
+
+    auto it_record = index->records.find(label);
+    return (it_record != index->records.end()) ? it_record->second : 0;
 }
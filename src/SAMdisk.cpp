@@ -23,10 +23,10 @@
 
 constexpr int STABILITY_LEVEL_DEFAULT = 3;
 
-enum { cmdCopy, cmdScan, cmdFormat, cmdList, cmdView, cmdInfo, cmdDir, cmdRpm, cmdVerify, cmdUnformat, cmdVersion, cmdCreate, cmdEnd };
+enum { cmdCopy, cmdScan, cmdFormat, cmdList, cmdView, cmdInfo, cmdDir, cmdRpm, cmdVerify, cmdUnformat, cmdVersion, cmdCreate, cmdBatch, cmdEnd };
 
 static const char* aszCommands[] =
-{ "copy",  "scan",  "format",  "list",  "view",  "info",  "dir",  "rpm",  "verify",  "unformat",  "version",  "create",  nullptr };
+{ "copy",  "scan",  "format",  "list",  "view",  "info",  "dir",  "rpm",  "verify",  "unformat",  "version",  "create",  "batch",  nullptr };
 
 // The options and its publishers. [BEGIN]
 
@@ -44,14 +44,19 @@ struct OPTIONS
     int merge = 0, repair = 0, trim = 0, calibrate = 0, newdrive = 0, byteswap = 0;
     int noweak = 0, nosig = 0, nodata = 0, nocfa = 0, noidentify = 0, nospecial = 0;
     int nozip = 0, nodiff = 0, noformat = 0, nodups = 0, nowobble = 0, nottb = 0;
-    int bdos = 0, atom = 0, hdf = 0, resize = 0, cpm = 0, minimal = 0, legacy = 0;
+    int bdos = 0, atom = 0, hdf = 0, hfe = 0, resize = 0, cpm = 0, minimal = 0, legacy = 0;
     int absoffsets = 0, datacopy = 0, align = 0, keepoverlap = 0, fmoverlap = 0;
     int flip = 0, multiformat = 0, rpm = 0, tty = 0, time = 0;
     int a1sync = 0;
+    int vfd_time_scale = 0;
+    int hddblock = 0, sparse = 0, verify = 0, directio = 0, manifest = 0;
+    int jobs = 0, jobmemory = 0;
 
     bool normal_disk = false;
     bool readstats = false, paranoia = false, skip_stable_sectors = false;
     bool fdraw_rescue_mode = false;
+    bool adaptive_retries = false;
+    bool resume = false;
     bool unhide_first_sector_by_track_end_sector = false;
     std::string detect_devfs{}; // Detect device (floppy) filesystem thus use its format.
 
@@ -67,7 +72,7 @@ struct OPTIONS
     DataRate datarate{ DataRate::Unknown };
     PreferredData prefer{ PreferredData::Unknown };
     long sectors = -1;
-    std::string label{}, boot{};
+    std::string label{}, boot{}, report{};
 
     char szSource[MAX_PATH], szTarget[MAX_PATH];
 };
@@ -103,6 +108,7 @@ int& getOpt(const char* key)
         {"cylsfirst", Options::opt.cylsfirst},
         {"datacopy", Options::opt.datacopy},
         {"debug", Options::opt.debug},
+        {"directio", Options::opt.directio},
         {"fill", Options::opt.fill},
         {"fix", Options::opt.fix},
         {"flip", Options::opt.flip},
@@ -114,15 +120,20 @@ int& getOpt(const char* key)
         {"gapmask", Options::opt.gapmask},
         {"gaps", Options::opt.gaps},
         {"hardsectors", Options::opt.hardsectors},
+        {"hddblock", Options::opt.hddblock},
         {"hdf", Options::opt.hdf},
+        {"hfe", Options::opt.hfe},
         {"head0", Options::opt.head0},
         {"head1", Options::opt.head1},
         {"hex", Options::opt.hex},
         {"idcrc", Options::opt.idcrc},
         {"interleave", Options::opt.interleave},
+        {"jobmemory", Options::opt.jobmemory},
+        {"jobs", Options::opt.jobs},
         {"keepoverlap", Options::opt.keepoverlap},
         {"legacy", Options::opt.legacy},
         {"log", Options::opt.log},
+        {"manifest", Options::opt.manifest},
         {"maxcopies", Options::opt.maxcopies},
         {"maxsplice", Options::opt.maxsplice},
         {"merge", Options::opt.merge},
@@ -152,6 +163,7 @@ int& getOpt(const char* key)
         {"scale", Options::opt.scale},
         {"size", Options::opt.size},
         {"skew", Options::opt.skew},
+        {"sparse", Options::opt.sparse},
         {"stability_level", Options::opt.stability_level},
         {"step", Options::opt.step},
         {"steprate", Options::opt.steprate},
@@ -159,6 +171,8 @@ int& getOpt(const char* key)
         {"trim", Options::opt.trim},
         {"tty", Options::opt.tty},
         {"verbose", Options::opt.verbose},
+        {"verify", Options::opt.verify},
+        {"vfd_time_scale", Options::opt.vfd_time_scale},
     };
     return s_mapStringToIntegerVariables.at(key);
 }
@@ -168,11 +182,13 @@ bool& getOpt(const char* key)
 {
     static const std::map<std::string, bool&> s_mapStringToBoolVariables =
     {
+        {"adaptive_retries", Options::opt.adaptive_retries },
         {"fdraw_rescue_mode", Options::opt.fdraw_rescue_mode },
         {"unhide_first_sector_by_track_end_sector", Options::opt.unhide_first_sector_by_track_end_sector },
         {"normal_disk", Options::opt.normal_disk},
         {"paranoia", Options::opt.paranoia},
         {"readstats", Options::opt.readstats},
+        {"resume", Options::opt.resume},
         {"skip_stable_sectors", Options::opt.skip_stable_sectors},
     };
     return s_mapStringToBoolVariables.at(key);
@@ -240,7 +256,8 @@ std::string& getOpt(const char* key)
     {
         {"label", Options::opt.label},
         {"boot", Options::opt.boot},
-        {"detect_devfs", Options::opt.detect_devfs}
+        {"detect_devfs", Options::opt.detect_devfs},
+        {"report", Options::opt.report}
     };
 
     return s_mapStringToStringVariables.at(key);
@@ -287,6 +304,8 @@ int Usage()
 
     util::cout << "\n"
         << " SAMDISK [copy|scan|format|create|list|view|info|dir|rpm] <args>\n"
+        << " SAMDISK copy <source> <source2> [...] <target>  (merge several sources)\n"
+        << " SAMDISK batch <dir|wildcard|zip> <target-dir>/*.<type>\n"
         << "\n"
         << "  -c, --cyls=N        cylinder count (N) or range (A-B)\n"
         << "  -h, --head=N        single head select (0 or 1)\n"
@@ -413,7 +432,7 @@ extern "C" {
 
 enum {
     OPT_RPM = 256, OPT_LOG, OPT_VERSION, OPT_HEAD0, OPT_HEAD1, OPT_GAPMASK, OPT_MAXCOPIES,
-    OPT_MAXSPLICE, OPT_CHECK8K, OPT_BYTES, OPT_HDF, OPT_ORDER, OPT_SCALE, OPT_PLLADJUST,
+    OPT_MAXSPLICE, OPT_CHECK8K, OPT_BYTES, OPT_HDF, OPT_HFE, OPT_ORDER, OPT_SCALE, OPT_PLLADJUST,
     OPT_PLLPHASE, OPT_ACE, OPT_MX, OPT_AGAT, OPT_NOFM, OPT_STEPRATE, OPT_PREFER, OPT_DEBUG,
     OPT_BITSKIP,
     OPT_TRACK_RETRIES, OPT_DISK_RETRIES, OPT_NORMAL_DISK,
@@ -421,7 +440,10 @@ enum {
     OPT_DETECT_DEVFS,
     OPT_BYTE_TOLERANCE_OF_TIME,
     OPT_FDRAW_RESCUE_MODE,
-    OPT_UNHIDE_FIRST_SECTOR_BY_TRACK_END_SECTOR
+    OPT_UNHIDE_FIRST_SECTOR_BY_TRACK_END_SECTOR,
+    OPT_VFD_TIME_SCALE,
+    OPT_ADAPTIVE_RETRIES, OPT_RESUME,
+    OPT_HDD_BLOCK, OPT_JOBS, OPT_JOB_MEMORY, OPT_REPORT
 };
 
 static struct option long_options[] =
@@ -492,6 +514,9 @@ static struct option long_options[] =
     { "no-special",       no_argument, &Options::opt.nospecial, 1 },     // undocumented
     { "byte-swap",        no_argument, &Options::opt.byteswap, 1 },
     { "atom",             no_argument, &Options::opt.byteswap, 1 },
+    { "sparse",           no_argument, &Options::opt.sparse, 1 },        // undocumented
+    { "verify",           no_argument, &Options::opt.verify, 1 },        // undocumented
+    { "manifest",         no_argument, &Options::opt.manifest, 1 },      // undocumented
     { "ace",              no_argument, nullptr, OPT_ACE },
     { "mx",               no_argument, nullptr, OPT_MX },
     { "agat",             no_argument, nullptr, OPT_AGAT },
@@ -519,6 +544,7 @@ static struct option long_options[] =
     { "rpm",        required_argument, nullptr, OPT_RPM },
     { "bytes",      required_argument, nullptr, OPT_BYTES },
     { "hdf",        required_argument, nullptr, OPT_HDF },
+    { "hfe",        required_argument, nullptr, OPT_HFE },
     { "prefer",     required_argument, nullptr, OPT_PREFER },
     { "order",      required_argument, nullptr, OPT_ORDER },
     { "step-rate",  required_argument, nullptr, OPT_STEPRATE },
@@ -602,6 +628,59 @@ static struct option long_options[] =
      */
     { "unhide-first-sector-by-track-end-sector", no_argument, nullptr, OPT_UNHIDE_FIRST_SECTOR_BY_TRACK_END_SECTOR },
 
+    /* undocumented. The vfd: virtual device simulates the drive timing and
+     * sleeps this percent of the simulated time per command, e.g. 100 runs in
+     * real time. Default is 0, no sleeping.
+     */
+    { "vfd-time-scale", required_argument, nullptr, OPT_VFD_TIME_SCALE },
+
+    /* undocumented. Stops retrying a track or sector early when the earlier
+     * retries of it, its neighbouring cylinders and the whole disk suggest
+     * that further retries are unlikely to improve the read data. The retry
+     * counts remain the upper limits. Default is false.
+     */
+    { "adaptive-retries", no_argument, nullptr, OPT_ADAPTIVE_RETRIES },
+
+    /* undocumented. Continues an interrupted --fdraw-rescue-mode copy from a
+     * device with --disk-retries using the checkpoint stored next to the
+     * destination image (only such copies are checkpointed), i.e. continues
+     * its disk round without rereading the tracks done in it, and skips
+     * stable sectors like --skip-stable-sectors. The checkpoint is deleted
+     * when the copy completes. Default is false.
+     */
+    { "resume", no_argument, nullptr, OPT_RESUME },
+
+    /* undocumented. The number of sectors copying an HDD device or image
+     * reads and writes at a time. Up to four of these blocks are in flight
+     * between the reading and the writing thread. Default is 2048, 1MB of
+     * 512-byte sectors, or more for devices preferring larger requests.
+     */
+    { "hdd-block", required_argument, nullptr, OPT_HDD_BLOCK },
+
+    /* undocumented. Opens HDD devices with direct I/O, bypassing the OS
+     * cache, and reads them in 8MB requests. Devices that reject direct I/O
+     * fall back on cached I/O, with the data read dropped from the cache
+     * where supported. Default is false.
+     */
+    { "direct-io", no_argument, &Options::opt.directio, 1 },
+
+    /* undocumented. The number of images the batch command converts at
+     * once, each in its own worker process. Default is the number of
+     * hardware threads.
+     */
+    { "jobs", required_argument, nullptr, OPT_JOBS },
+
+    /* undocumented. Limits the address space of each batch worker process
+     * to N MB, failing conversions that need more. Reading an image reserves
+     * 256MB, so useful limits start around 400. Default is no limit.
+     */
+    { "job-memory", required_argument, nullptr, OPT_JOB_MEMORY },
+
+    /* undocumented. The CSV file the batch command writes its results and
+     * timings to. Default is samdisk-batch.csv in the target directory.
+     */
+    { "report", required_argument, nullptr, OPT_REPORT },
+
     { nullptr, 0, nullptr, 0 }
 
     /* RetryAmount: It is an integer number with 3 cases. (See RetryPolicy class).
@@ -784,6 +863,11 @@ bool ParseCommandLine(int argc_, char* argv_[])
             if (Options::opt.hdf != 10 && Options::opt.hdf != 11)
                 throw util::exception("invalid HDF version '", optarg, "', expected 10 or 11");
             break;
+        case OPT_HFE:
+            Options::opt.hfe = util::str_value<int>(optarg);
+            if (Options::opt.hfe != 1 && Options::opt.hfe != 3)
+                throw util::exception("invalid HFE version '", optarg, "', expected 1 or 3");
+            break;
         case OPT_SCALE:
             Options::opt.scale = util::str_value<int>(optarg);
             break;
@@ -875,6 +959,42 @@ bool ParseCommandLine(int argc_, char* argv_[])
             Options::opt.unhide_first_sector_by_track_end_sector = true;
             break;
 
+        case OPT_ADAPTIVE_RETRIES:
+            Options::opt.adaptive_retries = true;
+            break;
+
+        case OPT_RESUME:
+            Options::opt.resume = true;
+            break;
+
+        case OPT_VFD_TIME_SCALE:
+            Options::opt.vfd_time_scale = util::str_value<int>(optarg);
+            if (Options::opt.vfd_time_scale < 0)
+                throw util::exception("invalid vfd-time-scale '", optarg, "', expected >= 0");
+            break;
+
+        case OPT_HDD_BLOCK:
+            Options::opt.hddblock = util::str_value<int>(optarg);
+            if (Options::opt.hddblock <= 0)
+                throw util::exception("invalid hdd-block '", optarg, "', expected > 0");
+            break;
+
+        case OPT_JOBS:
+            Options::opt.jobs = util::str_value<int>(optarg);
+            if (Options::opt.jobs <= 0)
+                throw util::exception("invalid jobs '", optarg, "', expected > 0");
+            break;
+
+        case OPT_JOB_MEMORY:
+            Options::opt.jobmemory = util::str_value<int>(optarg);
+            if (Options::opt.jobmemory <= 0)
+                throw util::exception("invalid job-memory '", optarg, "', expected > 0");
+            break;
+
+        case OPT_REPORT:
+            Options::opt.report = optarg;
+            break;
+
         case ':':
         case '?':   // error
             util::cout << '\n';
@@ -1008,9 +1128,15 @@ int main(int argc_, char* argv_[])
         if (!ParseCommandLine(argc_, argv_))
             return 1;
 
-        // Read at most two non-option command-line arguments
+        // Read at most two non-option command-line arguments, except copy which can have more sources before the target.
+        std::vector<std::string> extraSources;
         if (optind < argc_) strncpy(Options::opt.szSource, argv_[optind++], arraysize(Options::opt.szSource) - 1);
         if (optind < argc_) strncpy(Options::opt.szTarget, argv_[optind++], arraysize(Options::opt.szTarget) - 1);
+        for (; optind < argc_ && Options::opt.command == cmdCopy; optind++)
+        {
+            extraSources.push_back(Options::opt.szTarget);
+            strncpy(Options::opt.szTarget, argv_[optind], arraysize(Options::opt.szTarget) - 1);
+        }
         if (optind < argc_) Usage();
 
         int nSource = GetArgType(Options::opt.szSource);
@@ -1023,8 +1149,18 @@ int main(int argc_, char* argv_[])
             if (nSource == argNone || nTarget == argNone)
                 Usage();
 
-            if (nSource == argDisk && IsTrinity(Options::opt.szTarget))
+            if (!extraSources.empty())
+            {
+                const auto isDiskSource = [](int argType) { return argType == argBlock || argType == argDisk; };
+                if (!isDiskSource(nSource) || nTarget != argDisk || !std::all_of(extraSources.begin(), extraSources.end(),
+                    [&](const std::string& extraSource) { return isDiskSource(GetArgType(extraSource)); }))
+                    Usage();
+                f = ImageToImage(Options::opt.szSource, Options::opt.szTarget, extraSources); // images -> image
+            }
+            else if (nSource == argDisk && IsTrinity(Options::opt.szTarget))
                 f = Image2Trinity(Options::opt.szSource, Options::opt.szTarget);          // file/image -> Trinity
+            else if (nSource == argBlock && nTarget == argHDD && BlockDevice::IsFileHDD(Options::opt.szSource))
+                f = Hdd2Hdd(Options::opt.szSource, Options::opt.szTarget);                // hdd file -> hdd
             else if ((nSource == argBlock || nSource == argDisk) && (nTarget == argDisk || nTarget == argHDD /*for .raw*/))
                 f = ImageToImage(Options::opt.szSource, Options::opt.szTarget);           // image -> image
             else if ((nSource == argHDD || nSource == argBlock) && nTarget == argHDD)
@@ -1128,7 +1264,14 @@ int main(int argc_, char* argv_[])
         }
 
         case cmdVerify:
-            throw std::logic_error("verify command not yet implemented");
+        {
+            if (nSource == argHDD || nSource == argBlock)
+                f = VerifyHdd(Options::opt.szSource, Options::opt.szTarget);
+            else
+                throw std::logic_error("verify command not yet implemented");
+
+            break;
+        }
 
         case cmdCreate:
         {
@@ -1190,6 +1333,15 @@ int main(int argc_, char* argv_[])
             break;
         }
 
+        case cmdBatch:
+        {
+            if (nSource == argNone || nTarget == argNone)
+                Usage();
+
+            f = BatchConvert(Options::opt.szSource, Options::opt.szTarget);
+            break;
+        }
+
         case cmdVersion:
         {
             if (nSource != argNone || nTarget != argNone)
@@ -500,6 +500,10 @@ Sector::Merge Sector::merge(Sector&& sector)
     }
     m_read_attempts += sector.m_read_attempts;
 
+    // Keep the weak ranges of the first analysed copy.
+    if (weak_regions.empty())
+        weak_regions = std::move(sector.weak_regions);
+
     return ret;
 }
 
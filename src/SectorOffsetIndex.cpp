@@ -0,0 +1,76 @@
+// Offset index of track sectors
+
+#include "SectorOffsetIndex.h"
+
+#include <algorithm>
+#include <limits>
+
+SectorOffsetIndex::SectorOffsetIndex(const Sectors& sectors)
+{
+    const auto iSup = sectors.size();
+    m_offsetsAndIndices.reserve(iSup);
+    for (auto i = 0; i < iSup; i++)
+    {
+        m_sorted = m_sorted && (i == 0 || sectors[i - 1].offset <= sectors[i].offset);
+        m_offsetsAndIndices.emplace_back(sectors[i].offset, i);
+    }
+    if (!m_sorted)
+        std::sort(m_offsetsAndIndices.begin(), m_offsetsAndIndices.end());
+}
+
+VectorX<int> SectorOffsetIndex::FindWithin(std::initializer_list<OffsetAndIndex> ranges) const
+{
+    VectorX<int> indices;
+    for (const auto& range : ranges)
+    {
+        if (range.first > range.second)
+            continue;
+        auto it = std::lower_bound(m_offsetsAndIndices.begin(), m_offsetsAndIndices.end(),
+            OffsetAndIndex(range.first, std::numeric_limits<int>::min()));
+        for (; it != m_offsetsAndIndices.end() && it->first <= range.second; ++it)
+            indices.push_back(it->second);
+    }
+    // The ranges can overlap.
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+    return indices;
+}
+
+VectorX<int> SectorOffsetIndex::FindRingedWithin(const Interval<int>& interval) const
+{
+    if (interval.IsEmpty())
+        return VectorX<int>();
+    const auto start = interval.Start();
+    const auto end = interval.End();
+    if (start <= end)
+        return FindWithin({ { start, end } });
+    // Ringed interval, see IsRingedWithin.
+    return FindWithin({ { std::numeric_limits<int>::min(), end }, { start, std::numeric_limits<int>::max() } });
+}
+
+VectorX<int> SectorOffsetIndex::FindToleratedSame(int offset, int toleratedOffsetDistance, int trackLen) const
+{
+    // The wrapped distance min(d, trackLen - d) of offsets is tolerated if either part is.
+    const auto wrappedDistanceMin = trackLen - toleratedOffsetDistance;
+    return FindWithin({
+        { std::numeric_limits<int>::min(), offset - wrappedDistanceMin },
+        { offset - toleratedOffsetDistance, offset + toleratedOffsetDistance },
+        { offset + wrappedDistanceMin, std::numeric_limits<int>::max() } });
+}
+
+int SectorOffsetIndex::UpperBound(int offset) const
+{
+    return static_cast<int>(std::upper_bound(m_offsetsAndIndices.begin(), m_offsetsAndIndices.end(),
+        OffsetAndIndex(offset, std::numeric_limits<int>::max())) - m_offsetsAndIndices.begin());
+}
+
+void SectorOffsetIndex::Insert(int index, int offset)
+{
+    if (m_sorted && index != UpperBound(offset))
+        m_sorted = false;
+    for (auto& offsetAndIndex : m_offsetsAndIndices)
+        if (offsetAndIndex.second >= index)
+            offsetAndIndex.second++;
+    const OffsetAndIndex inserted(offset, index);
+    m_offsetsAndIndices.insert(std::upper_bound(m_offsetsAndIndices.begin(), m_offsetsAndIndices.end(), inserted), inserted);
+}
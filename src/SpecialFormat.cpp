@@ -16,6 +16,7 @@
 #include <cctype>
 
 static auto& opt_debug = getOpt<int>("debug");
+static auto& opt_noweak = getOpt<int>("noweak");
 static auto& opt_normal_disk = getOpt<bool>("normal_disk");
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -241,6 +242,8 @@ TrackData GenerateSpectrumSpeedlockTrack(const CylHead& cylhead, const Track& tr
         }
 
         bitbuf.addSector(sector.header, data_copy, 0x2e, sector.dam, is_weak);
+        if (is_weak)
+            bitbuf.setWeakData(weak_offset, weak_size);
 
         // Add duplicate weak sector half way around track.
         if (&sector == &track[5])
@@ -345,6 +348,8 @@ TrackData GenerateCpcSpeedlockTrack(const CylHead& cylhead, const Track& track,
         }
 
         bitbuf.addSector(sector.header, data_copy, 0x2e, sector.dam, is_weak);
+        if (is_weak)
+            bitbuf.setWeakData(weak_offset, weak_size);
 
         // Add duplicate weak sector half way around track.
         if (&sector == &track[1])
@@ -426,6 +431,8 @@ TrackData GenerateRainbowArtsTrack(const CylHead& cylhead, const Track& track, i
         }
 
         bitbuf.addSector(sector.header, data_copy, 0x2e, sector.dam, is_weak);
+        if (is_weak)
+            bitbuf.setWeakData(weak_offset, weak_size);
 
         // Add duplicate weak sector half way around track.
         if (&sector == &track[5])
@@ -535,6 +542,8 @@ TrackData GenerateKBIWeakSectorTrack(const CylHead& cylhead, const Track& track,
         }
 
         bitbuf.addSector(sector.header, data_copy, 1, sector.dam, is_weak);
+        if (is_weak)
+            bitbuf.setWeakData(weak_offset, weak_size);
 
         // Insert the duplicate sector earlier on the track.
         if (&sector == &track[((sectors - 1) / 2) - 1])
@@ -554,6 +563,83 @@ TrackData GenerateKBIWeakSectorTrack(const CylHead& cylhead, const Track& track,
 
 ////////////////////////////////////////////////////////////////////////////////
 
+// Track with weak sector data located by flux analysis (see WeakBitAnalyser)?
+bool IsFluxWeakSectorTrack(const Track& track)
+{
+    if (opt_noweak || track.empty())
+        return false;
+
+    auto has_weak = false;
+    for (auto& sector : track)
+    {
+        if (sector.encoding != Encoding::MFM && sector.encoding != Encoding::FM)
+            return false;
+
+        if (sector.has_baddatacrc() && !sector.weak_regions.empty())
+            has_weak = true;
+    }
+
+    if (has_weak && opt_debug) util::cout << "detected flux weak sector track\n";
+    return has_weak;
+}
+
+TrackData GenerateFluxWeakSectorTrack(const CylHead& cylhead, const Track& track)
+{
+    assert(IsFluxWeakSectorTrack(track));
+
+    auto& sector0 = track[0];
+    FluxTrackBuilder fluxbuf(cylhead, sector0.datarate, sector0.encoding);
+    fluxbuf.addTrackStart();
+
+    BitstreamTrackBuilder bitbuf(sector0.datarate, sector0.encoding);
+    bitbuf.addTrackStart();
+
+    for (auto& sector : track)
+    {
+        auto gap3{ sector.gap3 ? sector.gap3 : 25 };
+        auto is_weak{ sector.has_data() && sector.has_baddatacrc() && !sector.weak_regions.empty() };
+
+        if (!is_weak)
+            fluxbuf.addSector(sector, gap3);
+        else
+        {
+            // Constant data between the weak ranges, with weak blocks in their place.
+            auto& data_copy = sector.data_copy();
+            auto data_size = std::min(data_copy.size(), sector.size());
+            auto pos = 0;
+
+            fluxbuf.setEncoding(sector.encoding);
+            fluxbuf.addSectorUpToData(sector.header, sector.dam);
+            for (const auto& region : sector.weak_regions)
+            {
+                auto weak_begin = std::min(region.Start(), data_size);
+                auto weak_end = std::min(region.End() + 1, data_size);
+
+                fluxbuf.addBlock(Data(data_copy.begin() + pos, data_copy.begin() + weak_begin));
+                fluxbuf.addWeakBlock(weak_end - weak_begin);
+                pos = weak_end;
+            }
+            fluxbuf.addBlock(Data(data_copy.begin() + pos, data_copy.begin() + data_size));
+            fluxbuf.addCrcBytes(true);
+            fluxbuf.addGap(gap3);
+        }
+
+        bitbuf.addSector(sector, gap3);
+        if (is_weak)
+        {
+            for (const auto& region : sector.weak_regions)
+                bitbuf.setWeakData(region.Start(), region.End() + 1 - region.Start());
+        }
+    }
+
+    TrackData trackdata(cylhead);
+    trackdata.add(std::move(bitbuf.buffer()));
+    trackdata.add(FluxData({ fluxbuf.buffer() }), true);
+    return trackdata;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 // Logo Professor track?
 bool IsLogoProfTrack(const Track& track)
 {
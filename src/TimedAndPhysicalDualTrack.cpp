@@ -12,10 +12,13 @@ inline int IndexInDirection(const int index, const int indexSup, const bool forw
 
 // The to be merged track must be multi track, it can contain orphan track.
 bool TimedAndPhysicalDualTrack::SyncDemultiMergePhysicalUsingTimed(
-    OrphanDataCapableTrack&& toBeMergedODCTrack, const RepeatedSectors& repeatedSectorIds)
+    OrphanDataCapableTrack&& toBeMergedODCTrack, const RepeatedSectors& repeatedSectorIds,
+    const int revolutionLen/* = 0*/)
 {
     const int trackLenAbout = timedIdDataAndPhysicalIdTrack.tracklen;
     assert(trackLenAbout > 0);
+    // The revolution of a sector is more exact by the measured revolution length of the physical track.
+    const auto physicalTrackLen = revolutionLen > 0 ? revolutionLen : trackLenAbout;
     if (toBeMergedODCTrack.empty())
         return false;
 
@@ -57,9 +60,13 @@ bool TimedAndPhysicalDualTrack::SyncDemultiMergePhysicalUsingTimed(
     auto lastPhysicalTrackSingleLocal = lastPhysicalTrackSingle;
     lastPhysicalTrackSingleLocal.setTrackLen(trackLenAbout);
     if (opt_debug >= 2)
-        util::cout << "SyncDemultiMergePhysicalUsingTimed: tracklenAbout = " << trackLenAbout << "\n";
+        util::cout << "SyncDemultiMergePhysicalUsingTimed: tracklenAbout = " << trackLenAbout
+            << ", physicalTrackLen = " << physicalTrackLen << "\n";
     std::set<int> MIDMergedSectorIndices;
     std::set<int> MIDMergedOrphanSectorIndices;
+    // The synced sectors are added together so the offsets of the local track are indexed once.
+    Sectors MIDSyncedSectors;
+    Sectors MIDSyncedOrphanSectors;
     const auto iMIDSup = MIDTrack.size();
     const auto iMIDOrphanSup = MIDOrphanDataTrack.size();
     auto lookForward = true;
@@ -113,14 +120,14 @@ bool TimedAndPhysicalDualTrack::SyncDemultiMergePhysicalUsingTimed(
                         if (round_AS<int>(MIDOrphanSectorAndBaseDistance / offsetDistanceAverage) > acceptedSectorIndexDistanceMax)
                             break;
                         auto MIDOrphanSectorCopy = MIDOrphanSector;
-                        MIDOrphanSectorCopy.revolution = MIDOrphanSectorCopy.offset / trackLenAbout;
+                        MIDOrphanSectorCopy.revolution = MIDOrphanSectorCopy.offset / physicalTrackLen;
                         MIDOrphanSectorCopy.offset = modulo(MIDOrphanSectorCopy.offset - syncOffset, trackLenAbout);
                         if (MIDOrphanSectorCopy.offset == 0)
                             MIDOrphanSectorCopy.offset = 1;
                         if (opt_debug >= 2)
                             util::cout << "SyncDemultiMergePhysicalUsingTimed: synced orphan sector from "
                             << MIDOrphanSector.offset << " to " << MIDOrphanSectorCopy.offset << ")\n";
-                        lastPhysicalTrackSingleLocal.orphanDataTrack.add(std::move(MIDOrphanSectorCopy));
+                        MIDSyncedOrphanSectors.emplace_back(std::move(MIDOrphanSectorCopy));
                         MIDMergedOrphanSectorIndices.emplace(IndexInDirection(iMIDOrphan, iMIDOrphanSup, lookForward));
                     }
                     iMIDSectorBase = iMIDSectorBaseNext;
@@ -164,18 +171,20 @@ bool TimedAndPhysicalDualTrack::SyncDemultiMergePhysicalUsingTimed(
                 continue;
             }
             auto MIDSectorCopy = MIDSector;
-            MIDSectorCopy.revolution = MIDSectorCopy.offset / trackLenAbout;
+            MIDSectorCopy.revolution = MIDSectorCopy.offset / physicalTrackLen;
             MIDSectorCopy.offset = modulo(MIDSectorCopy.offset - syncOffset, trackLenAbout);
             if (MIDSectorCopy.offset == 0)
                 MIDSectorCopy.offset = 1;
             if (opt_debug >= 2)
                 util::cout << "SyncDemultiMergePhysicalUsingTimed: synced sector ("
                 << MIDSectorCopy << ") from " << MIDSector.offset << " to " << MIDSectorCopy.offset << ")\n";
-            lastPhysicalTrackSingleLocal.track.add(std::move(MIDSectorCopy));
+            MIDSyncedSectors.emplace_back(std::move(MIDSectorCopy));
             MIDMergedSectorIndices.emplace(IndexInDirection(iMID, iMIDSup, lookForward));
         }
         lookForward = !lookForward;
     } while (!lookForward);
+    lastPhysicalTrackSingleLocal.track.add(std::move(MIDSyncedSectors));
+    lastPhysicalTrackSingleLocal.orphanDataTrack.add(std::move(MIDSyncedOrphanSectors));
     lastPhysicalTrackSingleLocal.MergeOrphansIntoParents(true);
 
     lastPhysicalTrackSingleLocal.cylheadMismatch = toBeMergedODCTrack.cylheadMismatch;
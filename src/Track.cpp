@@ -367,17 +367,52 @@ void Track::add(Sectors&& sectors, const std::function<bool (const Sector &)>& s
     if (sectors.empty())
         return;
 
-    // Merge supplied sectors into existing track.
+    // Merge supplied sectors into existing track, indexing the offsets once for all of them.
+    SectorOffsetIndex offsetIndex(m_sectors);
     for (auto& sector : sectors)
     {
         if (!sectorFilterPredicate || sectorFilterPredicate(sector))
         {
             assert(sector.offset != 0);
-            add(std::move(sector));
+            add(std::move(sector), offsetIndex);
         }
     }
 }
 
+// Same as add(Sector&&) but finding the sector by the offset index, which is updated.
+Track::AddResult Track::add(Sector&& sector, SectorOffsetIndex& offsetIndex)
+{
+    if (sector.offset == 0)
+    {
+        const auto index = m_sectors.size();
+        const auto result = add(std::move(sector));
+        offsetIndex.Insert(index, 0);
+        return result;
+    }
+
+    // Check the new datarate against any existing sector.
+    if (!m_sectors.empty() && getDataRate() != sector.datarate)
+        throw util::exception("can't mix datarates on a track");
+
+    // Find a sector close enough to the new offset to be the same one.
+    const auto toleratedOffsetDistance = tolerated_offset_distance(sector.encoding, opt_byte_tolerance_of_time);
+    for (const auto i : offsetIndex.FindToleratedSame(sector.offset, toleratedOffsetDistance, tracklen))
+    {
+        if (sector.is_sector_tolerated_same(m_sectors[i], opt_byte_tolerance_of_time, tracklen))
+            return merge(std::move(sector), m_sectors.begin() + i);
+    }
+
+    // Find the insertion point to keep the sectors in order, the index knows it if they are.
+    const auto offset = sector.offset;
+    const auto index = offsetIndex.IsSorted() ? offsetIndex.UpperBound(offset)
+        : static_cast<int>(std::find_if(begin(), end(), [&](const Sector& s) {
+            return offset < s.offset;
+            }) - begin());
+    m_sectors.emplace(m_sectors.begin() + index, std::move(sector));
+    offsetIndex.Insert(index, offset);
+    return AddResult::Insert;
+}
+
 Track::AddResult Track::merge(Sector&& sector, const Sectors::iterator& it)
 {
     if (getDataRate() != sector.datarate)
@@ -231,6 +231,7 @@ void TrackBuilder::addSectorData(const Data& data, int size, uint8_t dam/* = IBM
     assert(Sector::SizeCodeToLength(size) == Sector::SizeCodeToLength(size));
 
     addAM(dam);
+    justAddedDataAM();
 
     // Ensure the written data matches the sector size code.
     auto len_bytes{ Sector::SizeCodeToLength(size) };
@@ -299,6 +300,7 @@ void TrackBuilder::addSectorUpToData(const Header& header, uint8_t dam/* = IBM_D
     addSectorHeader(header);
     addGap2();
     addAM(dam);
+    justAddedDataAM();
 }
 
 
@@ -11,7 +11,9 @@
 #include "SAMCoupe.h"
 
 #include <cctype>
+#include <cstdio>
 #include <cstring>
+#include <mutex>
 #include <set>
 #include <string>
 #include <sys/stat.h>
@@ -21,6 +23,7 @@ static auto& opt_time = getOpt<int>("time");
 static auto& opt_verbose = getOpt<int>("verbose");
 
 std::set<std::string> seen_messages;
+std::mutex messages_mutex; // Messages can come from the reading threads of several disks.
 
 static uint32_t adwUsed[2][3];
 
@@ -116,6 +119,7 @@ void MessageCore(MsgType type, const std::string& msg)
     if (type == msgError)
         throw util::exception(msg);
 
+    std::lock_guard<std::mutex> lock(messages_mutex);
     if (type == msgInfo || type == msgFix || type == msgWarning)
     {
         if (seen_messages.find(msg) != seen_messages.end())
@@ -124,6 +128,10 @@ void MessageCore(MsgType type, const std::string& msg)
         seen_messages.insert(msg);
     }
 
+    // A message is written whole, so it skips any collecting of this thread's lines.
+    auto collecting = util::thread_output;
+    util::thread_output = nullptr;
+
     switch (type)
     {
     case msgStatus: break;
@@ -144,6 +152,8 @@ void MessageCore(MsgType type, const std::string& msg)
         util::cout << ttycmd::statusbegin << "\r" << msg << ttycmd::statusend;
     else
         util::cout << msg << colour::none << '\n';
+
+    util::thread_output = collecting;
 }
 
 const char* LastError()
@@ -262,6 +272,35 @@ int64_t FileSize(const std::string& path)
     return -1;
 }
 
+int64_t FileModTime(const std::string& path)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA wfad;
+    if (GetFileAttributesEx(path.c_str(), GetFileExInfoStandard, &wfad))
+    {
+        // Convert from 100ns units since 1601 to seconds since 1970
+        auto ft = (static_cast<int64_t>(wfad.ftLastWriteTime.dwHighDateTime) << 32) | wfad.ftLastWriteTime.dwLowDateTime;
+        return (ft - 116444736000000000LL) / 10000000;
+    }
+#else
+    struct stat st = {};
+    if (stat(path.c_str(), &st) == 0)
+        return st.st_mtime;
+#endif
+
+    return -1;
+}
+
+// Rename a file over any existing one, leaving one or the other if interrupted.
+bool RenameReplacing(const std::string& from_path, const std::string& to_path)
+{
+#ifdef _WIN32
+    return MoveFileEx(from_path.c_str(), to_path.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+#else
+    return std::rename(from_path.c_str(), to_path.c_str()) == 0;
+#endif
+}
+
 
 bool IsFile(const std::string& path)
 {
@@ -335,21 +374,36 @@ bool IsRecord(const std::string& path, int* pRecord)
     if (it == std::string::npos)
         return false;
 
-    // A record number must be present
+    // A record number or label must be present
     std::string strRecord = path.substr(it + 1);
-    if (strRecord.empty() || !std::isdigit(static_cast<uint8_t>(strRecord[0])))
+    if (strRecord.empty())
         return false;
 
-    // Extract the record number
-    size_t pos;
-    const auto record = lossless_static_cast<int>(std::stoul(strRecord, &pos, 0));
+    if (std::isdigit(static_cast<uint8_t>(strRecord[0])))
+    {
+        // Extract the record number
+        size_t pos;
+        const auto record = lossless_static_cast<int>(std::stoul(strRecord, &pos, 0));
+
+        // Valid if nothing remaining in string
+        if (pos == strRecord.length())
+        {
+            // Pass record number to caller if required
+            if (pRecord)
+                *pRecord = record;
+
+            return true;
+        }
+    }
+
+    // Otherwise accept a record label on an existing hard disk, to be found by FindBDOSRecord
+    if (strRecord.length() > BDOS_LABEL_SIZE || !HDD::IsRecognised(path.substr(0, it)))
+        return false;
 
-    // Pass record number to caller if required
     if (pRecord)
-        *pRecord = record;
+        *pRecord = -1;
 
-    // Valid if nothing remaining in string
-    return pos == strRecord.length();
+    return true;
 }
 
 bool IsTrinity(const std::string& path)
@@ -445,6 +499,7 @@ uint8_t* AllocMem(int len)
 
     auto size = len + align - 1 + longsizeof(void*);
     auto pv = calloc(1, static_cast<size_t>(size));
+    if (!pv) throw std::bad_alloc();
     void** ppv = reinterpret_cast<void**>((reinterpret_cast<uintptr_t>(pv) + static_cast<uintptr_t>(size - len)) & static_cast<uintptr_t>(~(align - 1)));
     ppv[-1] = pv;
     auto pb = reinterpret_cast<uint8_t*>(ppv);
@@ -655,6 +710,33 @@ void ByteSwap(void* pv, size_t len)
         std::swap(pb[i], pb[i + 1]);
 }
 
+// Whether the memory is all zero, checking 64 bytes at a time so it vectorises.
+bool IsZeroFilled(const void* pv, size_t len)
+{
+    auto pb = reinterpret_cast<const uint8_t*>(pv);
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64)
+    {
+        uint64_t words[8];
+        memcpy(words, pb + i, sizeof(words));
+
+        uint64_t any = 0;
+        for (auto word : words)
+            any |= word;
+        if (any)
+            return false;
+    }
+
+    for (; i < len; ++i)
+    {
+        if (pb[i])
+            return false;
+    }
+
+    return true;
+}
+
 
 void TrackUsedInit(Disk& disk)
 {
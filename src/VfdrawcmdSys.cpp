@@ -13,8 +13,11 @@
 #include "utils.h"
 
 #include <algorithm>
+#include <chrono>
+#include <thread>
 
 static auto& opt_debug = getOpt<int>("debug");
+static auto& opt_vfd_time_scale = getOpt<int>("vfd_time_scale");
 
 /*static*/ std::unique_ptr<VfdrawcmdSys> VfdrawcmdSys::Open(const std::string& path) // int device_index
 {
@@ -64,6 +67,103 @@ int VfdrawcmdSys::GetMaxTransferSize()
     return currentPhysicalTrack.m_physicalTrackContent.Bytes().size();
 }
 
+int64_t VfdrawcmdSys::GetElapsedTime() const
+{
+    return m_elapsedTime;
+}
+
+int VfdrawcmdSys::GetRotationalPosition() const
+{
+    return static_cast<int>(m_elapsedTime % RotationTime());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+VfdrawcmdSys::SimulatedCommand::SimulatedCommand(VfdrawcmdSys& vfdrawcmdSys, const char* name)
+    : m_vfdrawcmdSys(vfdrawcmdSys), m_name(name), m_startTime(vfdrawcmdSys.m_elapsedTime)
+{
+    m_vfdrawcmdSys.m_commandDepth++;
+}
+
+// Only the outermost command is reported, e.g. CmdScan calls CmdTimedMultiScan.
+VfdrawcmdSys::SimulatedCommand::~SimulatedCommand()
+{
+    if (--m_vfdrawcmdSys.m_commandDepth > 0)
+        return;
+
+    const auto took = m_vfdrawcmdSys.m_elapsedTime - m_startTime;
+    if (opt_debug >= 2)
+        util::cout << "vfd: " << m_name << " took " << took << " us, elapsed " << m_vfdrawcmdSys.m_elapsedTime << " us\n";
+    if (opt_vfd_time_scale > 0 && took > 0)
+        std::this_thread::sleep_for(std::chrono::microseconds(took * opt_vfd_time_scale / 100));
+}
+
+int64_t VfdrawcmdSys::SimulatedCommand::startTime() const
+{
+    return m_startTime;
+}
+
+// A 5.25" HD drive reads DD disks at 300K and 360 rpm, the others spin at 300 rpm.
+int VfdrawcmdSys::Rpm() const
+{
+    return m_fdrate == FD_RATE_300K ? 360 : 300;
+}
+
+int VfdrawcmdSys::RotationTime() const
+{
+    return 60'000'000 / Rpm();
+}
+
+// The FDC step rate is (16 - SRT) ms at 500K, scaled inversely with the data rate.
+int VfdrawcmdSys::StepTime() const
+{
+    const auto stepTimeAt500K = (16 - (m_stepRate & 0x0f)) * 1000;
+    switch (m_fdrate)
+    {
+        case FD_RATE_250K: return stepTimeAt500K * 2;
+        case FD_RATE_300K: return stepTimeAt500K * 5 / 3;
+        case FD_RATE_1M: return stepTimeAt500K / 2;
+        default: return stepTimeAt500K;
+    }
+}
+
+// The rotational position where the sector header starts passing under the head.
+int VfdrawcmdSys::SectorTime(const OrphanDataCapableTrack& orphanDataCapableTrack, const Sector& sector) const
+{
+    return orphanDataCapableTrack.getTimeOfOffset(sector.offset) % RotationTime();
+}
+
+void VfdrawcmdSys::AdvanceTime(int64_t time)
+{
+    if (time > 0)
+        m_elapsedTime += time;
+}
+
+void VfdrawcmdSys::AdvanceTimeToIndex()
+{
+    AdvanceTime(RotationTime() - GetRotationalPosition());
+}
+
+void VfdrawcmdSys::AdvanceTimeToSector(const OrphanDataCapableTrack& orphanDataCapableTrack, const Sector& sector)
+{
+    const auto rotationTime = RotationTime();
+    AdvanceTime((SectorTime(orphanDataCapableTrack, sector) - GetRotationalPosition() + rotationTime) % rotationTime);
+}
+
+// The FDC gives up looking for a sector when it sees the index pulse the given times.
+void VfdrawcmdSys::AdvanceTimeToIndexCountFrom(int64_t startTime, int count)
+{
+    const auto rotationTime = RotationTime();
+    const auto giveUpTime = (startTime / rotationTime + count) * rotationTime;
+    AdvanceTime(giveUpTime - m_elapsedTime);
+}
+
+void VfdrawcmdSys::AdvanceTimeBySteps(int steps)
+{
+    if (steps != 0)
+        AdvanceTime(static_cast<int64_t>(std::abs(steps)) * StepTime() + m_headSettleTime * 1000);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 bool VfdrawcmdSys::GetVersion(util::Version& version)
@@ -117,6 +217,9 @@ bool VfdrawcmdSys::AdvanceSectorIndexByFindingSectorIds(const OrphanDataCapableT
 void VfdrawcmdSys::WaitIndex(int head/* = -1*/, const bool calcSpinTime/* = false*/)
 {
     m_currentSectorIndex = 0; // alias WaitIndex in fdrawcmd.
+    if (head >= 0)
+        m_currentCylHead = CylHead(m_cyl, head);
+    AdvanceTimeToIndex();
     if (calcSpinTime)
     {
         const auto& orphanDataCapableTrack = ReadTrackFromPhysicalTrack(CylHead(m_cyl, head));
@@ -190,6 +293,35 @@ OrphanDataCapableTrack& VfdrawcmdSys::ReadTrackFromPhysicalTrack(const CylHead&
     return m_odcTracks[cylhead];
 }
 
+/* Return the track under the head. When the head has moved to another track
+ * since the last sector was seen then the next sector is the one whose header
+ * comes first from the current rotational position.
+ */
+const OrphanDataCapableTrack& VfdrawcmdSys::ReadTrackUnderHead(int head)
+{
+    const CylHead cylhead(m_cyl, head);
+    const auto& orphanDataCapableTrack = ReadTrackFromPhysicalTrack(cylhead);
+    if (cylhead.cyl != m_currentCylHead.cyl || cylhead.head != m_currentCylHead.head)
+    {
+        m_currentCylHead = cylhead;
+        m_currentSectorIndex = 0;
+        const auto rotationTime = RotationTime();
+        const auto position = GetRotationalPosition();
+        auto bestDistance = rotationTime;
+        const auto iSup = orphanDataCapableTrack.track.size();
+        for (auto i = 0; i < iSup; i++)
+        {
+            const auto distance = (SectorTime(orphanDataCapableTrack, orphanDataCapableTrack.track[i]) - position + rotationTime) % rotationTime;
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                m_currentSectorIndex = lossless_static_cast<uint8_t>(i);
+            }
+        }
+    }
+    return orphanDataCapableTrack;
+}
+
 bool VfdrawcmdSys::SetEncRate(Encoding encoding, DataRate datarate)
 {
     const auto fdrate = datarateToFdRate(datarate);
@@ -202,8 +334,9 @@ bool VfdrawcmdSys::SetEncRate(Encoding encoding, DataRate datarate)
     return true;
 }
 
-bool VfdrawcmdSys::SetHeadSettleTime(int /*ms*/)
+bool VfdrawcmdSys::SetHeadSettleTime(int ms)
 {
+    m_headSettleTime = ms;
     return true;
 }
 
@@ -240,28 +373,35 @@ bool VfdrawcmdSys::Configure(uint8_t /*eis_efifo_poll_fifothr*/, uint8_t /*pretr
     return true;
 }
 
-bool VfdrawcmdSys::Specify(int /*step_rate*/, int /*head_unload_time*/, int /*head_load_time*/)
+bool VfdrawcmdSys::Specify(int step_rate, int /*head_unload_time*/, int /*head_load_time*/)
 {
-    // step_rate is a coded number between 0 and 15. Not supporting it here.
+    // step_rate is a coded number between 0 and 15, used by the simulated stepping.
+    m_stepRate = step_rate & 0x0f;
     return true;
 }
 
 bool VfdrawcmdSys::Recalibrate()
 {
-    return true;
+    return Seek(0);
 }
 
 bool VfdrawcmdSys::Seek(int cyl, int /*head*//*= -1*/)
 {
+    SimulatedCommand simulatedCommand(*this, "Seek");
+    const auto cylFrom = m_cyl;
     m_cyl = cyl;
     LimitCyl();
+    AdvanceTimeBySteps(m_cyl - cylFrom);
     return true;
 }
 
 bool VfdrawcmdSys::RelativeSeek(int /*head*/, int offset)
 {
+    SimulatedCommand simulatedCommand(*this, "RelativeSeek");
+    const auto cylFrom = m_cyl;
     m_cyl += offset;
     LimitCyl();
+    AdvanceTimeBySteps(m_cyl - cylFrom);
     return true;
 }
 
@@ -312,6 +452,11 @@ bool VfdrawcmdSys::CmdReadTrack(int phead, int /*cyl*/, int /*head*/, int /*sect
         mem.resize(output_size);
     // mem.size >= output_size now.
 
+    // Reading the track starts at the index and takes a whole revolution.
+    SimulatedCommand simulatedCommand(*this, "ReadTrack");
+    AdvanceTimeToIndex();
+    AdvanceTime(RotationTime());
+
     const auto currentPhysicalTrack = LoadPhysicalTrack(CylHead(m_cyl, phead));
     const auto availSize = std::min(currentPhysicalTrack.m_physicalTrackContent.Bytes().size(), output_size);
     mem.copyFrom(currentPhysicalTrack.m_physicalTrackContent.Bytes(), availSize);
@@ -328,26 +473,29 @@ bool VfdrawcmdSys::CmdRead(int phead, int cyl, int head, int sector, int size, i
     const auto sectorSize = Sector::SizeCodeToRealLength(static_cast<uint8_t>(size));
     const auto totalSize = count * sectorSize;
     auto i_dataOffset = lossless_static_cast<int>(data_offset);
-    if (mem.size - i_dataOffset > totalSize)
+    if (mem.size - i_dataOffset < totalSize)
     {
         SetLastError_MP(STATUS_BUFFER_TOO_SMALL);
         return false;
     }
 
+    SimulatedCommand simulatedCommand(*this, "Read");
     // Must set result.
     m_result.st0 = 0;
     m_result.st1 = 0;
     m_result.st2 = 0;
     if (m_encoding_flags == FD_OPTION_MFM && m_fdrate == FD_RATE_250K)
     {
-        const auto& orphanDataCapableTrack = ReadTrackFromPhysicalTrack(CylHead(m_cyl, phead));
+        const auto& orphanDataCapableTrack = ReadTrackUnderHead(phead);
         if (WaitSector(orphanDataCapableTrack) && !orphanDataCapableTrack.track.empty())
         {
-            const auto sectorIndexStart = m_currentSectorIndex;
+            // Like the FDC, search each of the consecutive sector ids for up to a revolution.
+            auto sectorIndexStart = m_currentSectorIndex;
             auto loopedOnceAtLeast = false;
             do
             {
                 const auto& sectorCurrent = orphanDataCapableTrack.track[m_currentSectorIndex];
+                AdvanceTimeToSector(orphanDataCapableTrack, sectorCurrent);
                 bool looped;
                 if (AdvanceSectorIndexByFindingSectorIds(orphanDataCapableTrack, 1, &looped) && looped)
                     loopedOnceAtLeast = true;
@@ -365,15 +513,32 @@ bool VfdrawcmdSys::CmdRead(int phead, int cyl, int head, int sector, int size, i
                         SetLastError_MP(ERROR_SECTOR_NOT_FOUND);
                         return false;
                     }
+                    AdvanceTime(orphanDataCapableTrack.getTimeOfOffset(DataBytePositionAsBitOffset(
+                        GetFmOrMfmSectorOverheadFromOffsetToDataCrcEnd(orphanDataCapableTrack.getDataRate(),
+                        orphanDataCapableTrack.getEncoding(), sectorSize), orphanDataCapableTrack.getEncoding())));
                     mem.copyFrom(sectorCurrent.data_copy(), sectorSize, i_dataOffset);
+                    // Like the FDC, stop at a data CRC error without incrementing the sector id.
+                    if (sectorCurrent.has_baddatacrc())
+                    {
+                        m_result.st0 = 0x40; // Abnormal termination.
+                        m_result.st1 = STREG1_DATA_ERROR;
+                        m_result.st2 = STREG2_DATA_ERROR_IN_DATA_FIELD;
+                        SetLastError_MP(ERROR_CRC);
+                        return false;
+                    }
                     i_dataOffset += sectorSize;
                     count--;
+                    // The FDC increments the sector id in its result after reading the sector.
+                    m_result.sector = lossless_static_cast<uint8_t>(++sector);
+                    sectorIndexStart = m_currentSectorIndex;
+                    loopedOnceAtLeast = false;
                 }
             } while(count > 0 && (!loopedOnceAtLeast || m_currentSectorIndex < sectorIndexStart));
         }
     }
     if (count != 0)
     {
+        AdvanceTimeToIndexCountFrom(simulatedCommand.startTime(), 2);
         m_result.st1 = STREG1_MISSING_ADDRESS_MARK;
         SetLastError_MP(ERROR_FLOPPY_ID_MARK_NOT_FOUND);
     }
@@ -494,7 +659,9 @@ bool VfdrawcmdSys::CmdTimedMultiScan(int head, int track_retries,
         return true;
     }
 
+    SimulatedCommand simulatedCommand(*this, "TimedMultiScan");
     WaitIndex(head, true);
+    AdvanceTime(static_cast<int64_t>(std::max(1, std::abs(track_retries))) * RotationTime());
 
     timed_multi_scan->byte_tolerance_of_time = byte_tolerance_of_time < 0 ? Track::COMPARE_TOLERANCE_BYTES : lossless_static_cast<uint8_t>(byte_tolerance_of_time);
     timed_multi_scan->tracktime = lossless_static_cast<uint32_t>(m_trackTime);
@@ -579,6 +746,7 @@ bool VfdrawcmdSys::CmdTimedMultiScan(int head, int track_retries,
 
 bool VfdrawcmdSys::CmdReadId(int head, FD_CMD_RESULT& result)
 {
+    SimulatedCommand simulatedCommand(*this, "ReadId");
     // Must set result.
     m_result.st0 = 0;
     m_result.st1 = 0;
@@ -586,10 +754,13 @@ bool VfdrawcmdSys::CmdReadId(int head, FD_CMD_RESULT& result)
     bool foundId = false;
     if (m_encoding_flags == FD_OPTION_MFM && m_fdrate == FD_RATE_250K)
     {
-        const auto& orphanDataCapableTrack = ReadTrackFromPhysicalTrack(CylHead(m_cyl, head));
+        const auto& orphanDataCapableTrack = ReadTrackUnderHead(head);
         if (WaitSector(orphanDataCapableTrack) && !orphanDataCapableTrack.track.empty())
         {
             const auto& sectorCurrent = orphanDataCapableTrack.track[m_currentSectorIndex];
+            AdvanceTimeToSector(orphanDataCapableTrack, sectorCurrent);
+            AdvanceTime(orphanDataCapableTrack.getTimeOfOffset(DataBytePositionAsBitOffset(
+                GetIdOverhead(orphanDataCapableTrack.getEncoding()), orphanDataCapableTrack.getEncoding())));
             AdvanceSectorIndexByFindingSectorIds(orphanDataCapableTrack);
             m_result.cyl = lossless_static_cast<uint8_t>(sectorCurrent.header.cyl);
             m_result.head = lossless_static_cast<uint8_t>(sectorCurrent.header.head);
@@ -600,6 +771,7 @@ bool VfdrawcmdSys::CmdReadId(int head, FD_CMD_RESULT& result)
     }
     if (!foundId)
     {
+        AdvanceTimeToIndexCountFrom(simulatedCommand.startTime(), 2);
         m_result.st1 = STREG1_MISSING_ADDRESS_MARK;
         SetLastError_MP(ERROR_FLOPPY_ID_MARK_NOT_FOUND);
     }
@@ -640,7 +812,9 @@ bool VfdrawcmdSys::FdCheckDisk()
 
 bool VfdrawcmdSys::FdGetTrackTime(int& microseconds)
 {
+    SimulatedCommand simulatedCommand(*this, "GetTrackTime");
     WaitIndex(0, true);
+    AdvanceTime(RotationTime());
 
     microseconds = m_trackTime;
     return true;
@@ -651,7 +825,9 @@ bool VfdrawcmdSys::FdGetMultiTrackTime(FD_MULTI_TRACK_TIME_RESULT& track_time, u
     if (revolutions == 0)
         throw util::exception("unsupported revolutions (", revolutions, ")");
 
+    SimulatedCommand simulatedCommand(*this, "GetMultiTrackTime");
     WaitIndex(0, true);
+    AdvanceTime(static_cast<int64_t>(revolutions) * RotationTime());
 
     track_time.spintime = lossless_static_cast<uint32_t>(m_trackTime);
     return true;
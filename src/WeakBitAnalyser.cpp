@@ -0,0 +1,118 @@
+// Weak sector detection from cross-revolution flux timing
+
+#include "WeakBitAnalyser.h"
+#include "Options.h"
+
+#include <algorithm>
+#include <limits>
+
+static auto& opt_debug = getOpt<int>("debug");
+static auto& opt_noweak = getOpt<int>("noweak");
+
+WeakBitAnalyser::WeakBitAnalyser(const BitBuffer& bitbuf)
+    : m_bitbuf(bitbuf)
+{
+}
+
+// Analysis needs bitstream timing, which is only available when decoding flux.
+bool WeakBitAnalyser::usable() const
+{
+    return !opt_noweak && m_bitbuf.has_jitter();
+}
+
+void WeakBitAnalyser::add_copy(int bitpos, int shift, const Data& data)
+{
+    if (usable())
+        m_copies.push_back({ bitpos, shift, data });
+}
+
+// Mean phase error over the bitcells of a single data byte.
+int WeakBitAnalyser::byte_jitter(const DataCopy& copy, int index) const
+{
+    auto begin = copy.bitpos + (index << copy.shift);
+    auto end = begin + (1 << copy.shift);
+
+    // Jitter is held for each group of 8 bitcells.
+    auto total = 0, samples = 0;
+    for (auto pos = begin; pos < end; pos += 8, ++samples)
+        total += m_bitbuf.jitter(pos);
+
+    return samples ? total / samples : 0;
+}
+
+WeakRegions WeakBitAnalyser::analyse(int data_size) const
+{
+    WeakRegions regions;
+    if (m_copies.empty())
+        return regions;
+
+    auto weak_start = -1, weak_end = -1;
+
+    for (auto i = 0; i < data_size; ++i)
+    {
+        auto present = 0, jitter_sum = 0;
+        auto jitter_min = std::numeric_limits<int>::max(), jitter_max = 0;
+        auto value = -1;
+        auto differs = false;
+
+        for (const auto& copy : m_copies)
+        {
+            if (i >= copy.data.size())
+                continue;
+
+            if (value < 0)
+                value = copy.data[i];
+            else if (copy.data[i] != value)
+                differs = true;
+
+            auto jitter = byte_jitter(copy, i);
+            jitter_sum += jitter;
+            jitter_min = std::min(jitter_min, jitter);
+            jitter_max = std::max(jitter_max, jitter);
+            ++present;
+        }
+
+        if (!present)
+            break;
+
+        // Timing alone needs more than one revolution, or ordinary damage would look weak.
+        auto weak = differs || (present > 1 &&
+            (jitter_sum / present >= JITTER_PERCENT_MIN || jitter_max - jitter_min >= JITTER_SPREAD_PERCENT_MIN));
+
+        if (!weak)
+            continue;
+
+        // Extend the current range if close enough, otherwise close it and start another.
+        if (weak_start >= 0 && i - weak_end <= MERGE_GAP_BYTES)
+            weak_end = i;
+        else
+        {
+            if (weak_start >= 0)
+                regions.emplace_back(weak_start, weak_end - weak_start + 1, Interval<int>::StartAndSize);
+            weak_start = weak_end = i;
+        }
+    }
+
+    if (weak_start >= 0)
+        regions.emplace_back(weak_start, weak_end - weak_start + 1, Interval<int>::StartAndSize);
+
+    return regions;
+}
+
+// Record the weak ranges on a sector. Sectors with good data are never weak.
+void WeakBitAnalyser::analyse(Sector& sector) const
+{
+    if (m_copies.empty() || !sector.has_baddatacrc())
+        return;
+
+    sector.weak_regions = analyse(sector.size());
+
+    if (opt_debug && !sector.weak_regions.empty())
+    {
+        util::cout << "  weak analysis found " << sector.weak_regions.size() << " weak range(s) in sector " <<
+            sector.header.sector << " from " << m_copies.size() << " copies:";
+        for (const auto& region : sector.weak_regions)
+            util::cout << ' ' << region;
+        util::cout << '\n';
+    }
+}
@@ -0,0 +1,521 @@
+// Batch command
+
+#include "SAMdisk.h"
+#include "FileIO.h"
+#include "MemFile.h"
+#include "Options.h"
+#include "ThreadPool.h"
+#include "Util.h"
+#include "types.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+static auto& opt_jobmemory = getOpt<int>("jobmemory");
+static auto& opt_jobs = getOpt<int>("jobs");
+static auto& opt_report = getOpt<std::string>("report");
+static auto& opt_tty = getOpt<int>("tty");
+static auto& opt_szSource = getOpt<charArrayMAX_PATH>("szSource");
+static auto& opt_szTarget = getOpt<charArrayMAX_PATH>("szTarget");
+
+struct BatchJob
+{
+    std::string src_path{};
+    std::string dst_path{};
+    bool ok = false;
+    std::string error{};
+    int64_t elapsed_ms = 0;
+};
+
+
+static bool IsWildcardMatch(const char* pattern, const char* name)
+{
+    for (; *pattern; ++pattern, ++name)
+    {
+        if (*pattern == '*')
+        {
+            for (;; ++name)
+            {
+                if (IsWildcardMatch(pattern + 1, name))
+                    return true;
+                if (!*name)
+                    return false;
+            }
+        }
+
+        if (!*name || (*pattern != '?' && std::tolower(static_cast<uint8_t>(*pattern)) != std::tolower(static_cast<uint8_t>(*name))))
+            return false;
+    }
+
+    return !*name;
+}
+
+static bool IsImageName(const std::string& name, bool allow_archives)
+{
+    if (allow_archives && (IsFileExt(name, "zip") || IsFileExt(name, "gz") || IsFileExt(name, "bz2") || IsFileExt(name, "xz")))
+        return true;
+
+    for (auto p = aImageTypes; p->pszType; ++p)
+    {
+        if (p->pfnRead && *p->pszType && IsFileExt(name, p->pszType))
+            return true;
+    }
+
+    return false;
+}
+
+static std::string RemoveExt(const std::string& path)
+{
+    auto sep = path.find_last_of("/\\");
+    auto dot = path.rfind('.');
+    return (dot == std::string::npos || (sep != std::string::npos && dot < sep)) ? path : path.substr(0, dot);
+}
+
+// Zip entry names become part of the target path, so they must stay below it.
+static bool IsSafeEntryName(const std::string& entry)
+{
+    if (entry.empty() || entry[0] == '/' || entry[0] == '\\' || entry.find(':') != std::string::npos)
+        return false;
+
+    for (size_t start = 0, end; start <= entry.length(); start = end + 1)
+    {
+        end = entry.find_first_of("/\\", start);
+        if (end == std::string::npos)
+            end = entry.length();
+        if (entry.compare(start, end - start, "..") == 0)
+            return false;
+    }
+
+    return true;
+}
+
+// Add a source file, or each image inside it if it's a zip of several.
+static void AddBatchSource(const std::string& path, const std::string& rel_path,
+    std::vector<std::pair<std::string, std::string>>& sources)
+{
+    if (IsFileExt(path, "zip"))
+    {
+        auto entries = MemFile::zip_entries(path);
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+            [](const std::string& entry) { return !IsImageName(entry, false); }), entries.end());
+
+        // A single image is opened from the zip as copy does, without naming it
+        if (entries.size() > 1)
+        {
+            for (auto& entry : entries)
+            {
+                if (IsSafeEntryName(entry))
+                    sources.emplace_back(path + ":" + entry, RemoveExt(rel_path) + PATH_SEPARATOR_CHR + entry);
+                else
+                    Message(msgWarning, "ignoring %s:%s, as its name leaves the target directory", path.c_str(), entry.c_str());
+            }
+            return;
+        }
+    }
+
+    sources.emplace_back(path, rel_path);
+}
+
+static void FindBatchSources(const std::string& dir, const std::string& rel_dir,
+    std::vector<std::pair<std::string, std::string>>& sources)
+{
+    auto paths = FindFiles("", dir);
+    std::sort(paths.begin(), paths.end());
+
+    for (auto& path : paths)
+    {
+        auto name = path.substr(dir.length() + 1);
+        if (name == "." || name == "..")
+            continue;
+
+        auto rel_path = rel_dir.empty() ? name : rel_dir + PATH_SEPARATOR_CHR + name;
+        if (IsDir(path))
+            FindBatchSources(path, rel_path, sources);
+        else if (IsImageName(name, true))
+            AddBatchSource(path, rel_path, sources);
+    }
+}
+
+// Expand a directory tree, wildcard or zip file into source paths, each paired
+// with the relative path used to name its target.
+static std::vector<std::pair<std::string, std::string>> FindBatchSources(const std::string& src)
+{
+    std::vector<std::pair<std::string, std::string>> sources;
+
+    auto sep = src.find_last_of("/\\");
+    auto dir = (sep == std::string::npos) ? std::string(".") : src.substr(0, sep);
+    auto name = (sep == std::string::npos) ? src : src.substr(sep + 1);
+
+    if (IsDir(src))
+    {
+        auto root = src;
+        while (root.length() > 1 && (root.back() == '/' || root.back() == PATH_SEPARATOR_CHR))
+            root.pop_back();
+        FindBatchSources(root, "", sources);
+    }
+    else if (name.find_first_of("*?") != std::string::npos)
+    {
+        auto paths = FindFiles("", dir);
+        std::sort(paths.begin(), paths.end());
+
+        for (auto& path : paths)
+        {
+            auto file_name = path.substr(dir.length() + 1);
+            if (IsWildcardMatch(name.c_str(), file_name.c_str()) && IsFile(path))
+                AddBatchSource(path, file_name, sources);
+        }
+    }
+    else if (IsFile(src))
+        AddBatchSource(src, name, sources);
+    else
+        throw posix_error(ENOENT, src.c_str());
+
+    return sources;
+}
+
+static void MakeDirs(const std::string& file_path)
+{
+    for (auto pos = file_path.find_first_of("/\\", 1); pos != std::string::npos; pos = file_path.find_first_of("/\\", pos + 1))
+    {
+        auto dir = file_path.substr(0, pos);
+        if (IsDir(dir))
+            continue;
+#ifdef _WIN32
+        if (_mkdir(dir.c_str()) != 0 && errno != EEXIST)
+#else
+        if (mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST)
+#endif
+            throw posix_error(errno, dir.c_str());
+    }
+}
+
+// Convert a single image, exactly as the copy command would.
+static bool RunBatchJob(const BatchJob& job)
+{
+    bool f = false;
+
+    strncpy(opt_szSource, job.src_path.c_str(), sizeof(opt_szSource) - 1);
+    strncpy(opt_szTarget, job.dst_path.c_str(), sizeof(opt_szTarget) - 1);
+
+    try
+    {
+        f = ImageToImage(job.src_path, job.dst_path);
+    }
+    catch (std::string & e)
+    {
+        util::cout << "Error: " << colour::RED << e << colour::none << '\n';
+    }
+    catch (std::exception & e)
+    {
+        util::cout << colour::RED << "Error: " << e.what() << colour::none << '\n';
+    }
+    catch (...)
+    {
+        util::cout << colour::RED << "Error: unknown exception" << colour::none << '\n';
+    }
+
+    util::cout << colour::none << "";
+    std::cout.flush();
+    return f;
+}
+
+// Return job output as it would be left on screen, without overwritten status
+// text. Workers write as if to a terminal, so status text is always cleared
+// with a carriage return before the next regular output.
+static std::string ScreenText(const std::string& output)
+{
+    std::string text;
+
+    for (size_t start = 0, end; (end = output.find('\n', start)) != std::string::npos; start = end + 1)
+    {
+        auto cr = output.rfind('\r', end);
+        auto line_start = (cr == std::string::npos || cr < start) ? start : cr + 1;
+        text += output.substr(line_start, end + 1 - line_start);
+    }
+
+    return text;
+}
+
+static std::string RemoveColours(const std::string& text)
+{
+    std::string plain;
+
+    for (size_t i = 0; i < text.length(); ++i)
+    {
+        if (text[i] != '\x1b')
+            plain += text[i];
+        else if ((i = text.find_first_of("mK", i)) == std::string::npos)
+            break;
+    }
+
+    return plain;
+}
+
+// Extract the last error reported in job output.
+static std::string LastErrorLine(const std::string& text)
+{
+    std::string error;
+    std::istringstream ss(RemoveColours(text));
+
+    for (std::string line; std::getline(ss, line); )
+    {
+        auto pos = line.find("Error: ");
+        if (pos != std::string::npos)
+            error = line.substr(pos + 7);
+    }
+
+    return error;
+}
+
+static std::string CsvField(const std::string& str)
+{
+    if (str.find_first_of(",\"\n") == std::string::npos)
+        return str;
+
+    std::string quoted = "\"";
+    for (auto c : str)
+        quoted += (c == '"') ? std::string("\"\"") : std::string(1, c);
+    return quoted + "\"";
+}
+
+static void WriteBatchReport(const std::string& path, const std::vector<BatchJob>& jobs)
+{
+    std::ofstream file(path, std::ios::trunc);
+    file << "source,target,result,time_ms,error\n";
+
+    for (auto& job : jobs)
+    {
+        file << CsvField(job.src_path) << ',' << CsvField(job.dst_path) << ',' <<
+            (job.ok ? "ok" : "failed") << ',' << job.elapsed_ms << ',' << CsvField(job.error) << '\n';
+    }
+
+    if (!file.flush())
+        throw util::exception("write error (report ", path, ")");
+}
+
+#ifndef _WIN32
+// Run the jobs in forked worker processes, so each starts from the options
+// and state of this one, as a separate copy command would, and leaves
+// nothing behind for the next. Output is captured to show once complete.
+static void RunBatchJobs(std::vector<BatchJob>& jobs, int max_workers)
+{
+    struct Worker
+    {
+        size_t job = 0;
+        util::unique_FILE_t output{};
+        std::chrono::steady_clock::time_point start_time{};
+    };
+
+    std::map<pid_t, Worker> workers;
+    size_t next_job = 0, done = 0;
+
+    while (done < jobs.size())
+    {
+        while (next_job < jobs.size() && static_cast<int>(workers.size()) < max_workers)
+        {
+            auto& job = jobs[next_job];
+            MakeDirs(job.dst_path);
+
+            util::unique_FILE_t output{ tmpfile() };
+            if (!output)
+                throw posix_error(errno, "tmpfile");
+
+            // Flush so buffered output isn't repeated by the worker
+            std::cout.flush();
+            fflush(stdout);
+
+            auto start_time = std::chrono::steady_clock::now();
+            auto pid = fork();
+            if (pid < 0)
+                throw posix_error(errno, "fork");
+
+            // The worker must always exit here, never unwind into the batch loop
+            if (pid == 0)
+            {
+                auto ok = false;
+                try
+                {
+                    dup2(fileno(output.get()), STDOUT_FILENO);
+                    dup2(fileno(output.get()), STDERR_FILENO);
+                    opt_tty = 1;
+
+                    if (opt_jobmemory > 0)
+                    {
+                        struct rlimit rl {};
+                        rl.rlim_cur = rl.rlim_max = static_cast<rlim_t>(opt_jobmemory) << 20;
+                        setrlimit(RLIMIT_AS, &rl);
+                    }
+
+                    ok = RunBatchJob(job);
+                }
+                catch (...)
+                {
+                }
+
+                _exit(ok ? 0 : 1);
+            }
+
+            workers[pid] = Worker{ next_job++, std::move(output), start_time };
+        }
+
+        int status = 0;
+        auto pid = waitpid(-1, &status, 0);
+        if (pid < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw posix_error(errno, "waitpid");
+        }
+
+        auto it = workers.find(pid);
+        if (it == workers.end())
+            continue;
+
+        auto& worker = it->second;
+        auto& job = jobs[worker.job];
+        job.elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - worker.start_time).count();
+        job.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+        std::string output;
+        rewind(worker.output.get());
+        char buf[4096];
+        for (size_t len; (len = fread(buf, 1, sizeof(buf), worker.output.get())) > 0; )
+            output.append(buf, len);
+        output = ScreenText(output);
+
+        if (!job.ok)
+        {
+            job.error = LastErrorLine(output);
+            if (WIFSIGNALED(status))
+                job.error = util::fmt("killed by signal %d", WTERMSIG(status));
+            else if (job.error.empty())
+                job.error = "failed";
+        }
+
+        ++done;
+        Message(msgStatus, "Converted %u of %u...", static_cast<unsigned>(done), static_cast<unsigned>(jobs.size()));
+
+        if (!output.empty())
+            util::cout << job.src_path << ":\n" << (util::is_stdout_a_tty() ? output : RemoveColours(output));
+
+        workers.erase(it);
+    }
+}
+#else
+// Without fork, run the jobs in turn in this process.
+static void RunBatchJobs(std::vector<BatchJob>& jobs, int /*max_workers*/)
+{
+    if (opt_jobmemory > 0)
+        Message(msgWarning, "job memory limit is not supported on this platform");
+
+    for (auto& job : jobs)
+    {
+        Message(msgStatus, "Converting %s...", job.src_path.c_str());
+        MakeDirs(job.dst_path);
+
+        auto start_time = std::chrono::steady_clock::now();
+        job.ok = RunBatchJob(job);
+        job.elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start_time).count();
+        if (!job.ok)
+            job.error = "failed";
+    }
+}
+#endif
+
+// Convert a directory tree, wildcard or zip of images to the image type given
+// by a target pattern such as out/*.dsk, where * is replaced by the relative
+// path of each source without its extension.
+bool BatchConvert(const std::string& src, const std::string& dst_pattern)
+{
+    auto star = dst_pattern.find('*');
+    if (star == std::string::npos || dst_pattern.find('*', star + 1) != std::string::npos)
+        throw util::exception("batch target must contain a single * (e.g. out/*.dsk)");
+
+    auto dst_prefix = dst_pattern.substr(0, star);
+    auto dst_suffix = dst_pattern.substr(star + 1);
+
+    // Fail early if the target type can't be written
+    auto p = aImageTypes;
+    for (; p->pszType; ++p)
+        if (IsFileExt(dst_suffix, p->pszType))
+            break;
+    if (!p->pszType)
+        throw util::exception("unknown output file type");
+    else if (!p->pfnWrite)
+        throw util::exception(util::format(p->pszType, " is not supported for output"));
+
+    auto sources = FindBatchSources(src);
+    if (sources.empty())
+        throw util::exception("no images found (", src, ")");
+
+    // Sources differing only by extension keep it in their target names,
+    // so the workers never write to the same file.
+    std::map<std::string, int> target_counts;
+    for (auto& source : sources)
+        ++target_counts[util::lowercase(RemoveExt(source.second))];
+
+    std::vector<BatchJob> jobs;
+    std::map<std::string, std::string> target_sources;
+    for (auto& source : sources)
+    {
+        BatchJob job;
+        job.src_path = source.first;
+        auto name = (target_counts[util::lowercase(RemoveExt(source.second))] > 1) ? source.second : RemoveExt(source.second);
+        job.dst_path = dst_prefix + name + dst_suffix;
+
+        auto it = target_sources.emplace(util::lowercase(job.dst_path), job.src_path).first;
+        if (it->second != job.src_path)
+            throw util::exception(it->second, " and ", job.src_path, " would both be written to ", job.dst_path);
+
+        jobs.push_back(std::move(job));
+    }
+
+    auto max_workers = (opt_jobs > 0) ? opt_jobs : ThreadPool::get_thread_count();
+    auto start_time = std::chrono::steady_clock::now();
+    RunBatchJobs(jobs, max_workers);
+    auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start_time).count();
+
+    auto report_path = opt_report;
+    if (report_path.empty())
+    {
+        auto sep = dst_prefix.find_last_of("/\\");
+        report_path = ((sep == std::string::npos) ? std::string() : dst_prefix.substr(0, sep + 1)) + "samdisk-batch.csv";
+    }
+    MakeDirs(report_path);
+    WriteBatchReport(report_path, jobs);
+
+    auto failed = std::count_if(jobs.begin(), jobs.end(), [](const BatchJob& job) { return !job.ok; });
+    if (failed)
+    {
+        util::cout << "\nFailed:\n";
+        for (auto& job : jobs)
+            if (!job.ok)
+                util::cout << ' ' << job.src_path << ": " << colour::RED << job.error << colour::none << '\n';
+    }
+
+    util::cout << util::fmt("\nConverted %u of %u images in %.1fs", static_cast<unsigned>(jobs.size() - failed),
+        static_cast<unsigned>(jobs.size()), elapsed_ms / 1000.0);
+    if (failed)
+        util::cout << ", " << colour::RED << failed << " failed" << colour::none;
+    util::cout << " (report: " << report_path << ")\n";
+
+    return !failed;
+}
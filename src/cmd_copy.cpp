@@ -7,24 +7,30 @@
 #include "Interval.h"
 #include "Options.h"
 #include "DiskUtil.h"
+#include "HddManifest.h"
 #include "Image.h"
 #include "MemFile.h"
 #include "SAMCoupe.h"
 #include "RepairSummaryDisk.h"
+#include "RescueCheckpoint.h"
 #include "Trinity.h"
 #include "Util.h"
 #include "utils.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstring>
 #include <fstream>
+#include <future>
 
 static auto& opt_base = getOpt<int>("base");
 static auto& opt_detect_devfs = getOpt<std::string>("detect_devfs");
 static auto& opt_encoding = getOpt<Encoding>("encoding");
 static auto& opt_disk_retries = getOpt<RetryPolicy>("disk_retries");
+static auto& opt_fdraw_rescue_mode = getOpt<bool>("fdraw_rescue_mode");
 static auto& opt_fix = getOpt<int>("fix");
+static auto& opt_manifest = getOpt<int>("manifest");
 static auto& opt_merge = getOpt<int>("merge");
 static auto& opt_minimal = getOpt<int>("minimal");
 static auto& opt_normal_disk = getOpt<bool>("normal_disk");
@@ -33,9 +39,15 @@ static auto& opt_quick = getOpt<int>("quick");
 static auto& opt_range = getOpt<Range>("range");
 static auto& opt_repair = getOpt<int>("repair");
 static auto& opt_resize = getOpt<int>("resize");
+static auto& opt_resume = getOpt<bool>("resume");
 static auto& opt_sectors = getOpt<long>("sectors");
+static auto& opt_skip_stable_sectors = getOpt<bool>("skip_stable_sectors");
 static auto& opt_step = getOpt<int>("step");
 static auto& opt_verbose = getOpt<int>("verbose");
+static auto& opt_verify = getOpt<int>("verify");
+
+// Seconds between checkpoints when rescue copying a device disk.
+constexpr int CHECKPOINT_INTERVAL_SECONDS = 10;
 
 // Priority of formats for srcDiskFormat (lowest first).
 enum class FormatPriority { None, Src, NormalDstImage, SrcDevFS, DstImageFS, SrcImageFS};
@@ -136,7 +148,13 @@ void ReviewTransferPolicy(Disk& src_disk, Disk& dst_disk, Disk& srcFileSystemDet
     }
 }
 
-bool ImageToImage(const std::string& src_path, const std::string& dst_path)
+/* Copy the source image or device disk to the destination. When more sources
+ * are given (e.g. the same disk in several drives or copies of the same title)
+ * they are read concurrently and each track of them repairs the destination
+ * track transferred from the first source.
+ */
+bool ImageToImage(const std::string& src_path, const std::string& dst_path,
+                  const std::vector<std::string>& extra_src_paths/* = {}*/)
 {
     auto src_disk = std::make_shared<Disk>();
     auto dst_disk = std::make_shared<Disk>();
@@ -152,6 +170,15 @@ bool ImageToImage(const std::string& src_path, const std::string& dst_path)
 
     // Read the source image
     ReadImage(src_path, src_disk, true); // No determining filesystem here, doing it in ReviewTransferPolicy.
+    std::vector<std::shared_ptr<Disk>> extra_src_disks;
+    for (const auto& extra_src_path : extra_src_paths)
+    {
+        auto extra_src_disk = std::make_shared<Disk>();
+        ReadImage(extra_src_path, extra_src_disk, true);
+        if (extra_src_disk->is_constant_disk() != src_disk->is_constant_disk())
+            throw util::exception("sources must be either all devices or all images (", extra_src_path, ")");
+        extra_src_disks.push_back(extra_src_disk);
+    }
 
     auto transferDiskRange = opt_range;
     // Limit to our maximum geometry, and default to copy everything present in the source
@@ -161,8 +188,29 @@ bool ImageToImage(const std::string& src_path, const std::string& dst_path)
         TrackUsedInit(*src_disk); // Valid only for MGT format.
 
     RepairSummaryDisk fileSystemDeterminerDisk{*src_disk, context};
-    // For merge or repair, read any existing target image, error if that fails.
-    if (opt_merge > 0 || opt_repair > 0)
+    // Do not retry disk when
+    // 1) merging because it overwrites previous data, wasting of time. Copy would be the same but it becomes repair after first round.
+    // 2) disk is constant because the constant disk image always provides the same data, wasting of time.
+    auto diskRetries = opt_merge <= 0 && !src_disk->is_constant_disk() && opt_disk_retries >= 0 ? opt_disk_retries : 0;
+    // The progress of a rescue copy retrying the device disk is checkpointed so it can be resumed.
+    const auto checkpointing = opt_fdraw_rescue_mode && (diskRetries.retryTimes > 0 || diskRetries.GetSinceLastChange())
+        && !IsFloppyDevice(dst_path);
+    RescueCheckpoint checkpoint(dst_path);
+    auto resuming = false;
+    if (opt_resume)
+    {
+        if (!checkpointing)
+            throw util::exception("resume option requires rescue mode copying from device to image with disk retries and without merge option");
+        if (!checkpoint.Load())
+            throw util::exception("no checkpoint (", checkpoint.path(), ") to resume from");
+        opt_skip_stable_sectors = true;
+        if (checkpoint.round > 0) // The disk retry rounds repair.
+            opt_repair = 1;
+        resuming = true;
+    }
+
+    // For merge or repair or resume, read any existing target image, error if that fails.
+    if (opt_merge > 0 || opt_repair > 0 || resuming)
     {
         ReadImage(dst_path, dst_disk, false, "", false); // The dst disk should be already normalised.
         if (!dst_disk->is_constant_disk())
@@ -170,6 +218,8 @@ bool ImageToImage(const std::string& src_path, const std::string& dst_path)
         if (!dst_disk->GetFileSystem()) // Determining filesystem here separately so it does not affect device dst disk.
             fileSystemWrappers.FindAndSetApprover(*dst_disk, false);
         dst_disk->WarnIfFileSystemFormatDiffers(); // TODO Test if this is necessary because it is done in ReadImage.
+        if (resuming)
+            checkpoint.ApplyReadStats(*dst_disk);
     }
 
     // tmp dst path in case of merge or repair mode.
@@ -179,51 +229,136 @@ bool ImageToImage(const std::string& src_path, const std::string& dst_path)
     FormatPriority transferDiskFormatPriority{FormatPriority::None};
     DeviceReadingPolicy deviceReadingPolicy;
     bool result = false;
-    // Do not retry disk when
-    // 1) merging because it overwrites previous data, wasting of time. Copy would be the same but it becomes repair after first round.
-    // 2) disk is constant because the constant disk image always provides the same data, wasting of time.
-    auto diskRetries = opt_merge <= 0 && !src_disk->is_constant_disk() && opt_disk_retries >= 0 ? opt_disk_retries : 0;
-    bool diskInitialRound = true;
+    auto diskRound = 0;
+    bool prefetchDownwards = false; // The direction of the next sweep when prefetching device tracks.
+    if (resuming)
+    {
+        diskRound = checkpoint.round;
+        diskRetries.retryTimes = checkpoint.disk_retries_left;
+        diskRetries.wasChange = checkpoint.disk_retries_changed;
+        prefetchDownwards = checkpoint.sweep_downwards;
+        MessageCPP(msgInfo, "Resuming disk round ", diskRound, " from checkpoint (", checkpoint.path(), ")");
+    }
+    auto checkpointTime = std::chrono::steady_clock::now();
+
+    // Write the new/merged target image
+    // When merge or repair mode is requested, a new tmp file is written and then renamed as final file
+    // which works well only if dst is a file (constant disk) but not device.
+    // When checkpointing the image is written the same way so an interruption leaves the previous one.
+    const auto writeDstImage = [&]() {
+        if (dst_disk->is_constant_disk() && (opt_merge > 0 || opt_repair > 0 || checkpointing))
+        {
+            auto written = WriteImage(tmp_dst_path, dst_disk);
+            // Can not use (!ifstream.good() || std::remove()) for some reason.
+            if (written && std::ifstream(dst_path).good())
+                written = std::remove(dst_path.c_str()) == 0;
+            if (written)
+                written = std::rename(tmp_dst_path.c_str(), dst_path.c_str()) == 0;
+            return written;
+        }
+        return WriteImage(dst_path, dst_disk);
+    };
+
     do
     {
+        // A resumed round continues with the checkpointed state, others start a new one.
+        if (checkpointing && !resuming)
+        {
+            checkpoint.StartRound(diskRound, diskRetries, prefetchDownwards);
+            if (diskRound > 0) // The image of the previous round is written.
+            {
+                checkpoint.Save(*dst_disk);
+                checkpointTime = std::chrono::steady_clock::now();
+            }
+        }
+        resuming = false;
         int repair_track_changed_amount_per_disk = 0;
         const auto transferUniteMode = opt_merge > 0 ? RepairSummaryDisk::Merge : (opt_repair > 0? RepairSummaryDisk::Repair : RepairSummaryDisk::Copy);
         if (!src_disk->is_constant_disk()) // Clear cached tracks of interest of not constant disk.
+        {
             src_disk->clearCache(transferDiskRange); // Required for determining stability of sectors in the requested range.
+            for (const auto& extra_src_disk : extra_src_disks)
+                extra_src_disk->clearCache(transferDiskRange);
+        }
         ReviewTransferPolicy(*src_disk, *dst_disk, fileSystemDeterminerDisk, transferDiskFormat, transferDiskFormatPriority, deviceReadingPolicy, transferDiskRange);
         if (opt_verbose)
-            MessageCPP(msgInfoAlways, (diskInitialRound ? "R" : "Rer"), "eading disk");
+            MessageCPP(msgInfoAlways, (diskRound == 0 ? "R" : "Rer"), "eading disk");
 
-        // Transfer the range of tracks to the target image (i.e. copy, merge or repair).
-        transferDiskRange.each([&](const CylHead& cylhead)
-        {
+        // Transfer the track to the target image (i.e. copy, merge or repair).
+        const auto transferTrack = [&](const CylHead& cylhead) {
             auto start_time = StartStopper("transfer track");
             try {
                 repair_track_changed_amount_per_disk += Disk::TransferTrack(*src_disk, cylhead, *dst_disk, context, transferUniteMode, false, deviceReadingPolicy);
+                // The other sources repair what the first one transferred.
+                for (const auto& extra_src_disk : extra_src_disks)
+                    if (cylhead.cyl * opt_step < extra_src_disk->cyls() && cylhead.head < extra_src_disk->heads())
+                        repair_track_changed_amount_per_disk += Disk::TransferTrack(*extra_src_disk, cylhead, *dst_disk, context, RepairSummaryDisk::Repair, false, deviceReadingPolicy);
             } catch (util::diskforeigncylhead_exception& e) {
                 util::cout << colour::RED << "Error: " << e.what() << colour::none << ", ignoring this whole track to avoid data corruption\n";
             }
             StopStopper(start_time, "transfer track");
+            if (checkpointing)
+                checkpoint.SetTrackDone(cylhead);
+        };
+        const auto isTrackDone = [&](const CylHead& cylhead) {
+            return checkpointing && checkpoint.IsTrackDone(cylhead);
+        };
+        // When the checkpoint is due, transfer the tracks read already so the written image contains them.
+        const auto checkpointIfDue = [&](const CylHead& /*cylhead*/) {
+            const auto now = std::chrono::steady_clock::now();
+            if (!checkpointing || now - checkpointTime < std::chrono::seconds(CHECKPOINT_INTERVAL_SECONDS))
+                return;
+            transferDiskRange.each([&](const CylHead& cylhead) {
+                if (!isTrackDone(cylhead) && src_disk->isCached(cylhead * opt_step))
+                    transferTrack(cylhead);
+            }, !opt_normal_disk);
+            if (writeDstImage())
+            {
+                checkpoint.Save(*dst_disk);
+                checkpointTime = now;
+            }
+        };
+
+        // Read the tracks of a device in the order minimising head movement.
+        if (!src_disk->is_constant_disk() && extra_src_disks.empty())
+            Disk::PrefetchTransferTracks(*src_disk, transferDiskRange, *dst_disk, transferUniteMode,
+                deviceReadingPolicy, !opt_normal_disk, prefetchDownwards, isTrackDone, checkpointIfDue);
+        else if (!src_disk->is_constant_disk())
+        {
+            // Each device reads in its own thread, the tracks are transferred when all have been read.
+            // The sweeps cover the same range so all of them end in the same direction. Their output
+            // is written a line at a time so the lines of the devices don't mix.
+            std::vector<std::future<bool>> prefetches;
+            for (const auto& disk : extra_src_disks)
+                prefetches.push_back(std::async(std::launch::async, [&, disk, prefetchDownwards]() mutable {
+                    util::ThreadLineOutput line_output;
+                    Disk::PrefetchTransferTracks(*disk, transferDiskRange, *dst_disk, transferUniteMode,
+                        deviceReadingPolicy, !opt_normal_disk, prefetchDownwards, isTrackDone);
+                    return prefetchDownwards;
+                }));
+            {
+                util::ThreadLineOutput line_output;
+                Disk::PrefetchTransferTracks(*src_disk, transferDiskRange, *dst_disk, transferUniteMode,
+                    deviceReadingPolicy, !opt_normal_disk, prefetchDownwards, isTrackDone);
+            }
+            for (auto& prefetch : prefetches)
+                prefetch.get();
+        }
+
+        // Transfer the range of tracks to the target image.
+        transferDiskRange.each([&](const CylHead& cylhead)
+        {
+            if (isTrackDone(cylhead))
+                return;
+            transferTrack(cylhead);
+            checkpointIfDue(cylhead);
         }, !opt_normal_disk); // A dedicated option would be better for cyls_first.
 
         // Copy any metadata not already present in the target (emplace doesn't replace)
         for (const auto& m : src_disk->metadata())
             dst_disk->metadata().emplace(m);
 
-        // Write the new/merged target image
-        // When merge or repair mode is requested, a new tmp file is written and then renamed as final file
-        // which works well only if dst is a file (constant disk) but not device.
-        if (dst_disk->is_constant_disk() && (opt_merge > 0 || opt_repair > 0))
-        {
-            result = WriteImage(tmp_dst_path, dst_disk);
-            // Can not use (!ifstream.good() || std::remove()) for some reason.
-            if (result && std::ifstream(dst_path).good())
-                result = std::remove(dst_path.c_str()) == 0;
-            if (result)
-                result = std::rename(tmp_dst_path.c_str(), dst_path.c_str()) == 0;
-        }
-        else
-            result = WriteImage(dst_path, dst_disk);
+        result = writeDstImage();
         if (!result)
             break;
 
@@ -238,8 +373,10 @@ bool ImageToImage(const std::string& src_path, const std::string& dst_path)
         }
         if (repair_track_changed_amount_per_disk > 0)
             diskRetries.wasChange = true;
-        diskInitialRound = false;
+        diskRound++;
     } while (diskRetries.HasMoreRetryMinusMinus());
+    if (result && checkpointing)
+        checkpoint.Remove();
     return result;
 }
 
@@ -358,18 +495,27 @@ bool Hdd2Hdd(const std::string& src_path, const std::string& dst_path)
     {
         BDOS_CAPS bdcSrc, bdcDst;
 
+        // Copy a range of sectors, reading it back to check it if requested
+        auto copy = [&](HDD* src, int64_t sectors, int64_t src_offset = 0, int64_t dst_offset = 0, int64_t total = 0, HddManifest* manifest = nullptr) {
+            return dst_hdd->Copy(src, sectors, src_offset, dst_offset, total, nullptr, manifest) &&
+                (!opt_verify || dst_hdd->Verify(src, sectors, src_offset, dst_offset, total));
+        };
+
         if (opt_resize && IsBDOSDisk(*src_hdd, bdcSrc))
         {
             GetBDOSCaps(dst_hdd->total_sectors, bdcDst);
 
+            if (opt_manifest)
+                Message(msgWarning, "manifest is not written for resized copies");
+
             auto uBase = std::min(bdcSrc.base_sectors, bdcDst.base_sectors);
             auto uData = std::min(src_hdd->total_sectors - bdcSrc.base_sectors, dst_hdd->total_sectors - bdcDst.base_sectors);
             auto uEnd = opt_quick ? uBase + uData : dst_hdd->total_sectors;
 
             // Copy base sectors, clear unused base sector area, copy record data sectors
-            f = dst_hdd->Copy(src_hdd.get(), uBase, 0, 0, uEnd);
-            f &= dst_hdd->Copy(nullptr, bdcDst.base_sectors - uBase, 0, uBase, uEnd);
-            f &= dst_hdd->Copy(src_hdd.get(), uData, bdcSrc.base_sectors, bdcDst.base_sectors, uEnd);
+            f = copy(src_hdd.get(), uBase, 0, 0, uEnd);
+            f &= copy(nullptr, bdcDst.base_sectors - uBase, 0, uBase, uEnd);
+            f &= copy(src_hdd.get(), uData, bdcSrc.base_sectors, bdcDst.base_sectors, uEnd);
 
             MEMORY mem(dst_hdd->sector_size);
 
@@ -388,7 +534,7 @@ bool Hdd2Hdd(const std::string& src_path, const std::string& dst_path)
 
             // If this isn't a quick copy, clear the remaining destination space
             if (!opt_quick)
-                f &= dst_hdd->Copy(nullptr, dst_hdd->total_sectors - (bdcDst.base_sectors + uData), 0x00, bdcDst.base_sectors + uData, uEnd);
+                f &= copy(nullptr, dst_hdd->total_sectors - (bdcDst.base_sectors + uData), 0x00, bdcDst.base_sectors + uData, uEnd);
 
             // If the source disk is bootable, consider updating the BDOS variables
             if (opt_fix != 0 && bdcSrc.bootable && dst_hdd->Seek(0) && dst_hdd->Read(mem, 1))
@@ -404,7 +550,17 @@ bool Hdd2Hdd(const std::string& src_path, const std::string& dst_path)
         else
         {
             auto uCopy = std::min(src_hdd->total_sectors, dst_hdd->total_sectors);
-            f = dst_hdd->Copy(src_hdd.get(), uCopy);
+            if (!opt_manifest)
+                f = copy(src_hdd.get(), uCopy);
+            else
+            {
+                // Checksum the data as it's copied, so the image can be verified later
+                HddManifest manifest(HddManifest::DefaultPath(dst_path));
+                manifest.Start(uCopy, dst_hdd->sector_size);
+                f = copy(src_hdd.get(), uCopy, 0, 0, 0, &manifest);
+                manifest.Finish();
+                manifest.Save();
+            }
         }
 
         dst_hdd->Unlock();
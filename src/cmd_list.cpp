@@ -409,35 +409,22 @@ bool ListRecords(const std::string& path)
         return false;
     }
 
-    BDOS_CAPS bdc;
-    if (!IsBDOSDisk(*hdd, bdc))
+    auto index = GetBDOSIndex(*hdd, path);
+    if (!index)
         util::cout << "BDOS disk signature not found\n";
     else
     {
+        auto& bdc = index->caps;
         int nNamed = 0;
         util::cout << util::fmt("Atom%s, %d records:\n\n", bdc.need_byteswap ? "" : " Lite", bdc.records);
 
-        for (auto i = 0; i < bdc.list_sectors; ++i)
+        for (size_t i = 0; i < index->labels.size(); ++i)
         {
-            MEMORY mem(hdd->sector_size);
-            hdd->Seek(bdc.base_sectors - bdc.list_sectors + i);
-            hdd->Read(mem, 1, bdc.need_byteswap);
-
-            for (auto j = 0; j < (hdd->sector_size / BDOS_LABEL_SIZE); ++j)
+            // Label in use?
+            if (!index->labels[i].empty())
             {
-                uint8_t abRecord[BDOS_LABEL_SIZE + 1] = {};
-                memcpy(abRecord, mem + (j << 4), BDOS_LABEL_SIZE);
-
-                // Bit 7 should be ignored on label names
-                for (int k = 0; k < BDOS_LABEL_SIZE; ++k)
-                    abRecord[k] &= 0x7f;
-
-                // Label in use?
-                if (abRecord[0])
-                {
-                    util::cout << util::fmt("%5u : %s\n", 1 + (i << 5) + j, abRecord);
-                    ++nNamed;
-                }
+                util::cout << util::fmt("%5u : %s\n", static_cast<unsigned>(i + 1), index->labels[i].c_str());
+                ++nNamed;
             }
         }
 
@@ -1,3 +1,118 @@
 // Verify command
 
-// ToDo!
+#include "SAMdisk.h"
+#include "CRC32.h"
+#include "HddManifest.h"
+#include "ThreadPool.h"
+#include "Util.h"
+
+#include <deque>
+
+// Verify an HDD image or device against the block checksums of its manifest.
+// Blocks are read in order, and checksummed in parallel by a pool of threads.
+// Only the sectors in the manifest are verified, as a copy may cover only the
+// start of a disk, so the disk may be larger but not smaller.
+bool VerifyHdd(const std::string& path, const std::string& manifest_path)
+{
+    auto hdd = HDD::OpenDisk(path);
+    if (!hdd)
+    {
+        Error("open");
+        return false;
+    }
+
+    HddManifest manifest(manifest_path.empty() ? HddManifest::DefaultPath(path) : manifest_path);
+    if (!manifest.Load())
+        throw util::exception("missing manifest (", manifest.path(), ")");
+    if (manifest.sector_size() != hdd->sector_size)
+        throw util::exception("disk sector size (", hdd->sector_size, ") does not match manifest (", manifest.sector_size(), ")");
+    const auto total_sectors = manifest.total_sectors();
+    if (hdd->total_sectors < total_sectors)
+        throw util::exception("disk size (", hdd->total_sectors, " sectors) is smaller than manifest (", total_sectors, " sectors)");
+
+    struct PendingBlock
+    {
+        int64_t block;
+        MEMORY* mem;
+        std::future<uint32_t> crc;
+    };
+
+    ThreadPool pool;
+    auto max_pending = ThreadPool::get_thread_count() * 2;
+    VectorX<std::unique_ptr<MEMORY>> buffers;
+    std::vector<MEMORY*> free_buffers;
+    for (auto i = 0; i < max_pending; ++i)
+    {
+        buffers.emplace_back(new MEMORY(HddManifest::BLOCK_BYTES));
+        free_buffers.push_back(buffers.back().get());
+    }
+
+    std::deque<PendingBlock> pending;
+    int64_t bad_blocks = 0;
+    uint32_t image_crc = CRC32::INIT_CRC;
+
+    // Compare the checksum of the oldest block still being checksummed.
+    auto check_oldest = [&]() {
+        auto& oldest = pending.front();
+        auto crc = oldest.crc.get();
+        auto block_start = oldest.block * manifest.block_sectors();
+        auto block_bytes = static_cast<uint64_t>(std::min(total_sectors - block_start, static_cast<int64_t>(manifest.block_sectors()))) * hdd->sector_size;
+        image_crc = CRC32::combine(image_crc, crc, block_bytes);
+
+        if (crc != manifest.block_crc(oldest.block))
+        {
+            Message(msgWarning, "checksum mismatch in sectors %lld-%lld", static_cast<long long>(block_start),
+                static_cast<long long>(block_start + static_cast<int64_t>(block_bytes / hdd->sector_size) - 1));
+            ++bad_blocks;
+        }
+
+        free_buffers.push_back(oldest.mem);
+        pending.pop_front();
+    };
+
+    for (int64_t block = 0; block < manifest.blocks(); ++block)
+    {
+        Message(msgStatus, "Verifying... %d%%", static_cast<int>(block * 100 / manifest.blocks()));
+
+        if (free_buffers.empty())
+            check_oldest();
+
+        auto mem = free_buffers.back();
+        free_buffers.pop_back();
+
+        auto block_start = block * manifest.block_sectors();
+        auto sectors = static_cast<int>(std::min(total_sectors - block_start, static_cast<int64_t>(manifest.block_sectors())));
+        auto len = sectors * hdd->sector_size;
+
+        // Unreadable sectors are checksummed as zeros, as copying fills them.
+        for (auto uDone = 0; uDone < sectors; )
+        {
+            hdd->Seek(block_start + uDone);
+            uDone += hdd->Read(*mem + (uDone * hdd->sector_size), sectors - uDone);
+            if (uDone < sectors)
+            {
+                Message(msgWarning, "read error at sector %lld: %s", static_cast<long long>(block_start + uDone), LastError());
+                memset(*mem + (uDone++ * hdd->sector_size), 0, lossless_static_cast<size_t>(hdd->sector_size));
+            }
+        }
+
+        const uint8_t* pb = *mem;
+        pending.push_back({ block, mem, pool.enqueue([pb, len]() { return static_cast<uint32_t>(CRC32(pb, len)); }) });
+    }
+
+    while (!pending.empty())
+        check_oldest();
+
+    if (!bad_blocks && image_crc != manifest.image_crc())
+        throw util::exception("invalid manifest file (", manifest.path(), ")");
+
+    if (bad_blocks)
+    {
+        Message(msgWarning, "%lld of %lld blocks do not match %s", static_cast<long long>(bad_blocks),
+            static_cast<long long>(manifest.blocks()), manifest.path().c_str());
+        return false;
+    }
+
+    util::cout << "Verified " << total_sectors << " sectors, CRC-32 " << util::fmt("%08X", image_crc) << "\n";
+    return true;
+}
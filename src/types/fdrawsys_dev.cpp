@@ -13,9 +13,13 @@
 #include "VfdrawcmdSys.h"
 #include "win32_error.h"
 
+#include <algorithm>
 #include <cstring>
+#include <future>
+#include <limits>
 #include <memory>
 
+static auto& opt_adaptive_retries = getOpt<bool>("adaptive_retries");
 static auto& opt_base = getOpt<int>("base");
 static auto& opt_byte_tolerance_of_time = getOpt<int>("byte_tolerance_of_time");
 static auto& opt_datarate = getOpt<DataRate>("datarate");
@@ -355,6 +359,135 @@ void FdrawSysDevDisk::ReadSector(const CylHead& cylhead, Track& track, int index
     ReadSectors(cylhead, track, VectorX<int>{index}, firstSectorSeen);
 }
 
+// The offset where reading the sector finishes, i.e. where its data crc ends.
+static int SectorEndOffset(const Sector& sector)
+{
+    return sector.offset + DataBytePositionAsBitOffset(GetFmOrMfmSectorOverheadFromOffsetToDataCrcEnd(
+        sector.datarate, sector.encoding, sector.size()), sector.encoding);
+}
+
+// How far reading the sector has got, for judging whether a retry improved it.
+static int ReadProgress(const Sector& sector)
+{
+    return sector.has_good_data() ? std::numeric_limits<int>::max() : sector.copies();
+}
+
+/* Order the sectors having more retries so each is read in its rotational turn
+ * starting from the head offset, assuming that every read finishes at the end
+ * of the sector data. A read command must be issued before the sector header
+ * arrives, the default gap3 is assumed to be enough for that.
+ * Without known offsets the order is the list order.
+ */
+static VectorX<int> RotationalReadOrder(const Track& track, const VectorX<int>& indices,
+    VectorX<RetryPolicy>& sectorRetries, int headOffset)
+{
+    VectorX<int> pending;
+    for (auto i = 0; i < indices.size(); i++)
+        if (sectorRetries[i].HasMoreRetry())
+            pending.push_back(i);
+
+    if (track.tracklen <= 0 || std::any_of(pending.begin(), pending.end(),
+        [&](int i) { return track[indices[i]].offset <= 0; }))
+        return pending;
+
+    VectorX<int> order;
+    while (!pending.empty())
+    {
+        auto itBest = pending.begin();
+        auto distanceBest = track.tracklen;
+        for (auto it = pending.begin(); it != pending.end(); ++it)
+        {
+            const auto& sector = track[indices[*it]];
+            const auto earliestOffset = headOffset + DataBytePositionAsBitOffset(
+                GetFmOrMfmGap3PlusSyncLength(sector.encoding), sector.encoding);
+            const auto distance = modulo(sector.offset - earliestOffset, track.tracklen);
+            if (distance < distanceBest)
+            {
+                distanceBest = distance;
+                itBest = it;
+            }
+        }
+        order.push_back(*itBest);
+        headOffset = SectorEndOffset(track[indices[*itBest]]);
+        pending.erase(itBest);
+    }
+    return order;
+}
+
+/* Return how many sectors starting at order[n] can be read by one multi-sector
+ * read command. The sectors must follow each other physically with increasing
+ * ids and otherwise identical headers, and they must be readable in one go.
+ */
+static int BatchableRunLength(const Track& track, const VectorX<int>& indices,
+    const VectorX<int>& order, int n, const std::vector<bool>& batchable)
+{
+    const auto isBatchable = [&](int i) {
+        const auto& sector = track[indices[i]];
+        return batchable[lossless_static_cast<size_t>(i)] && !sector.has_badidcrc() && !sector.has_stable_data()
+            && !track.is_repeated(sector) && !track.data_overlap(sector);
+    };
+    if (track.is_8k_sector() || !isBatchable(order[n]))
+        return 1;
+
+    auto length = 1;
+    for (; n + length < order.size(); length++)
+    {
+        const auto iPrev = order[n + length - 1];
+        const auto i = order[n + length];
+        const auto& sectorPrev = track[indices[iPrev]];
+        const auto& sector = track[indices[i]];
+        if (indices[i] != indices[iPrev] + 1 || !isBatchable(i)
+            || sector.header.cyl != sectorPrev.header.cyl || sector.header.head != sectorPrev.header.head
+            || sector.header.size != sectorPrev.header.size || sector.header.sector != sectorPrev.header.sector + 1)
+            break;
+    }
+    return length;
+}
+
+/* Read the sectors of a batchable run by one multi-sector read command.
+ * Return false without changing the sectors if the read was not completely
+ * clean, then the sectors must be read one by one.
+ */
+bool FdrawSysDevDisk::ReadSectorRun(const CylHead& cylhead, Track& track, const VectorX<int>& indices,
+    const VectorX<int>& order, int n, int length)
+{
+    const auto& header = track[indices[order[n]]].header;
+    const auto size = Sector::SizeCodeToRealLength(header.size);
+    MEMORY mem(size * length);
+    memset(mem.pb, 0xee, static_cast<size_t>(mem.size));
+
+    if (opt_debug)
+        util::cout << "ReadSectorRun: reading " << length << " sectors from ID " << header.sector << "\n";
+
+    if (!m_fdrawcmd->CmdRead(cylhead.head, header.cyl, header.head, header.sector, header.size, length, mem))
+    {
+        auto error{ GetLastError_MP() };
+        if (error != ERROR_CRC &&
+            error != ERROR_SECTOR_NOT_FOUND &&
+            error != ERROR_FLOPPY_ID_MARK_NOT_FOUND)
+        {
+            throw win32_error(error, "Read");
+        }
+        return false;
+    }
+
+    FD_CMD_RESULT result{};
+    if (!m_fdrawcmd->GetResult(result))
+        throw win32_error(GetLastError_MP(), "Result");
+
+    if ((result.st0 & STREG0_INTERRUPT_CODE) != 0 || result.st1 != 0 || result.st2 != 0
+        || result.sector != header.sector + length)
+        return false;
+
+    VerifyCylHeadsMatch(cylhead, header, false, opt_normal_disk);
+    for (auto k = 0; k < length; k++)
+    {
+        Data data(mem.pb + k * size, mem.pb + (k + 1) * size);
+        track[indices[order[n + k]]].add(std::move(data), false, IBM_DAM);
+    }
+    return true;
+}
+
 void FdrawSysDevDisk::ReadSectors(const CylHead& cylhead, Track& track, const VectorX<int>& indices, int firstSectorSeen)
 {
     const auto iSup = indices.size();
@@ -367,14 +500,27 @@ void FdrawSysDevDisk::ReadSectors(const CylHead& cylhead, Track& track, const Ve
     // revolution is calculated. TODO Consider datarate for the multiplier.
     RetryPolicy retriesSpecial(opt_retries.retryTimes * 5 + 1, opt_retries.GetSinceLastChange()); // +1 since prechecking the value in the loop.
     VectorX<RetryPolicy> sectorRetries(iSup, retriesSpecial);
+    std::vector<bool> batchable(static_cast<size_t>(iSup), true);
+    VectorX<int> failedReads(iSup, 0), progressBefore(iSup, 0); // Used only with opt_adaptive_retries.
+    auto pendingRetry = -1; // The sector whose retry outcome is not recorded yet.
+    const auto recordPendingRetry = [&]() {
+        if (pendingRetry < 0)
+            return;
+        const auto& retried = track[indices[pendingRetry]];
+        m_retry_learner.Record(cylhead, retried.header.sector, ReadProgress(retried) > progressBefore[pendingRetry]);
+        pendingRetry = -1;
+    };
+    auto headOffset = 0; // The scanning finished at the index.
     bool thereWasRetry;
-    do // The reading loop.
+    do // The reading loop, each round reads the sectors in their rotational order.
     {
         thereWasRetry = false;
-        for (auto i = 0; i < iSup; sectorRetries[i]--, i++)
+        const auto order = RotationalReadOrder(track, indices, sectorRetries, headOffset);
+        for (auto n = 0; n < order.size(); sectorRetries[order[n]]--, n++)
         {
-            if (!sectorRetries[i].HasMoreRetry())
-                continue;
+            // Record the outcome of the previous read attempt, whether it improved the sector or not.
+            recordPendingRetry();
+            const auto i = order[n];
             thereWasRetry = true;
             const auto index = indices[i];
             auto& sector = track[index];
@@ -387,6 +533,49 @@ void FdrawSysDevDisk::ReadSectors(const CylHead& cylhead, Track& track, const Ve
                 continue; //return
             }
 
+            // Stop retrying a sector without good data if further retries
+            // are unlikely to improve it.
+            if (opt_adaptive_retries && !sector.has_good_data())
+            {
+                if (!m_retry_learner.WorthRetrying(cylhead, sector.header.sector, std::max(0, failedReads[i] - 1)))
+                {
+                    if (opt_debug)
+                        util::cout << "adaptive retries: giving up sector " << sector.header.sector << " of "
+                            << cylhead << " after " << failedReads[i] << " reads\n";
+                    sectorRetries[i] = 0;
+                    continue;
+                }
+                progressBefore[i] = ReadProgress(sector);
+                if (++failedReads[i] >= 2)
+                    pendingRetry = i; // The first read is not a retry.
+            }
+            if (sector.offset > 0)
+                headOffset = SectorEndOffset(sector);
+
+            const auto runLength = BatchableRunLength(track, indices, order, n, batchable);
+            if (runLength > 1)
+            {
+                if (ReadSectorRun(cylhead, track, indices, order, n, runLength))
+                {
+                    for (auto k = 0; k < runLength; k++)
+                    {
+                        const auto iRun = order[n + k];
+                        if (track[indices[iRun]].has_stable_data())
+                            sectorRetries[iRun] = 0;
+                        else
+                            sectorRetries[iRun].wasChange = true;
+                        if (k < runLength - 1)
+                            sectorRetries[iRun]--;
+                    }
+                    n += runLength - 1;
+                    headOffset = SectorEndOffset(track[indices[order[n]]]);
+                    continue;
+                }
+                // Not clean so read these sectors one by one from now.
+                for (auto k = 0; k < runLength; k++)
+                    batchable[lossless_static_cast<size_t>(order[n + k])] = false;
+            }
+
             auto size = Sector::SizeCodeToRealLength(sector.header.size);
             MEMORY mem(size);
 
@@ -490,6 +679,7 @@ void FdrawSysDevDisk::ReadSectors(const CylHead& cylhead, Track& track, const Ve
                 continue; //break
             }
         }
+        recordPendingRetry();
     } while (thereWasRetry);
 }
 
@@ -680,7 +870,7 @@ TimedAndPhysicalDualTrack FdrawSysDevDisk::RescueTrack(const CylHead& cylhead, c
         if (m_trackInfo[cylhead].trackTime > RPM_TIME_200)
             throw util::diskspeedwrong_exception("index-halving cables are no longer supported (rpm <= 200)");
 
-        if (m_lastEncoding != Encoding::MFM) // Currently only MFM encoding is supported due to ReadAndMergePhysicalTracks method.
+        if (m_lastEncoding != Encoding::MFM) // Currently only MFM encoding is supported due to MergePhysicalTrack method.
             return timedAndPhysicalDualTrack;
 
         if (multiScanResult.count() > 0) // In case of blank track the encoding and datarate are unsure.
@@ -730,6 +920,28 @@ TimedAndPhysicalDualTrack FdrawSysDevDisk::RescueTrack(const CylHead& cylhead, c
 
         // If more sectors are required then try to find sectors in the physical track as well.
         auto physicalTrackRescans = physicalTrackRescansInit + 1; // +1 since prechecking the value in the loop.
+        // The physical track read in the background while the previous one is analysed.
+        // The device is used by one command at a time so it must be finished before
+        // any other command. A started read is always merged so its device time is not wasted.
+        std::future<std::unique_ptr<MEMORY>> physicalTrackRead;
+        const auto mergePhysicalTrack = [&](const std::unique_ptr<MEMORY>& mem) {
+            auto startTimeMergePhysicalTrack = StartStopper("MergePhysicalTrack");
+            if (mem && MergePhysicalTrack(cylhead, *mem, timedAndPhysicalDualTrack)) // Found better scored track.
+                physicalTrackRescans.wasChange = true;
+            StopStopper(startTimeMergePhysicalTrack, "MergePhysicalTrack");
+        };
+        const auto addLastPhysicalTrackIds = [&]() {
+            if (timedAndPhysicalDualTrack.lastPhysicalTrackSingle.empty())
+                return;
+            const auto sectorAmountPrev = timedAndPhysicalDualTrack.timedIdDataAndPhysicalIdTrack.size();
+            timedAndPhysicalDualTrack.timedIdDataAndPhysicalIdTrack.add(timedAndPhysicalDualTrack.lastPhysicalTrackSingle.track.CopyWithoutSectorData());
+            timedAndPhysicalDualTrack.timedIdDataAndPhysicalIdTrack.MergeRepeatedSectors();
+            if (timedAndPhysicalDualTrack.timedIdDataAndPhysicalIdTrack.size() > sectorAmountPrev)
+            {
+                deviceReadingPolicyForScanning = deviceReadingPolicy;
+                deviceReadingPolicyForScanning.AddSkippableSectors(timedAndPhysicalDualTrack.timedIdDataAndPhysicalIdTrack.good_idcrc_sectors());
+            }
+        };
         auto startTimeScanningReadingLoop = StartStopper("Scanning reading loop");
         do // The reading and scanning loop.
         {
@@ -738,6 +950,13 @@ TimedAndPhysicalDualTrack FdrawSysDevDisk::RescueTrack(const CylHead& cylhead, c
             const auto endingRound = physicalTrackRescans <= 0;
             if (endingRound || !deviceReadingPolicyForScanning.WantMoreSectors()) // Ending round or do not want more sectors.
             {
+                // The read started in the background counts as a rescan, merge it before reading sectors.
+                if (physicalTrackRead.valid())
+                {
+                    physicalTrackRescans--;
+                    mergePhysicalTrack(physicalTrackRead.get());
+                    addLastPhysicalTrackIds();
+                }
                 ReadSectors(cylhead, timedAndPhysicalDualTrack, deviceReadingPolicy, false);
                 auto deviceReadingPolicyForReading = deviceReadingPolicy;
                 deviceReadingPolicyForReading.AddSkippableSectors(timedAndPhysicalDualTrack.finalAllInTrack.stable_sectors());
@@ -749,22 +968,15 @@ TimedAndPhysicalDualTrack FdrawSysDevDisk::RescueTrack(const CylHead& cylhead, c
             if (physicalTrackRescans.HasMoreRetry())
             {
                 physicalTrackRescans--;
-                auto startTimeReadAndMergePhysicalTracks = StartStopper("ReadAndMergePhysicalTracks");
-                if (ReadAndMergePhysicalTracks(cylhead, timedAndPhysicalDualTrack)) // Found better scored track.
-                    physicalTrackRescans.wasChange = true;
-                StopStopper(startTimeReadAndMergePhysicalTracks, "ReadAndMergePhysicalTracks");
-            }
-            if (!timedAndPhysicalDualTrack.lastPhysicalTrackSingle.empty())
-            {
-                const auto sectorAmountPrev = timedAndPhysicalDualTrack.timedIdDataAndPhysicalIdTrack.size();
-                timedAndPhysicalDualTrack.timedIdDataAndPhysicalIdTrack.add(timedAndPhysicalDualTrack.lastPhysicalTrackSingle.track.CopyWithoutSectorData());
-                timedAndPhysicalDualTrack.timedIdDataAndPhysicalIdTrack.MergeRepeatedSectors();
-                if (timedAndPhysicalDualTrack.timedIdDataAndPhysicalIdTrack.size() > sectorAmountPrev)
-                {
-                    deviceReadingPolicyForScanning = deviceReadingPolicy;
-                    deviceReadingPolicyForScanning.AddSkippableSectors(timedAndPhysicalDualTrack.timedIdDataAndPhysicalIdTrack.good_idcrc_sectors());
-                }
+                const auto mem = physicalTrackRead.valid() ? physicalTrackRead.get() : ReadPhysicalTrack(cylhead);
+                // Keep the drive busy with the next read while analysing this one.
+                if (physicalTrackRescans > 0)
+                    physicalTrackRead = std::async(std::launch::async, [this, cylhead]() {
+                        return ReadPhysicalTrack(cylhead);
+                    });
+                mergePhysicalTrack(mem);
             }
+            addLastPhysicalTrackIds();
             if (opt_debug >= 2)
             {
                 util::cout << "BlindReadHeaders112: scanning and reading loop end, showing timedIdDataAndPhysicalIdTrack\n"
@@ -969,32 +1181,40 @@ void FdrawSysDevDisk::ReadSectors(const CylHead& cylhead, TimedAndPhysicalDualTr
     }
 }
 
-bool FdrawSysDevDisk::ReadAndMergePhysicalTracks(const CylHead& cylhead, TimedAndPhysicalDualTrack& timedAndPhysicalDualTrack)
+// Read the physical track, it uses only the device so it can run beside analysing.
+std::unique_ptr<MEMORY> FdrawSysDevDisk::ReadPhysicalTrack(const CylHead& cylhead)
 {
-    assert(m_lastEncoding == Encoding::MFM); // Currently this method handles only MFM track.
-    assert(m_lastDataRate != DataRate::Unknown);
-    MEMORY mem;
-
-    if (!m_fdrawcmd->CmdReadTrack(cylhead.head, cylhead.cyl, cylhead.head, 1, 8, 1, mem)) // Read one big 32K sector.
+    auto mem = std::make_unique<MEMORY>();
+    if (!m_fdrawcmd->CmdReadTrack(cylhead.head, cylhead.cyl, cylhead.head, 1, 8, 1, *mem)) // Read one big 32K sector.
     {
         MessageCPP(msgWarningAlways, "Could not read ", cylhead,
             " at once, it is either blank or prevents from being read");
-        return false;
+        return nullptr;
     }
+    return mem;
+}
+
+bool FdrawSysDevDisk::MergePhysicalTrack(const CylHead& cylhead, const MEMORY& mem, TimedAndPhysicalDualTrack& timedAndPhysicalDualTrack)
+{
+    assert(m_lastEncoding == Encoding::MFM); // Currently this method handles only MFM track.
+    assert(m_lastDataRate != DataRate::Unknown);
     PhysicalTrackMFM toBeMergedPhysicalTrack(mem, m_lastDataRate);
     auto& destODCTrack = timedAndPhysicalDualTrack.lastPhysicalTrackSingle;
 
+    // The repeating content tells the revolution length of the read more exactly than the timing, if there is enough of it.
+    const auto revolutionLen = toBeMergedPhysicalTrack.DetermineBestTrackLen(
+        timedAndPhysicalDualTrack.timedIdDataAndPhysicalIdTrack.tracklen);
     auto toBeMergedODCTrack = toBeMergedPhysicalTrack.DecodeTrack(cylhead);
     const auto prevScore = timedAndPhysicalDualTrack.lastPhysicalTrackSingleScore;
     const auto foundBetterScore = timedAndPhysicalDualTrack.SyncDemultiMergePhysicalUsingTimed(
-        std::move(toBeMergedODCTrack), repeatedSectorIds);
+        std::move(toBeMergedODCTrack), repeatedSectorIds, revolutionLen);
 
     if (destODCTrack.cylheadMismatch && opt_normal_disk)
         MessageCPP(msgWarningAlways, "Suspicious: ", cylhead, " does not match at least 1 sector's cyl head on physical track");
     if (foundBetterScore)
     {
         if (opt_debug >= 1)
-            util::cout << "ReadAndMergePhysicalTracks: found better score "
+            util::cout << "MergePhysicalTrack: found better score "
                 << timedAndPhysicalDualTrack.lastPhysicalTrackSingleScore << " than " << prevScore << "\n";
     }
     return foundBetterScore;
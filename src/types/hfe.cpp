@@ -15,13 +15,31 @@
 #include <string>
 #include <algorithm>
 #include <array>
+#include <cstring>
 
-// Note: currently only format revision 00 is supported.
+// Note: currently only format revision 00 is supported, in both the original
+// and the v3 variant, which adds opcodes to the track data.
 
 const std::string HFE_SIGNATURE{ "HXCPICFE" };
+const std::string HFE_V3_SIGNATURE{ "HXCHFEV3" };
 
 static auto& opt_datarate = getOpt<DataRate>("datarate");
 static auto& opt_encoding = getOpt<Encoding>("encoding");
+static auto& opt_hfe = getOpt<int>("hfe");
+
+// HFE v3 opcodes, with the track data bytes reversed to put the first bit on top.
+enum HfeV3Opcode : uint8_t
+{
+    OPCODE_MASK = 0xf0,
+    NOP_OPCODE = 0xf0,
+    SETINDEX_OPCODE = 0xf1,
+    SETBITRATE_OPCODE = 0xf2,     // followed by the bitrate byte
+    SKIPBITS_OPCODE = 0xf3,       // followed by the skip count and the partial data byte
+    RAND_OPCODE = 0xf4            // random (weak) data byte
+};
+
+constexpr int HFE_EMU_FREQ = 36'000'000;    // base of SETBITRATE values
+constexpr int HFE_V3_WEAK_REVOLUTIONS = 3;  // revolutions decoded from tracks with weak bytes
 
 struct HFE_HEADER
 {
@@ -114,11 +132,143 @@ std::string to_string(TrackEncoding track_encoding)
 }
 
 
+// Pseudo-random bytes for weak data, repeatable for each track.
+static uint8_t HfeRandomByte(uint32_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return static_cast<uint8_t>(state >> 24);
+}
+
+// The standard data rate of a SETBITRATE value, if it is within 5% of one.
+static DataRate HfeV3DataRate(int value)
+{
+    auto bitrate = value ? HFE_EMU_FREQ / (value * 2) : 0;
+    for (auto datarate : { DataRate::_250K, DataRate::_300K, DataRate::_500K, DataRate::_1M })
+    {
+        auto expected = bits_per_second(datarate);
+        if (std::abs(bitrate - expected) <= expected / 20)
+            return datarate;
+    }
+    return DataRate::Unknown;
+}
+
+static BitBuffer DecodeHfeV3Track(const CylHead& cylhead, DataRate datarate, const uint8_t* pb, int len)
+{
+    // Find the index and any weak data, so the track can start at the index
+    // and be decoded over enough revolutions for the weak data to differ.
+    auto start = -1;
+    auto weak = false;
+    for (auto i = 0; i < len; )
+    {
+        auto opcode = util::reverse_byte(pb[i]);
+        if ((opcode & OPCODE_MASK) != OPCODE_MASK)
+            ++i;
+        else
+        {
+            if (opcode == SETINDEX_OPCODE && start < 0)
+                start = i;
+            else if (opcode == RAND_OPCODE)
+                weak = true;
+
+            i += (opcode == SETBITRATE_OPCODE) ? 2 : (opcode == SKIPBITS_OPCODE) ? 3 : 1;
+        }
+    }
+    start = std::max(start, 0);
+
+    auto revs = weak ? HFE_V3_WEAK_REVOLUTIONS : 1;
+    BitBuffer bitbuf(datarate, Encoding::MFM, revs);
+    auto add_bits = [&](uint8_t bits, int count) {
+        while (count-- > 0)
+            bitbuf.add((bits >> count) & 1);
+    };
+
+    auto byte_at = [&](int offset) {
+        return util::reverse_byte(pb[(start + offset) % len]);
+    };
+
+    uint32_t random_state = 0x9e3779b9 ^ static_cast<uint32_t>(cylhead.operator int() + 1);
+    auto bitrate_warned = false;
+
+    for (auto rev = 0; rev < revs; ++rev)
+    {
+        for (auto i = 0; i < len; )
+        {
+            auto byte = byte_at(i);
+
+            if ((byte & OPCODE_MASK) != OPCODE_MASK)
+            {
+                add_bits(byte, 8);
+                ++i;
+                continue;
+            }
+
+            switch (byte)
+            {
+            case NOP_OPCODE:
+            case SETINDEX_OPCODE:
+                ++i;
+                break;
+
+            case SETBITRATE_OPCODE:
+            {
+                // A rate set before any track data is the track's own rate, but a
+                // single bitstream data rate can't follow changes within a track.
+                auto value = (i + 1 < len) ? byte_at(i + 1) : 0;
+                auto track_datarate = HfeV3DataRate(value);
+                if (bitbuf.tell() == 0 && track_datarate != DataRate::Unknown)
+                    bitbuf.datarate = track_datarate;
+                else if (track_datarate != bitbuf.datarate && !bitrate_warned)
+                {
+                    auto bitrate = value ? HFE_EMU_FREQ / (value * 2) : 0;
+                    MessageCPP(msgWarning, "ignoring ", bitrate / 1000, "Kbps bitrate change on ", cylhead);
+                    bitrate_warned = true;
+                }
+                i += 2;
+                break;
+            }
+
+            case SKIPBITS_OPCODE:
+            {
+                auto skip = (i + 1 < len) ? std::min<int>(byte_at(i + 1), 8) : 8;
+                auto bits = (i + 2 < len) ? byte_at(i + 2) : 0;
+                add_bits(bits, 8 - skip);
+                i += 3;
+                break;
+            }
+
+            case RAND_OPCODE:
+                add_bits(HfeRandomByte(random_state), 8);
+                bitbuf.set_weak(bitbuf.tell() - 8, 8);
+                ++i;
+                break;
+
+            default:
+                // Unknown opcodes are kept as data.
+                add_bits(byte, 8);
+                ++i;
+                break;
+            }
+        }
+
+        if (revs > 1)
+            bitbuf.add_index();
+    }
+
+    bitbuf.seek(0);
+    return bitbuf;
+}
+
 bool ReadHFE(MemFile& file, std::shared_ptr<Disk>& disk)
 {
     HFE_HEADER hh;
-    if (!file.rewind() || !file.read(&hh, sizeof(hh))
-        || std::string(hh.header_signature, sizeof(hh.header_signature)) != HFE_SIGNATURE)
+    if (!file.rewind() || !file.read(&hh, sizeof(hh)))
+        return false;
+
+    std::string signature(hh.header_signature, sizeof(hh.header_signature));
+    auto v3 = signature == HFE_V3_SIGNATURE;
+    if (signature != HFE_SIGNATURE && !v3)
         return false;
 
     if (hh.format_revision != 0)
@@ -175,8 +325,14 @@ bool ReadHFE(MemFile& file, std::shared_ptr<Disk>& disk)
                 uRead += chunk;
             }
 
-            BitBuffer bitbuf(datarate, pbTrack, uTrackDataLen * 8);
-            disk->write(CylHead(cyl, head), std::move(bitbuf));
+            CylHead cylhead(cyl, head);
+            if (v3)
+                disk->write(cylhead, DecodeHfeV3Track(cylhead, datarate, pbTrack, uTrackDataLen));
+            else
+            {
+                BitBuffer bitbuf(datarate, pbTrack, uTrackDataLen * 8);
+                disk->write(cylhead, std::move(bitbuf));
+            }
         }
     }
 
@@ -186,7 +342,7 @@ bool ReadHFE(MemFile& file, std::shared_ptr<Disk>& disk)
     if (hh.floppy_rpm)
         disk->metadata()["floppy_rpm"] = std::to_string(hh.floppy_rpm);
 
-    disk->strType() = "HFE";
+    disk->strType() = v3 ? "HFE v3" : "HFE";
     return true;
 }
 
@@ -271,6 +427,112 @@ static uint8_t HfeInterfaceMode(const Track& track)
     return GENERIC_SHUGART_DD_FLOPPYMODE;
 }
 
+// Copy a track bitstream into alternate 256-byte blocks of the cylinder data,
+// padding it to the given length. HFE bits are stored LSB first, as in BitBuffer,
+// so whole bytes are copied in bulk, and only a final partial byte is read as bits.
+static void InterleaveHfeTrack(BitBuffer& bitstream, uint8_t* pbTrack, int padded_bytes)
+{
+    auto track_bits = bitstream.track_bitsize();
+    auto whole_bytes = track_bits / 8;
+    auto track_bytes = (track_bits + 7) / 8;
+    auto pbData = bitstream.data().data();
+
+    for (auto offset = 0; offset < padded_bytes; offset += 0x100, pbTrack += 0x200)
+    {
+        auto chunk_size = std::max(0, std::min(track_bytes - offset, 0x100));
+        auto whole_size = std::max(0, std::min(whole_bytes - offset, chunk_size));
+        std::memcpy(pbTrack, pbData + offset, static_cast<size_t>(whole_size));
+
+        if (whole_size < chunk_size)
+        {
+            // Reading the partial byte continues into the next revolution, or wraps.
+            bitstream.seek(whole_bytes * 8);
+            pbTrack[whole_size] = bitstream.read8_lsb();
+        }
+
+        std::memset(pbTrack + chunk_size, 0x55, static_cast<size_t>(0x100 - chunk_size));
+    }
+}
+
+// Encode a track bitstream as HFE v3 data, starting at the index, and with
+// weak bytes as random data. Bytes that would read as opcodes are escaped as
+// 7 bits using SKIPBITS, which also holds any partial byte at the end. A track
+// with a different data rate to the image sets its own with SETBITRATE.
+static Data EncodeHfeV3Track(const BitBuffer& bitstream, DataRate image_datarate)
+{
+    auto track_bits = bitstream.track_bitsize();
+    const auto& data = bitstream.data();
+
+    Data track;
+    track.reserve((track_bits + 7) / 8 + 16);
+    auto add_byte = [&](uint8_t byte) {
+        track.push_back(util::reverse_byte(byte));
+    };
+
+    // The next 8 bits from a bit position, with the first bit on top.
+    auto next_bits = [&](int bitpos) {
+        auto offset = bitpos / 8;
+        auto word = static_cast<unsigned>(data[offset]);
+        if (offset + 1 < data.size())
+            word |= static_cast<unsigned>(data[offset + 1]) << 8;
+        return util::reverse_byte(static_cast<uint8_t>(word >> (bitpos & 7)));
+    };
+
+    add_byte(SETINDEX_OPCODE);
+    if (bitstream.datarate != DataRate::Unknown && bitstream.datarate != image_datarate)
+    {
+        add_byte(SETBITRATE_OPCODE);
+        add_byte(static_cast<uint8_t>(HFE_EMU_FREQ / (bits_per_second(bitstream.datarate) * 2)));
+    }
+
+    for (auto bitpos = 0; bitpos < track_bits; )
+    {
+        auto remaining = track_bits - bitpos;
+        if (remaining < 8)
+        {
+            add_byte(SKIPBITS_OPCODE);
+            add_byte(static_cast<uint8_t>(8 - remaining));
+            add_byte(static_cast<uint8_t>(next_bits(bitpos) >> (8 - remaining)));
+            break;
+        }
+
+        if (bitstream.weak(bitpos))
+        {
+            add_byte(RAND_OPCODE);
+            bitpos += 8;
+            continue;
+        }
+
+        auto byte = next_bits(bitpos);
+        if ((byte & OPCODE_MASK) == OPCODE_MASK)
+        {
+            add_byte(SKIPBITS_OPCODE);
+            add_byte(1);
+            add_byte(static_cast<uint8_t>(byte >> 1));
+            bitpos += 7;
+        }
+        else
+        {
+            add_byte(byte);
+            bitpos += 8;
+        }
+    }
+
+    return track;
+}
+
+// Copy encoded track data into alternate 256-byte blocks of the cylinder data,
+// padding it to the given length with the fill byte.
+static void InterleaveHfeData(const Data& track, uint8_t* pbTrack, int padded_bytes, uint8_t fill)
+{
+    for (auto offset = 0; offset < padded_bytes; offset += 0x100, pbTrack += 0x200)
+    {
+        auto chunk_size = std::max(0, std::min(track.size() - offset, 0x100));
+        std::memcpy(pbTrack, track.data() + offset, static_cast<size_t>(chunk_size));
+        std::memset(pbTrack + chunk_size, fill, static_cast<size_t>(0x100 - chunk_size));
+    }
+}
+
 bool WriteHFE(FILE* f_, std::shared_ptr<Disk>& disk)
 {
     Data header(256, 0xff);
@@ -278,7 +540,10 @@ bool WriteHFE(FILE* f_, std::shared_ptr<Disk>& disk)
 
     auto& track0 = disk->read_track({ 0, 0 });
 
-    std::copy(HFE_SIGNATURE.begin(), HFE_SIGNATURE.end(), hh.header_signature);
+    auto v3 = opt_hfe == 3;
+    auto image_datarate = static_cast<DataRate>(HfeDataRate(track0) * 1000);
+    const auto& signature = v3 ? HFE_V3_SIGNATURE : HFE_SIGNATURE;
+    std::copy(signature.begin(), signature.end(), hh.header_signature);
     hh.format_revision = 0x00;
     hh.number_of_tracks = static_cast<uint8_t>(disk->cyls());
     hh.number_of_sides = static_cast<uint8_t>(disk->heads());
@@ -297,64 +562,53 @@ bool WriteHFE(FILE* f_, std::shared_ptr<Disk>& disk)
 
     if (!fwrite(header.data(), static_cast<size_t>(header.size()), 1, f_))
         throw util::exception("write error");
-    if (fseek(f_, hh.track_list_offset << 9, SEEK_SET))
-        throw util::exception("seek error");
 
+    // The track LUT is written last, once the track sizes are known, so only
+    // one cylinder of bitstream data is held at a time.
     std::array<HFE_TRACK, MAX_TRACKS> aTrackLUT{};
-    std::map<CylHead, BitBuffer> bitstreams;
     int data_offset = 2;
 
-    auto max_disk_track_bytes = 0;
     for (uint8_t cyl = 0; cyl < hh.number_of_tracks; ++cyl)
     {
+        std::array<BitBuffer, MAX_DISK_HEADS> bitstreams{};
+        std::array<Data, MAX_DISK_HEADS> v3_tracks{};
         auto max_track_bytes = 0;
         for (uint8_t head = 0; head < hh.number_of_sides; ++head)
         {
-            CylHead cylhead(cyl, head);
-            auto trackdata = disk->read(cylhead);
-            auto bitstream = trackdata.preferred().bitstream();
-            auto track_bytes = (bitstream.track_bitsize() + 7) / 8;
+            auto trackdata = disk->read(CylHead(cyl, head));
+            bitstreams[head] = std::move(trackdata.preferred().bitstream());
+            if (v3)
+                v3_tracks[head] = EncodeHfeV3Track(bitstreams[head], image_datarate);
+
+            auto track_bytes = v3 ? v3_tracks[head].size() : (bitstreams[head].track_bitsize() + 7) / 8;
             max_track_bytes = std::max(track_bytes, max_track_bytes);
-            max_disk_track_bytes = std::max(max_disk_track_bytes, max_track_bytes);
-            bitstreams[cylhead] = std::move(bitstream);
+        }
+
+        auto track_len = (max_track_bytes * 2 + 511) & ~0x1ff;
+        Data cyl_data(track_len, 0);
+        for (uint8_t head = 0; head < hh.number_of_sides; ++head)
+        {
+            if (v3)
+                InterleaveHfeData(v3_tracks[head], cyl_data.data() + head * 256, track_len / 2, util::reverse_byte(NOP_OPCODE));
+            else
+                InterleaveHfeTrack(bitstreams[head], cyl_data.data() + head * 256, track_len / 2);
         }
 
         aTrackLUT[cyl].offset = util::htole(static_cast<uint16_t>(data_offset));
         aTrackLUT[cyl].track_len = util::htole(static_cast<uint16_t>(max_track_bytes * 2));
 
+        if (fseek(f_, data_offset * 512, SEEK_SET))
+            throw util::exception("seek error");
+        if (fwrite(cyl_data.data(), 1, static_cast<size_t>(track_len), f_) != static_cast<size_t>(track_len))
+            throw util::exception("write error");
+
         data_offset += ((max_track_bytes * 2) / 512) + 1;
     }
 
+    if (fseek(f_, util::letoh(hh.track_list_offset) << 9, SEEK_SET))
+        throw util::exception("seek error");
     if (fwrite(aTrackLUT.data(), sizeof(aTrackLUT[0]), aTrackLUT.size(), f_) != aTrackLUT.size())
         throw util::exception("write error");
 
-    MEMORY mem(max_disk_track_bytes * 2 + 512);
-    for (uint8_t cyl = 0; cyl < hh.number_of_tracks; ++cyl)
-    {
-        uint8_t* pbTrack{};
-        for (uint8_t head = 0; head < hh.number_of_sides; ++head)
-        {
-            auto& bitstream = bitstreams[{ cyl, head }];
-            auto track_bytes = (bitstream.track_bitsize() + 7) / 8;
-            bitstream.seek(0);
-
-            pbTrack = mem.pb + head * 256;
-            while (track_bytes > 0)
-            {
-                auto chunk_size = std::min(track_bytes, 0x100);
-                for (int i = 0; i < chunk_size; ++i)
-                    *pbTrack++ = bitstream.read8_lsb();
-                memset(pbTrack, 0x55, static_cast<size_t>(0x100 - chunk_size));
-                pbTrack += 0x200 - chunk_size;
-                track_bytes -= chunk_size;
-            }
-        }
-
-        fseek(f_, util::letoh(aTrackLUT[cyl].offset) * 512, SEEK_SET);
-        auto track_len = (util::letoh(aTrackLUT[cyl].track_len) + 511) & ~0x1ff;
-        if (fwrite(mem.pb, 1, static_cast<size_t>(track_len), f_) != static_cast<size_t>(track_len))
-            throw util::exception("write error");
-    }
-
     return true;
 }
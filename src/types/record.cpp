@@ -26,7 +26,13 @@ bool ReadBDOS(const std::string& path, std::shared_ptr<Disk>& disk)
     if (!hdd)
         throw util::exception("invalid disk");
 
-    return ReadRecord(*hdd, record, disk);
+    // Look up the record number or label in the cached record index
+    BDOS_CAPS bdc;
+    record = FindBDOSRecord(*hdd, path, bdc);
+    if (!record)
+        throw util::exception("record '", path.substr(path.rfind(':') + 1), "' not found");
+
+    return ReadRecord(*hdd, record, bdc, disk);
 }
 
 bool WriteBDOS(const std::string& path, std::shared_ptr<Disk>& disk)
@@ -47,12 +53,20 @@ bool WriteBDOS(const std::string& path, std::shared_ptr<Disk>& disk)
 
 bool ReadRecord(HDD& hdd, int record, std::shared_ptr<Disk>& disk)
 {
-    MEMORY mem(MGT_DISK_SIZE);
-    auto pdir = reinterpret_cast<MGT_DIR*>(mem.pb);
-
     BDOS_CAPS bdc;
     if (!IsBDOSDisk(hdd, bdc))
         throw util::exception("drive is not BDOS format");
+
+    return ReadRecord(hdd, record, bdc, disk);
+}
+
+bool ReadRecord(HDD& hdd, int record, const BDOS_CAPS& bdc, std::shared_ptr<Disk>& disk)
+{
+    MEMORY mem(MGT_DISK_SIZE);
+    auto pdir = reinterpret_cast<MGT_DIR*>(mem.pb);
+
+    if (record < 1)
+        throw util::exception("invalid record number (", record, ")");
     else if (record > bdc.records)
         throw util::exception("drive contains only ", bdc.records, " records");
     else if (!hdd.Seek(bdc.base_sectors + 1600 * (record - 1)))
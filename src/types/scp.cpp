@@ -10,6 +10,7 @@
 #include "Options.h"
 #include "Util.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <memory>
 #include <numeric>
@@ -19,6 +20,10 @@ static auto& opt_fix = getOpt<int>("fix");
 
 constexpr auto STANDARD_TDH_OFFSET = 0x10;
 constexpr auto EXTENDED_TDH_OFFSET = 0x80;
+constexpr auto STANDARD_TDH_COUNT = 168;    // track offsets in a floppy-only image
+constexpr auto MAX_REVOLUTIONS = 10;        // most revolutions accepted by the reader
+constexpr auto SCP_TICK_NS = 25;            // 40MHz sampling time
+constexpr auto RPM_360_MAX_NS = 60'000'000'000LL / 330;  // slowest revolution taken as 360rpm
 
 enum
 {
@@ -143,7 +148,7 @@ protected:
                 else
                 {
                     total_time += util::betoh(time);
-                    flux_times.push_back(total_time * 25);  // 25ns sampling time
+                    flux_times.push_back(total_time * SCP_TICK_NS);
                     total_time = 0;
                 }
             }
@@ -305,3 +310,158 @@ bool ReadSCP(MemFile& file, std::shared_ptr<Disk>& disk)
 
     return true;
 }
+
+
+// Requantise flux times in ns to sample ticks. Rounding the running total
+// keeps the revolution time exact. Times that can't be stored, being shorter
+// than a tick or an exact multiple of the 65536-tick overflow, are made a tick
+// longer, borrowing it back from the following times.
+static VectorX<uint32_t> FluxTicks(const VectorX<uint32_t>& flux_times)
+{
+    VectorX<uint32_t> ticks(flux_times.size());
+    std::partial_sum(flux_times.begin(), flux_times.end(), ticks.begin());
+    std::transform(ticks.begin(), ticks.end(), ticks.begin(),
+        [](uint32_t total_ns) { return (total_ns + SCP_TICK_NS / 2) / SCP_TICK_NS; });
+    std::adjacent_difference(ticks.begin(), ticks.end(), ticks.begin());
+
+    uint32_t borrowed = 0;
+    for (auto& tick : ticks)
+    {
+        if (!(tick & 0xffff))
+        {
+            ++tick;
+            ++borrowed;
+        }
+        else if (borrowed)
+        {
+            auto repaid = std::min(borrowed, (tick & 0xffff) - 1);
+            tick -= repaid;
+            borrowed -= repaid;
+        }
+    }
+
+    return ticks;
+}
+
+// Append big-endian 16-bit flux times, with zero entries for each 65536 ticks
+// of overflow, returning the index time of the revolution.
+static uint32_t AppendFluxTicks(Data& data, const VectorX<uint32_t>& ticks)
+{
+    uint32_t index_time = 0;
+    for (auto tick : ticks)
+    {
+        index_time += tick;
+        for (; tick > 0xffff; tick -= 0x10000)
+        {
+            data.push_back(0);
+            data.push_back(0);
+        }
+
+        data.push_back(static_cast<uint8_t>(tick >> 8));
+        data.push_back(static_cast<uint8_t>(tick));
+    }
+
+    return index_time;
+}
+
+bool WriteSCP(FILE* f_, std::shared_ptr<Disk>& disk)
+{
+    auto cyls = disk->cyls();
+    auto heads = disk->heads();
+    if (cyls * 2 > STANDARD_TDH_COUNT)
+        throw util::exception("too many cylinders (", cyls, ") for SCP image");
+
+    // Tracks are written as they're read, with the offsets and header last.
+    VectorX<uint32_t> tdh_offsets(STANDARD_TDH_COUNT);
+    auto pos = STANDARD_TDH_OFFSET + tdh_offsets.size() * intsizeof(uint32_t);
+    if (fseek(f_, pos, SEEK_SET))
+        throw util::exception("seek error");
+
+    uint32_t checksum = 0;
+    auto revolutions = 0;
+    uint32_t first_index_time = 0;
+    auto first_track = -1, last_track = 0;
+    auto normalised = true;
+
+    for (auto cyl = 0; cyl < cyls; ++cyl)
+    {
+        for (auto head = 0; head < heads; ++head)
+        {
+            CylHead cylhead(cyl, head);
+            auto trackdata = disk->read(cylhead);
+            const auto& flux_revs = trackdata.flux();
+            if (flux_revs.empty())
+                continue;
+
+            // All tracks have the revolution count of the first, repeating
+            // revolutions as needed.
+            if (!revolutions)
+                revolutions = std::min(flux_revs.size(), MAX_REVOLUTIONS);
+            normalised &= trackdata.has_normalised_flux();
+
+            auto tracknr = cyl * 2 + head;
+            auto header_size = intsizeof(TRACK_DATA_HEADER) + revolutions * 3 * intsizeof(uint32_t);
+            Data track_data(header_size);
+
+            auto& tdh = *reinterpret_cast<TRACK_DATA_HEADER*>(track_data.data());
+            std::copy_n("TRK", 3, tdh.signature);
+            tdh.tracknr = static_cast<uint8_t>(tracknr);
+
+            for (auto rev = 0; rev < revolutions; ++rev)
+            {
+                auto data_offset = track_data.size();
+                auto index_time = AppendFluxTicks(track_data, FluxTicks(flux_revs[rev % flux_revs.size()]));
+                auto flux_count = (track_data.size() - data_offset) / intsizeof(uint16_t);
+                if (!first_index_time)
+                    first_index_time = index_time;
+
+                auto rev_index = reinterpret_cast<uint32_t*>(track_data.data() + intsizeof(TRACK_DATA_HEADER)) + rev * 3;
+                rev_index[0] = util::htole(index_time);
+                rev_index[1] = util::htole(static_cast<uint32_t>(flux_count));
+                rev_index[2] = util::htole(static_cast<uint32_t>(data_offset));
+            }
+
+            if (fwrite(track_data.data(), static_cast<size_t>(track_data.size()), 1, f_) != 1)
+                throw util::exception("write error");
+
+            checksum = std::accumulate(track_data.begin(), track_data.end(), checksum);
+            tdh_offsets[tracknr] = util::htole(static_cast<uint32_t>(pos));
+            pos += track_data.size();
+
+            if (first_track < 0)
+                first_track = tracknr;
+            last_track = tracknr;
+        }
+    }
+
+    if (!revolutions)
+        throw util::exception("no flux data to write");
+
+    auto offsets_begin = reinterpret_cast<const uint8_t*>(tdh_offsets.data());
+    auto offsets_end = offsets_begin + tdh_offsets.size() * intsizeof(uint32_t);
+    checksum = std::accumulate(offsets_begin, offsets_end, checksum);
+
+    SCP_FILE_HEADER fh{};
+    std::copy_n("SCP", 3, fh.signature);
+    fh.revision = 0x00;
+    fh.disk_type = 0x80;    // other
+    fh.revolutions = static_cast<uint8_t>(revolutions);
+    fh.start_track = static_cast<uint8_t>(first_track);
+    fh.end_track = static_cast<uint8_t>(last_track);
+    // Keep the drive speed of a source SCP image, or take it from the revolution time.
+    auto it_rpm = disk->metadata().find("rpm");
+    auto rpm360 = (it_rpm != disk->metadata().end()) ? it_rpm->second == "360 rpm" :
+        static_cast<long long>(first_index_time) * SCP_TICK_NS <= RPM_360_MAX_NS;
+
+    fh.flags = FLAG_INDEX | FLAG_CREATOR | (normalised ? FLAG_TYPE : 0) | ((cyls > 42) ? FLAG_TPI : 0) |
+        (rpm360 ? FLAG_RPM : 0);
+    fh.bitcell_width = 0;
+    fh.heads = (heads == 1) ? 1 : 0;
+    fh.checksum = util::htole(checksum);
+
+    if (fseek(f_, 0, SEEK_SET) || fwrite(&fh, sizeof(fh), 1, f_) != 1 ||
+        fwrite(tdh_offsets.data(), sizeof(tdh_offsets[0]), static_cast<size_t>(tdh_offsets.size()), f_) != static_cast<size_t>(tdh_offsets.size()))
+        throw util::exception("write error");
+
+    return true;
+}
@@ -5,6 +5,7 @@
 // Dave Dunfield notes: http://www.classiccmp.org/dunfield/img54306/td0notes.txt
 
 #include "IBMPCBase.h"
+#include "LZSS.h"
 #include "Options.h"
 #include "Disk.h"
 #include "MemFile.h"
@@ -72,7 +73,7 @@ struct TD0_DATA
 // Namespace wrapper for the Huffman decompression code
 namespace LZSS
 {
-int Unpack(MemFile& file, uint8_t* pOut_);
+int Unpack(MemFile& file, uint8_t* pOut_, int out_size);
 }
 
 
@@ -206,7 +207,7 @@ bool ReadTD0(MemFile& file, std::shared_ptr<Disk>& disk)
     {
         // 3MB should be enough for any TD0 image
         MEMORY mem(3 * 1024 * 1024);
-        auto uSize = LZSS::Unpack(file, mem);
+        auto uSize = LZSS::Unpack(file, mem, mem.size);
         std::string filename = file.name();
         file.open(mem, uSize, filename);
 
@@ -348,281 +349,16 @@ bool ReadTD0(MemFile& file, std::shared_ptr<Disk>& disk)
 
 ////////////////////////////////////////////////////////////////////////////////
 //
-// LZSS Compression - adapted from the original C code by Haruhiko Okumura (1988)
-//
-// For algorithm/implementation details, as well as general compression info, see:
-//   http://www.fadden.com/techmisc/hdc/  (chapter 10 covers LZSS)
-//
-// Tweaked and reformatted to improve my own understanding, and wrapped in a
-// private namespace to avoid polluting the global namespace with the following.
+// LZSS Compression, see LZSS.h
 
 namespace LZSS
 {
-#define N           4096                    // ring buffer size
-#define F           60                      // lookahead buffer size
-#define THRESHOLD   2                       // match needs to be longer than this for position/length coding
-
-#define N_CHAR      (256 - THRESHOLD + F)   // kinds of characters (character code = 0..N_CHAR-1)
-#define T           (N_CHAR * 2 - 1)        // size of table
-#define R           (T - 1)                 // tree root position
-#define MAX_FREQ    0x8000                  // updates tree when root frequency reached this value
-
-
-short parent[T + N_CHAR];                   // parent nodes (0..T-1) and leaf positions (rest)
-short son[T];                               // pointers to child nodes (son[], son[] + 1)
-uint16_t freq[T + 1];                       // frequency table
-
-uint8_t ring_buff[N + F - 1];               // text buffer for match strings
-unsigned r;                                 // Ring buffer position
-
-MemFile* pfile;                             // compressed input file
-unsigned uBits, uBitBuff;                   // buffered bit count and left-aligned bit buffer
-
-
-static const uint8_t d_len[] = { 3,3,4,4,4,5,5,5,5,6,6,6,7,7,7,8 };
-
-static const uint8_t d_code[] =
-{
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
-    0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02,
-    0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03,
-    0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05,
-    0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07,
-    0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09,
-    0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0B, 0x0B, 0x0B, 0x0B, 0x0B, 0x0B, 0x0B, 0x0B,
-    0x0C, 0x0C, 0x0C, 0x0C, 0x0D, 0x0D, 0x0D, 0x0D, 0x0E, 0x0E, 0x0E, 0x0E, 0x0F, 0x0F, 0x0F, 0x0F,
-    0x10, 0x10, 0x10, 0x10, 0x11, 0x11, 0x11, 0x11, 0x12, 0x12, 0x12, 0x12, 0x13, 0x13, 0x13, 0x13,
-    0x14, 0x14, 0x14, 0x14, 0x15, 0x15, 0x15, 0x15, 0x16, 0x16, 0x16, 0x16, 0x17, 0x17, 0x17, 0x17,
-    0x18, 0x18, 0x19, 0x19, 0x1A, 0x1A, 0x1B, 0x1B, 0x1C, 0x1C, 0x1D, 0x1D, 0x1E, 0x1E, 0x1F, 0x1F,
-    0x20, 0x20, 0x21, 0x21, 0x22, 0x22, 0x23, 0x23, 0x24, 0x24, 0x25, 0x25, 0x26, 0x26, 0x27, 0x27,
-    0x28, 0x28, 0x29, 0x29, 0x2A, 0x2A, 0x2B, 0x2B, 0x2C, 0x2C, 0x2D, 0x2D, 0x2E, 0x2E, 0x2F, 0x2F,
-    0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
-};
-
-
-// Initialise the trees and state variables
-void Init()
-{
-    unsigned i;
-
-    memset(parent, 0, sizeof(parent));
-    memset(son, 0, sizeof(son));
-    memset(freq, 0, sizeof(freq));
-    memset(ring_buff, 0, sizeof(ring_buff));
-
-
-    for (i = 0; i < N_CHAR; i++)
-    {
-        freq[i] = 1;
-        son[i] = i + T;
-        parent[i + T] = i;
-    }
-
-    i = 0;
-    for (int j = N_CHAR; j <= R; i += 2, j++)
-    {
-        freq[j] = freq[i] + freq[i + 1];
-        son[j] = i;
-        parent[i] = parent[i + 1] = j;
-    }
-
-    uBitBuff = uBits = 0;
-    memset(ring_buff, ' ', sizeof(ring_buff));
-
-    freq[T] = 0xffff;
-    parent[R] = 0;
-
-    r = N - F;
-}
-
-// Rebuilt the tree
-void RebuildTree()
-{
-    unsigned i, j, k, f, l;
-
-    // Collect leaf nodes in the first half of the table and replace the freq by (freq + 1) / 2
-    for (i = j = 0; i < T; i++)
-    {
-        if (son[i] >= T)
-        {
-            freq[j] = (freq[i] + 1) / 2;
-            son[j] = son[i];
-            j++;
-        }
-    }
-
-    // Begin constructing tree by connecting sons
-    for (i = 0, j = N_CHAR; j < T; i += 2, j++)
-    {
-        k = i + 1;
-        f = freq[j] = freq[i] + freq[k];
-        for (k = j - 1; f < freq[k]; k--);
-        k++;
-        l = (j - k) * sizeof(*freq);
-
-        memmove(&freq[k + 1], &freq[k], l);
-        freq[k] = f;
-        memmove(&son[k + 1], &son[k], l);
-        son[k] = i;
-    }
-
-    // Connect parent
-    for (i = 0; i < T; i++)
-        if ((k = son[i]) >= T)
-            parent[k] = i;
-        else
-            parent[k] = parent[k + 1] = i;
-}
-
-
-// Increment frequency of given code by one, and update tree
-void UpdateTree(int c)
+// Unpack the rest of the file into the supplied output buffer
+int Unpack(MemFile& file, uint8_t* pOut_, int out_size)
 {
-    unsigned i, j, k, l;
-
-    if (freq[R] == MAX_FREQ)
-        RebuildTree();
-
-    c = parent[c + T];
-
-    do
-    {
-        k = ++freq[c];
-
-        // If the order is disturbed, exchange nodes
-        if (k > freq[l = c + 1])
-        {
-            while (k > freq[++l]);
-            l--;
-            freq[c] = freq[l];
-            freq[l] = k;
-
-            i = son[c];
-            parent[i] = l;
-            if (i < T)
-                parent[i + 1] = l;
-
-            j = son[l];
-            son[l] = i;
-
-            parent[j] = c;
-            if (j < T)
-                parent[j + 1] = c;
-            son[c] = j;
-
-            c = l;
-        }
-    } while ((c = parent[c]) != 0);  // Repeat up to root
-}
-
-inline unsigned GetChar()
-{
-    uint8_t b;
-    return pfile->read(&b, sizeof(b)) ? b : 0;
-}
-
-// Get one bit
-unsigned GetBit()
-{
-    if (!uBits--)
-    {
-        uBitBuff |= GetChar() << 8;
-        uBits = 7;
-    }
-
-    uBitBuff <<= 1;
-    return (uBitBuff >> 16) & 1;
-}
-
-// Get one byte
-unsigned GetByte()
-{
-    if (uBits < 8)
-        uBitBuff |= GetChar() << (8 - uBits);
-    else
-        uBits -= 8;
-
-    uBitBuff <<= 8;
-    return (uBitBuff >> 16) & 0xff;
-}
-
-unsigned DecodeChar()
-{
-    unsigned c = son[R];
-
-    // Travel from root to leaf, choosing the smaller child node (son[]) if the
-    // read bit is 0, the bigger (son[]+1} if 1
-    while (c < T)
-        c = son[c + GetBit()];
-
-    c -= T;
-    UpdateTree(c);
-    return c;
-}
-
-unsigned DecodePosition()
-{
-    unsigned i, j, c;
-
-    // Recover upper 6 bits from table
-    i = GetByte();
-    c = d_code[i] << 6;
-    j = d_len[i >> 4];
-
-    // Read lower 6 bits verbatim
-    for (j -= 2; j--; i = (i << 1) | GetBit());
-
-    return c | (i & 0x3f);
-}
-
-
-// Unpack a given block into the supplied output buffer
-int Unpack(MemFile& file, uint8_t* pOut_)
-{
-    unsigned i, j, c;
-    auto uCount = 0;
-
-    // Store the input start/end positions and prepare to unpack
-    pfile = &file;
-    Init();
-
-    // Loop until we've processed all the input
-    while (!file.eof())
-    {
-        c = DecodeChar();
-
-        // Single output character?
-        if (c < 256)
-        {
-            *pOut_++ = c;
-            uCount++;
-
-            // Update the ring buffer and position (wrapping if necessary)
-            ring_buff[r++] = c;
-            r &= (N - 1);
-        }
-        else
-        {
-            // Position in ring buffer and length
-            i = (r - DecodePosition() - 1) & (N - 1);
-            j = c - 255 + THRESHOLD;
-
-            // Output the block
-            for (unsigned k = 0; k < j; ++k)
-            {
-                c = ring_buff[(i + k) & (N - 1)];
-                *pOut_++ = c;
-                uCount++;
-
-                ring_buff[r++] = c;
-                r &= (N - 1);
-            }
-        }
-    }
-
-    // Return the unpacked size
+    Decoder decoder(file.data().data() + file.tell(), file.remaining());
+    auto uCount = decoder.Unpack(pOut_, out_size);
+    file.seek(file.tell() + decoder.consumed());
     return uCount;
 }
 
@@ -2,6 +2,7 @@
 //  http://scratchpad.wikia.com/wiki/Spectrum_emulator_file_format:_udi
 
 #include "BitstreamTrackBuilder.h"
+#include "CRC32.h"
 #include "Disk.h"
 #include "MemFile.h"
 #include "Util.h"
@@ -29,24 +30,8 @@ struct UDI_TRACK
     uint8_t length[2];      // raw track size in bytes (usually 6250 bytes)
 };
 
-static uint32_t crc32(const uint8_t* buf, int len)
-{
-    uint32_t crc = ~0U;
-    for (int i = 0; i < len; i++)
-    {
-        crc ^= ~buf[i];
-        for (int j = 0; j < 8; ++j)
-        {
-            if (crc & 1)
-                crc = (crc >> 1) ^ 0xedb88320;
-            else
-                crc = (crc >> 1);
-        }
-        crc = ~crc;
-    }
-
-    return crc;
-}
+// UDI uses the standard CRC-32 but starts from all bits set.
+constexpr uint32_t UDI_INIT_CRC = 0xffffffff;
 
 bool ReadUDI(MemFile& file, std::shared_ptr<Disk>& disk)
 {
@@ -72,7 +57,7 @@ bool ReadUDI(MemFile& file, std::shared_ptr<Disk>& disk)
     else if (file.seek(file_size) && file.read(&crc_buf, sizeof(crc_buf)))
     {
         auto crc_file = util::le_value(crc_buf);
-        auto crc = crc32(file.data().data(), file.size() - 4);
+        auto crc = CRC32(file.data().data(), file.size() - 4, UDI_INIT_CRC);
         if (crc != crc_file)
             Message(msgWarning, "invalid file CRC");
         file.seek(sizeof(uh));
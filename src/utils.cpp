@@ -9,6 +9,7 @@
 #include <cstdarg>
 #include <fstream>
 #include <iostream>
+#include <mutex>
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
@@ -24,6 +25,41 @@ namespace util
 
 std::ofstream log;
 LogHelper cout(&std::cout);
+thread_local std::string* thread_output = nullptr;
+
+// Write the complete lines of the thread output, holding the messages lock.
+static void write_thread_lines(LogHelper& h, std::string& pending)
+{
+    auto end = pending.rfind('\n');
+    if (end == std::string::npos)
+        return;
+
+    std::lock_guard<std::mutex> lock(messages_mutex);
+    auto collecting = thread_output;
+    thread_output = nullptr;
+    h << pending.substr(0, end + 1);
+    thread_output = collecting;
+    pending.erase(0, end + 1);
+}
+
+void add_thread_output(LogHelper& h, const std::string& text)
+{
+    *thread_output += text;
+    write_thread_lines(h, *thread_output);
+}
+
+ThreadLineOutput::ThreadLineOutput()
+{
+    thread_output = &m_pending;
+}
+
+ThreadLineOutput::~ThreadLineOutput()
+{
+    if (!m_pending.empty() && m_pending.back() != '\n')
+        m_pending += '\n';
+    write_thread_lines(cout, m_pending);
+    thread_output = nullptr;
+}
 
 
 std::string fmt(const char* fmt, ...)
@@ -138,8 +174,8 @@ bool caseInSensCompare(const std::string& str1, const std::string& str2)
 
 LogHelper& operator<<(LogHelper& h, colour c)
 {
-    // Colours are screen only
-    if (util::is_stdout_a_tty())
+    // Colours are screen only, and not kept in collected thread output.
+    if (util::is_stdout_a_tty() && !thread_output)
     {
 #ifdef _WIN32
         h.screen->flush();
@@ -157,7 +193,7 @@ LogHelper& operator<<(LogHelper& h, colour c)
 
 LogHelper& operator<<(LogHelper& h, ttycmd cmd)
 {
-    if (util::is_stdout_a_tty())
+    if (util::is_stdout_a_tty() && !thread_output)
     {
         switch (cmd)
         {
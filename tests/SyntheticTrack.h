@@ -0,0 +1,84 @@
+#pragma once
+
+// Synthetic 9-sector MFM tracks shared by the test tools.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+constexpr int TRACK_BYTES = 6250;      // 250Kbps DD track at 300rpm.
+constexpr int SECTORS = 9;
+constexpr int SECTOR_SIZE_CODE = 2;    // 512 bytes.
+
+struct SyntheticTrack
+{
+    std::vector<uint8_t> bytes{};
+    std::vector<bool> sync{};           // bytes written with a missing clock bit (A1 and C2 marks)
+    int bad_data_offset = -1;           // first data byte of the sector with the data CRC error
+};
+
+inline uint16_t Crc16(const std::vector<uint8_t>& data, size_t begin)
+{
+    uint16_t crc = 0xffff;
+    for (auto i = begin; i < data.size(); i++)
+    {
+        crc ^= static_cast<uint16_t>(data[i] << 8);
+        for (auto bit = 0; bit < 8; bit++)
+            crc = static_cast<uint16_t>((crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1));
+    }
+    return crc;
+}
+
+inline void AddCrc(std::vector<uint8_t>& track, size_t begin, bool bad)
+{
+    auto crc = Crc16(track, begin);
+    if (bad)
+        crc = static_cast<uint16_t>(~crc);
+    track.push_back(static_cast<uint8_t>(crc >> 8));
+    track.push_back(static_cast<uint8_t>(crc));
+}
+
+// An interleaved 9-sector MFM track, the sector with id bad_sector having a data CRC error.
+inline SyntheticTrack MakeTrack(int cyl, int head, int bad_sector)
+{
+    SyntheticTrack synthetic;
+    auto& track = synthetic.bytes;
+    auto& sync = synthetic.sync;
+    const auto mark_sync = [&](size_t begin, size_t count) {
+        sync.resize(track.size(), false);
+        for (auto i = begin; i < begin + count; i++)
+            sync[i] = true;
+    };
+
+    track.assign(80, 0x4e);
+    track.insert(track.end(), 12, 0x00);
+    track.insert(track.end(), { 0xc2, 0xc2, 0xc2, 0xfc });
+    mark_sync(track.size() - 4, 3);
+    track.insert(track.end(), 50, 0x4e);
+
+    for (auto sector : { 1, 6, 2, 7, 3, 8, 4, 9, 5 })
+    {
+        track.insert(track.end(), 12, 0x00);
+        auto begin = track.size();
+        track.insert(track.end(), { 0xa1, 0xa1, 0xa1, 0xfe, static_cast<uint8_t>(cyl), static_cast<uint8_t>(head),
+            static_cast<uint8_t>(sector), SECTOR_SIZE_CODE });
+        mark_sync(begin, 3);
+        AddCrc(track, begin, false);
+        track.insert(track.end(), 22, 0x4e);
+
+        track.insert(track.end(), 12, 0x00);
+        begin = track.size();
+        track.insert(track.end(), { 0xa1, 0xa1, 0xa1, 0xfb });
+        mark_sync(begin, 3);
+        if (sector == bad_sector)
+            synthetic.bad_data_offset = static_cast<int>(track.size());
+        for (auto i = 0; i < (128 << SECTOR_SIZE_CODE); i++)
+            track.push_back(static_cast<uint8_t>(cyl * 7 + head * 3 + sector + i));
+        AddCrc(track, begin, sector == bad_sector);
+        track.insert(track.end(), 84, 0x4e);
+    }
+    if (track.size() < TRACK_BYTES)
+        track.resize(TRACK_BYTES, 0x4e);
+    sync.resize(track.size(), false);
+    return synthetic;
+}
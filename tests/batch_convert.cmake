@@ -0,0 +1,102 @@
+# Converts a small tree of images and a zip of several with the batch command,
+# and checks each target matches a single copy of its source, and the report.
+# Sources differing only by extension must get different targets, and a zip
+# entry named outside the target directory must not be written.
+#
+# cmake -DSAMDISK=<samdiskplus> -DZIP_FILES=<zip_files> -DWORK_DIR=<dir> -P batch_convert.cmake
+
+foreach(var SAMDISK ZIP_FILES WORK_DIR)
+  if (NOT DEFINED ${var})
+    message(FATAL_ERROR "${var} is not defined")
+  endif()
+endforeach()
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR}/src/sub ${WORK_DIR}/images ${WORK_DIR}/single ${WORK_DIR}/evil)
+
+function(run_samdisk output_var)
+  execute_process(COMMAND ${SAMDISK} ${ARGN} OUTPUT_VARIABLE output ERROR_VARIABLE output RESULT_VARIABLE result)
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "samdisk ${ARGN} failed: ${result}\n${output}")
+  endif()
+  set(${output_var} "${output}" PARENT_SCOPE)
+endfunction()
+
+function(run_zip_files)
+  execute_process(COMMAND ${ZIP_FILES} ${ARGN} RESULT_VARIABLE result)
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "zip_files failed: ${result}")
+  endif()
+endfunction()
+
+# MGT images of a repeated 64 byte pattern, each different.
+foreach(name a b c d e f)
+  string(REPEAT "${name}" 60 pattern)
+  string(REPEAT "${pattern}${name}-${name}\n" 12800 content)
+  file(WRITE ${WORK_DIR}/images/${name}.mgt "${content}")
+endforeach()
+
+file(COPY ${WORK_DIR}/images/a.mgt DESTINATION ${WORK_DIR}/src)
+run_samdisk(output copy ${WORK_DIR}/images/b.mgt ${WORK_DIR}/src/a.dsk)
+file(COPY ${WORK_DIR}/images/c.mgt DESTINATION ${WORK_DIR}/src/sub)
+run_zip_files(${WORK_DIR}/src/multi.zip d.mgt ${WORK_DIR}/images/d.mgt e.mgt ${WORK_DIR}/images/e.mgt)
+
+# Each source and the target it must be converted to.
+set(jobs
+  "src/a.dsk|out/a.dsk.dsk"
+  "src/a.mgt|out/a.mgt.dsk"
+  "src/multi.zip:d.mgt|out/multi/d.dsk"
+  "src/multi.zip:e.mgt|out/multi/e.dsk"
+  "src/sub/c.mgt|out/sub/c.dsk")
+
+run_samdisk(output batch ${WORK_DIR}/src ${WORK_DIR}/out/*.dsk)
+file(READ ${WORK_DIR}/out/samdisk-batch.csv report)
+
+set(index 0)
+foreach(job ${jobs})
+  string(REPLACE "|" ";" job "${job}")
+  list(GET job 0 src)
+  list(GET job 1 dst)
+  if (NOT EXISTS ${WORK_DIR}/${dst})
+    message(FATAL_ERROR "${src} was not converted to ${dst}\n${output}")
+  endif()
+
+  run_samdisk(single_output copy ${WORK_DIR}/${src} ${WORK_DIR}/single/${index}.dsk)
+  file(SHA1 ${WORK_DIR}/${dst} batch_sha1)
+  file(SHA1 ${WORK_DIR}/single/${index}.dsk single_sha1)
+  if (NOT batch_sha1 STREQUAL single_sha1)
+    message(FATAL_ERROR "${dst} differs from a single copy of ${src}")
+  endif()
+
+  string(FIND "${report}" "\n${WORK_DIR}/${src},${WORK_DIR}/${dst},ok," pos)
+  if (pos EQUAL -1)
+    message(FATAL_ERROR "report has no ok result for ${src} to ${dst}:\n${report}")
+  endif()
+  math(EXPR index "${index} + 1")
+endforeach()
+
+string(REGEX MATCHALL "\n" lines "${report}")
+list(LENGTH lines line_count)
+list(LENGTH jobs job_count)
+math(EXPR expected_lines "${job_count} + 1")
+if (NOT line_count EQUAL expected_lines)
+  message(FATAL_ERROR "report has ${line_count} lines instead of ${expected_lines}:\n${report}")
+endif()
+
+# Zip entries may not name a path outside the target directory.
+run_zip_files(${WORK_DIR}/evil/evil.zip ../../escaped.mgt ${WORK_DIR}/images/f.mgt
+  /absolute.mgt ${WORK_DIR}/images/f.mgt sub/../../escaped2.mgt ${WORK_DIR}/images/f.mgt
+  ok.mgt ${WORK_DIR}/images/a.mgt)
+run_samdisk(output batch ${WORK_DIR}/evil ${WORK_DIR}/evil_out/*.dsk)
+file(GLOB_RECURSE escaped ${WORK_DIR}/escaped* ${WORK_DIR}/evil_out/absolute*)
+if (escaped)
+  message(FATAL_ERROR "zip entries were written outside the target directory: ${escaped}")
+endif()
+if (NOT EXISTS ${WORK_DIR}/evil_out/evil/ok.dsk)
+  message(FATAL_ERROR "safe zip entry was not converted\n${output}")
+endif()
+string(REGEX MATCHALL "leaves the target directory" warnings "${output}")
+list(LENGTH warnings warning_count)
+if (NOT warning_count EQUAL 3)
+  message(FATAL_ERROR "expected 3 unsafe zip entries to be reported, not ${warning_count}:\n${output}")
+endif()
@@ -0,0 +1,89 @@
+// Benchmark of BitCorrelator on synthetic multi revolution tracks with known revolution lengths.
+
+#include "BitCorrelator.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+constexpr int REVOLUTIONS = 5;
+constexpr int TOLERANCE_BITS = 512;     // Like Track::COMPARE_TOLERANCE_BYTES around the expected length.
+constexpr double NOISE_RATIO = 0.01;    // Bits flipped in each revolution.
+
+// Bit by bit reference of BitCorrelator::CountMatchingBits.
+static int CountMatchingBitsSlow(const Data& bytes, int shift, int bitCount)
+{
+    const auto bitAt = [&bytes](int i) { return (bytes[i / 8] >> (7 - i % 8)) & 1; };
+    auto matchingBits = 0;
+    for (auto i = 0; i < bitCount; i++)
+        matchingBits += bitAt(i) == bitAt(i + shift);
+    return matchingBits;
+}
+
+// Random bits repeating after revolutionBits, each revolution with its own noise.
+static Data MakeTrack(int revolutionBits, std::mt19937& random)
+{
+    std::bernoulli_distribution bit(0.5), noise(NOISE_RATIO);
+    std::vector<bool> revolution(static_cast<size_t>(revolutionBits));
+    for (auto i = 0; i < revolutionBits; i++)
+        revolution[static_cast<size_t>(i)] = bit(random);
+
+    Data bytes((revolutionBits * REVOLUTIONS + 7) / 8, 0);
+    for (auto i = 0; i < revolutionBits * REVOLUTIONS; i++)
+        if (revolution[static_cast<size_t>(i % revolutionBits)] != noise(random))
+            bytes[i / 8] |= static_cast<uint8_t>(0x80 >> (i % 8));
+    return bytes;
+}
+
+int main(int argc, char* argv[])
+{
+    // The known revolution lengths, odd ones too so the shifts are not byte aligned.
+    const int revolutionBitsList[] = { 49991, 50000, 50033, 83333, 99989, 100000, 100017 };
+    const auto quick = argc > 1 && std::atoi(argv[1]) != 0; // Skip the timing of the bit by bit reference.
+    std::mt19937 random(38);
+    auto failures = 0;
+
+    for (const auto revolutionBits : revolutionBitsList)
+    {
+        const auto bytes = MakeTrack(revolutionBits, random);
+        const BitCorrelator bitCorrelator(bytes);
+        // The expected length is off by up to the tolerance, like a measured spin time.
+        const auto expectedBits = revolutionBits + (revolutionBits % 2 ? TOLERANCE_BITS / 2 : -TOLERANCE_BITS / 3);
+        const auto comparedBits = bitCorrelator.BitSize() - (expectedBits + TOLERANCE_BITS);
+
+        const auto start = std::chrono::steady_clock::now();
+        const auto correlation = bitCorrelator.FindBestShift(expectedBits - TOLERANCE_BITS,
+            expectedBits + TOLERANCE_BITS, comparedBits);
+        const auto fastTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        auto ok = correlation.shift == revolutionBits
+            && correlation.matchingBits == CountMatchingBitsSlow(bytes, correlation.shift, comparedBits)
+            && bitCorrelator.CountMatchingBits(correlation.shift + 1, comparedBits)
+                == CountMatchingBitsSlow(bytes, correlation.shift + 1, comparedBits);
+        std::printf("revolution %6d bits: found %6d, matching ratio %.4f, %7.2f ms", revolutionBits,
+            correlation.shift, correlation.MatchingRatio(), fastTime);
+
+        if (!quick)
+        {
+            const auto startSlow = std::chrono::steady_clock::now();
+            auto bestShift = 0, bestMatchingBits = -1;
+            for (auto shift = expectedBits - TOLERANCE_BITS; shift <= expectedBits + TOLERANCE_BITS; shift++)
+            {
+                const auto matchingBits = CountMatchingBitsSlow(bytes, shift, comparedBits);
+                if (matchingBits > bestMatchingBits)
+                {
+                    bestShift = shift;
+                    bestMatchingBits = matchingBits;
+                }
+            }
+            const auto slowTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startSlow).count();
+            ok = ok && bestShift == correlation.shift;
+            std::printf(", bit by bit %8.2f ms", slowTime);
+        }
+        std::printf("%s\n", ok ? "" : "  FAILED");
+        if (!ok)
+            failures++;
+    }
+    return failures ? 1 : 0;
+}
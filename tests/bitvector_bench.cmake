@@ -0,0 +1,22 @@
+# Generates vfd_tracks .pt tracks and runs bitvector_bench on them.
+#
+# cmake -DVFD_TRACKS=<vfd_tracks> -DBENCH=<bitvector_bench> -DWORK_DIR=<dir> -P bitvector_bench.cmake
+
+foreach(var VFD_TRACKS BENCH WORK_DIR)
+  if (NOT DEFINED ${var})
+    message(FATAL_ERROR "${var} is not defined")
+  endif()
+endforeach()
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+execute_process(COMMAND ${VFD_TRACKS} ${WORK_DIR} 2 5 RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "vfd_tracks failed: ${result}")
+endif()
+
+file(GLOB tracks ${WORK_DIR}/*.pt)
+execute_process(COMMAND ${BENCH} ${tracks} RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "bitvector_bench failed: ${result}")
+endif()
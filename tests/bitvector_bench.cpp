@@ -0,0 +1,172 @@
+// Benchmark of the BitPositionableByteVector sync search and bit doubling on
+// vfd_tracks .pt tracks, at every bit offset, against bit by bit references.
+
+#include "BitPositionableByteVector.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// The address mark sync searched by PhysicalTrackMFM, as AddressMarkSyncInTrack::BITS.
+constexpr uint32_t SYNC_BITS = 0xa1a1a1;
+constexpr int SYNC_BITS_LEN = 24;
+constexpr int READ_LENGTH_MIN = 8;      // Bytes remaining after a sync, enough for an ID field.
+
+static int BitAt(const Data& bytes, int i)
+{
+    return (bytes[i / 8] >> (7 - i % 8)) & 1;
+}
+
+// The track bits starting bitOffset bits in, as if read that far out of byte alignment.
+static Data ShiftBits(const Data& bytes, int bitOffset)
+{
+    Data shifted(bytes.size(), 0);
+    for (auto i = bitOffset; i < bytes.size() * 8; i++)
+        if (BitAt(bytes, i - bitOffset))
+            shifted[i / 8] |= static_cast<uint8_t>(0x80 >> (i % 8));
+    return shifted;
+}
+
+// Bit by bit reference of StepToBits, collecting every position.
+static std::vector<int> FindSyncsSlow(const Data& bytes)
+{
+    std::vector<int> positions;
+    const auto positionMax = (bytes.size() - READ_LENGTH_MIN) * 8;
+    for (auto position = 0; position <= positionMax; position++)
+    {
+        uint32_t bits = 0;
+        for (auto i = 0; i < SYNC_BITS_LEN; i++)
+            bits = bits << 1 | static_cast<uint32_t>(BitAt(bytes, position + i));
+        if (bits == SYNC_BITS)
+            positions.push_back(position);
+    }
+    return positions;
+}
+
+static std::vector<int> FindSyncs(const Data& bytes)
+{
+    std::vector<int> positions;
+    BitPositionableByteVector bits(bytes);
+    while (bits.StepToBits(SYNC_BITS, SYNC_BITS_LEN, READ_LENGTH_MIN))
+    {
+        positions.push_back(bits.GetByteBitPosition().TotalBitPosition());
+        bits.StepBit();
+    }
+    return positions;
+}
+
+// Bit by bit reference of CopyBitsDoubledFrom, from srcBitPosition into a new vector at dstBitPosition.
+static Data CopyBitsDoubledSlow(const Data& bytes, int srcBitPosition, int bitsLen, int dstBitPosition)
+{
+    Data doubled((dstBitPosition + bitsLen * 2 + 7) / 8, 0);
+    for (auto i = 0; i < bitsLen; i++)
+    {
+        if (BitAt(bytes, srcBitPosition + i))
+        {
+            for (auto dst = dstBitPosition + i * 2; dst < dstBitPosition + i * 2 + 2; dst++)
+                doubled[dst / 8] |= static_cast<uint8_t>(0x80 >> (dst % 8));
+        }
+    }
+    return doubled;
+}
+
+static Data CopyBitsDoubled(BitPositionableByteVector& src, int srcBitPosition, int bitsLen, int dstBitPosition)
+{
+    BitPositionableByteVector doubled((dstBitPosition + 7) / 8);
+    doubled.SetByteBitPosition(dstBitPosition);
+    ByteBitPosition srcPosition(srcBitPosition);
+    doubled.CopyBitsDoubledFrom(src, bitsLen, &srcPosition);
+    return doubled.Bytes();
+}
+
+static Data ReadFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return Data(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+template <typename Function>
+static double TimeMs(int repeats, Function function)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for (auto i = 0; i < repeats; i++)
+        function();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "Usage: %s <track.pt> [...]\n", argv[0]);
+        return 1;
+    }
+
+    auto failures = 0;
+    for (auto bits = 0; bits < 256; bits++)
+    {
+        const auto doubled = CopyBitsDoubledSlow(Data(1, static_cast<uint8_t>(bits)), 0, 8, 0);
+        if (Double8Bits(static_cast<uint8_t>(bits)) != (doubled[0] << 8 | doubled[1]))
+        {
+            std::printf("Double8Bits(%02x) differs\n", bits);
+            failures++;
+        }
+    }
+
+    double stepFast = 0, stepSlow = 0, copyFast = 0, copySlow = 0;
+    auto syncs = 0;
+    for (auto arg = 1; arg < argc; arg++)
+    {
+        const auto track = ReadFile(argv[arg]);
+        if (track.size() <= READ_LENGTH_MIN)
+        {
+            std::fprintf(stderr, "%s: failed to read %s\n", argv[0], argv[arg]);
+            return 1;
+        }
+
+        for (auto bitOffset = 0; bitOffset < 8; bitOffset++)
+        {
+            const auto bytes = ShiftBits(track, bitOffset);
+            const auto positions = FindSyncs(bytes);
+            if (positions.empty() || positions != FindSyncsSlow(bytes))
+            {
+                std::printf("%s bit offset %d: sync positions differ\n", argv[arg], bitOffset);
+                failures++;
+            }
+            syncs += positions.size();
+            stepFast += TimeMs(10, [&] { FindSyncs(bytes); });
+            stepSlow += TimeMs(1, [&] { FindSyncsSlow(bytes); });
+
+            // Double the bits after the first sync, into an aligned and an unaligned position.
+            BitPositionableByteVector src(bytes);
+            const auto srcBitPosition = positions.empty() ? bitOffset : positions[0];
+            const auto bitsLen = bytes.size() * 8 - srcBitPosition;
+            for (auto dstBitPosition : { 0, 3 })
+            {
+                if (CopyBitsDoubled(src, srcBitPosition, bitsLen, dstBitPosition)
+                    != CopyBitsDoubledSlow(bytes, srcBitPosition, bitsLen, dstBitPosition))
+                {
+                    std::printf("%s bit offset %d: doubled bits differ at destination bit %d\n", argv[arg], bitOffset, dstBitPosition);
+                    failures++;
+                }
+            }
+            copyFast += TimeMs(10, [&] { CopyBitsDoubled(src, srcBitPosition, bitsLen, 3); });
+            copySlow += TimeMs(1, [&] { CopyBitsDoubledSlow(bytes, srcBitPosition, bitsLen, 3); });
+        }
+    }
+
+    std::printf("%d tracks, %d syncs at all bit offsets\n", argc - 1, syncs);
+    std::printf("StepToBits:          %8.2f ms, bit by bit %8.2f ms, %.1fx\n", stepFast, stepSlow, stepSlow / stepFast);
+    std::printf("CopyBitsDoubledFrom: %8.2f ms, bit by bit %8.2f ms, %.1fx\n", copyFast, copySlow, copySlow / copyFast);
+
+    if (failures)
+    {
+        std::printf("%d failures\n", failures);
+        return 1;
+    }
+    return 0;
+}
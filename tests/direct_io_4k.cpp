@@ -0,0 +1,40 @@
+// Preloaded to make direct reads behave as on a disk of 4K logical sectors,
+// which Linux rejects with EINVAL unless the length, file offset and buffer
+// are all aligned to them. Reports the first read rejected.
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+constexpr uint64_t LOGICAL_BLOCK = 4096;
+
+extern "C" ssize_t read(int fd, void* buf, size_t count)
+{
+    using read_fn = ssize_t(*)(int, void*, size_t);
+    static const auto real_read = reinterpret_cast<read_fn>(dlsym(RTLD_NEXT, "read"));
+    static std::atomic<bool> reported{ false };
+
+    auto flags = fcntl(fd, F_GETFL);
+    if (flags != -1 && (flags & O_DIRECT))
+    {
+        auto offset = static_cast<uint64_t>(lseek(fd, 0, SEEK_CUR));
+        auto address = reinterpret_cast<uintptr_t>(buf);
+        if (count % LOGICAL_BLOCK || offset % LOGICAL_BLOCK || address % LOGICAL_BLOCK)
+        {
+            if (!reported.exchange(true))
+                std::fprintf(stderr, "direct_io_4k: rejected direct read of %zu bytes\n", count);
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    return real_read(fd, buf, count);
+}
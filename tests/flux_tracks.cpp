@@ -0,0 +1,123 @@
+// Writes a synthetic SCP flux image of the vfd_tracks tracks, with timing noise
+// in part of the data field of the sector having a data CRC error.
+
+#include "SyntheticTrack.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+constexpr int BITCELL_NS = 2000;        // 250Kbps MFM at 300rpm.
+constexpr int TICK_NS = 25;             // SCP sample time.
+constexpr int TRACK_COUNT = 168;        // SCP track offsets for a floppy image.
+constexpr int BAD_SECTOR = 5;
+constexpr int NOISY_BEGIN = 100, NOISY_END = 131;  // data bytes of the bad sector with noisy timing.
+
+// MFM bitcells of a track, with the clock bit missing from the sync marks.
+static std::vector<bool> EncodeMfm(const SyntheticTrack& track)
+{
+    std::vector<bool> cells;
+    auto prev = false;
+    for (size_t i = 0; i < track.bytes.size(); i++)
+    {
+        auto byte = track.bytes[i];
+        auto missing_clock = !track.sync[i] ? -1 : (byte == 0xa1) ? 5 : 4;
+        for (auto bit = 0; bit < 8; bit++)
+        {
+            auto data = ((byte >> (7 - bit)) & 1) != 0;
+            cells.push_back(!prev && !data && bit != missing_clock);
+            cells.push_back(data);
+            prev = data;
+        }
+    }
+    return cells;
+}
+
+// Flux times in sample ticks of one revolution, with the noisy transitions
+// moved early or late by the jitter percentage of a bitcell. The same seed
+// gives the same noise in each revolution.
+static std::vector<uint16_t> FluxTicks(const std::vector<bool>& cells, int bitcell_ns, int noisy_begin, int noisy_end,
+    int jitter_percent)
+{
+    std::mt19937 random(26);
+    std::vector<uint16_t> ticks;
+    long long last_ns = 0;
+    for (size_t cell = 0; cell < cells.size(); cell++)
+    {
+        if (!cells[cell])
+            continue;
+
+        auto time_ns = static_cast<long long>(cell) * bitcell_ns;
+        auto byte = static_cast<int>(cell / 16);
+        if (byte >= noisy_begin && byte <= noisy_end)
+            time_ns += ((random() & 1) ? 1 : -1) * bitcell_ns * jitter_percent / 100;
+
+        ticks.push_back(static_cast<uint16_t>((time_ns - last_ns) / TICK_NS));
+        last_ns = time_ns;
+    }
+    return ticks;
+}
+
+static void Put32(std::vector<uint8_t>& data, size_t offset, uint32_t value)
+{
+    for (auto i = 0; i < 4; i++)
+        data[offset + i] = static_cast<uint8_t>(value >> (i * 8));
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argc > 6)
+    {
+        std::fprintf(stderr, "Usage: %s <file.scp> [revolutions] [jitter percent] [cyls] [rpm]\n", argv[0]);
+        return 1;
+    }
+
+    const auto revolutions = argc > 2 ? std::atoi(argv[2]) : 1;
+    const auto jitter_percent = argc > 3 ? std::atoi(argv[3]) : 0;
+    const auto cyls = argc > 4 ? std::atoi(argv[4]) : 1;
+    const auto rpm = argc > 5 ? std::atoi(argv[5]) : 300;
+
+    // The same track at 360rpm is a shorter revolution of 300Kbps data.
+    const auto bitcell_ns = BITCELL_NS * 300 / rpm;
+    const uint8_t flags = 1 /* index synchronised */ | ((rpm == 360) ? 4 /* 360rpm */ : 0);
+
+    // Header, with the track offsets following it.
+    std::vector<uint8_t> image{ 'S', 'C', 'P', 0x19, 0, static_cast<uint8_t>(revolutions), 0,
+        static_cast<uint8_t>(cyls * 2 - 1), flags, 0, 0, 0, 0, 0, 0, 0 };
+    image.resize(image.size() + TRACK_COUNT * 4);
+
+    for (auto tracknr = 0; tracknr < cyls * 2; tracknr++)
+    {
+        const auto track = MakeTrack(tracknr / 2, tracknr % 2, BAD_SECTOR);
+        const auto noisy_begin = track.bad_data_offset + NOISY_BEGIN;
+        const auto flux = FluxTicks(EncodeMfm(track), bitcell_ns, noisy_begin, track.bad_data_offset + NOISY_END,
+            jitter_percent);
+
+        auto tdh_offset = image.size();
+        Put32(image, 0x10 + tracknr * 4, static_cast<uint32_t>(tdh_offset));
+        image.insert(image.end(), { 'T', 'R', 'K', static_cast<uint8_t>(tracknr) });
+        image.resize(image.size() + revolutions * 12);
+
+        for (auto rev = 0; rev < revolutions; rev++)
+        {
+            auto rev_header = tdh_offset + 4 + rev * 12;
+            Put32(image, rev_header, TRACK_BYTES * 16 * bitcell_ns / TICK_NS);
+            Put32(image, rev_header + 4, static_cast<uint32_t>(flux.size()));
+            Put32(image, rev_header + 8, static_cast<uint32_t>(image.size() - tdh_offset));
+            for (auto tick : flux)
+                image.insert(image.end(), { static_cast<uint8_t>(tick >> 8), static_cast<uint8_t>(tick) });
+        }
+    }
+
+    std::ofstream file(argv[1], std::ios::binary);
+    if (!file.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size())))
+    {
+        std::fprintf(stderr, "%s: failed to write %s\n", argv[0], argv[1]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+# Copies an HDF hard disk image to new raw image files, plainly, leaving holes
+# and with a manifest, and checks the data of each copy matches the source.
+#
+# cmake -DSAMDISK=<samdiskplus> -DHDD_IMAGE=<hdd_image> -DWORK_DIR=<dir> -P hdd_copy.cmake
+
+foreach(var SAMDISK HDD_IMAGE WORK_DIR)
+  if (NOT DEFINED ${var})
+    message(FATAL_ERROR "${var} is not defined")
+  endif()
+endforeach()
+
+# Several copy blocks of 1MiB, so reads overlap writes.
+set(MIB 16)
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+# The same data as an HDF image to copy and as a raw image to compare.
+foreach(ext hdf raw)
+  execute_process(COMMAND ${HDD_IMAGE} ${WORK_DIR}/source.${ext} ${MIB} RESULT_VARIABLE result)
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "hdd_image failed: ${result}")
+  endif()
+endforeach()
+file(SHA1 ${WORK_DIR}/source.raw source_sha1)
+
+function(copy_hdd name)
+  execute_process(COMMAND ${SAMDISK} copy ${WORK_DIR}/source.hdf ${WORK_DIR}/${name}.raw ${ARGN}
+    OUTPUT_VARIABLE output ERROR_VARIABLE output RESULT_VARIABLE result)
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "copy to ${name}.raw failed: ${result}\n${output}")
+  endif()
+  file(SHA1 ${WORK_DIR}/${name}.raw sha1)
+  if (NOT sha1 STREQUAL source_sha1)
+    message(FATAL_ERROR "${name}.raw differs from the source")
+  endif()
+endfunction()
+
+copy_hdd(plain)
+copy_hdd(sparse --sparse)
+copy_hdd(manifest --manifest)
+if (NOT EXISTS ${WORK_DIR}/manifest.raw.manifest)
+  message(FATAL_ERROR "copy with --manifest wrote no manifest")
+endif()
@@ -0,0 +1,49 @@
+# Copies a plain file hard disk image with --direct-io, and checks the copy
+# matches the source byte for byte. The image ends with an odd sector, so the
+# last read is not a multiple of a larger logical block size. Where given, the
+# DIRECT_IO_4K preload makes direct reads fail as on a disk of 4K sectors, so
+# the copy must fall back on cached I/O for that read.
+#
+# cmake -DSAMDISK=<samdiskplus> -DHDD_IMAGE=<hdd_image> [-DDIRECT_IO_4K=<direct_io_4k>] -DWORK_DIR=<dir> -P hdd_direct_io.cmake
+
+foreach(var SAMDISK HDD_IMAGE WORK_DIR)
+  if (NOT DEFINED ${var})
+    message(FATAL_ERROR "${var} is not defined")
+  endif()
+endforeach()
+
+# Just over the largest floppy image size, for a plain file to be taken as a hard disk.
+set(MIB 257)
+set(EXTRA_SECTORS 1)
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+execute_process(COMMAND ${HDD_IMAGE} ${WORK_DIR}/source.raw ${MIB} ${EXTRA_SECTORS} RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "hdd_image failed: ${result}")
+endif()
+file(SHA1 ${WORK_DIR}/source.raw source_sha1)
+
+# The copies leave holes, as the source does, to keep their disk use down.
+function(copy_direct name)
+  execute_process(COMMAND ${ARGN} ${SAMDISK} copy ${WORK_DIR}/source.raw ${WORK_DIR}/${name}.raw --direct-io --sparse
+    OUTPUT_VARIABLE output ERROR_VARIABLE output RESULT_VARIABLE result)
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "copy to ${name}.raw with --direct-io failed: ${result}\n${output}")
+  endif()
+  file(SHA1 ${WORK_DIR}/${name}.raw sha1)
+  if (NOT sha1 STREQUAL source_sha1)
+    message(FATAL_ERROR "copy to ${name}.raw with --direct-io differs from the source")
+  endif()
+  set(${name}_output "${output}" PARENT_SCOPE)
+endfunction()
+
+copy_direct(direct)
+
+if (DEFINED DIRECT_IO_4K)
+  copy_direct(fallback ${CMAKE_COMMAND} -E env LD_PRELOAD=${DIRECT_IO_4K})
+  if (NOT fallback_output MATCHES "direct_io_4k: rejected direct read")
+    message(FATAL_ERROR "no direct read was rejected, so the fallback was not used\n${fallback_output}")
+  endif()
+endif()
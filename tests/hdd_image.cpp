@@ -0,0 +1,64 @@
+// Writes a hard disk image of whole MiBs and any extra sectors, holding a
+// numbered data sector at the start of every MiB and at the end, and holes
+// of zeros between them. An .hdf path gets an HDF v1.0 header before the
+// data, so it is taken as a hard disk whatever its size.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+constexpr int SECTOR_SIZE = 512;
+constexpr int HDF_DATA_OFFSET = 128;    // header and identify data of HDF v1.0
+constexpr int64_t MIB = 1024 * 1024;
+
+static void WriteSector(std::ofstream& file, int64_t data_offset, int64_t sector)
+{
+    std::vector<char> data(SECTOR_SIZE);
+    for (auto i = 0; i < SECTOR_SIZE; i++)
+        data[i] = static_cast<char>((sector >> (8 * (i % 8))) + i);
+
+    file.seekp(data_offset + sector * SECTOR_SIZE);
+    file.write(data.data(), data.size());
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3 && argc != 4)
+    {
+        std::fprintf(stderr, "Usage: %s <image.raw|image.hdf> <mib> [sectors]\n", argv[0]);
+        return 1;
+    }
+
+    std::string path = argv[1];
+    auto mib = std::atoi(argv[2]);
+    auto extra_sectors = (argc == 4) ? std::atoi(argv[3]) : 0;
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file || mib <= 0 || extra_sectors < 0)
+    {
+        std::fprintf(stderr, "%s: failed to create %s\n", argv[0], argv[1]);
+        return 1;
+    }
+
+    int64_t data_offset = 0;
+    if (path.size() > 4 && path.compare(path.size() - 4, 4, ".hdf") == 0)
+    {
+        // Signature, EOF, revision 1.0, no flags, and the data offset, with zero identify data.
+        std::vector<char> header(HDF_DATA_OFFSET);
+        std::memcpy(header.data(), "RS-IDE\x1a\x10\x00", 9);
+        header[9] = static_cast<char>(HDF_DATA_OFFSET);
+        file.write(header.data(), header.size());
+        data_offset = HDF_DATA_OFFSET;
+    }
+
+    auto total_sectors = mib * MIB / SECTOR_SIZE + extra_sectors;
+    for (int64_t sector = 0; sector < total_sectors; sector += MIB / SECTOR_SIZE)
+        WriteSector(file, data_offset, sector);
+    WriteSector(file, data_offset, total_sectors - 1);
+
+    file.close();
+    return file ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+# Writes the built-in disk @26, having Rainbow Arts and KBI weak sectors, to an
+# HFE v3 image and reads it back. The layout and data must match the source,
+# apart from the weak bytes, and the weak sectors must read with differing
+# copies over exactly the ranges the generators mark weak. Writing the image
+# read back must give the same file.
+#
+# cmake -DSAMDISK=<samdiskplus> -DWORK_DIR=<dir> -P hfe_weak_round_trip.cmake
+
+foreach(var SAMDISK WORK_DIR)
+  if (NOT DEFINED ${var})
+    message(FATAL_ERROR "${var} is not defined")
+  endif()
+endforeach()
+
+set(SOURCE @26)
+
+# Weak sectors, and the size, weak data offset and weak length of each.
+set(WEAK_SECTORS 198 202)
+set(WEAK_198 512 100 256)
+set(WEAK_202 256 4 4)
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+# Run a command on an image, returning its output without the image path line.
+function(run_samdisk output_var command path)
+  execute_process(COMMAND ${SAMDISK} ${command} ${path} ${ARGN}
+    OUTPUT_VARIABLE output ERROR_VARIABLE errors RESULT_VARIABLE result)
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "${command} ${path} failed: ${result}\n${output}${errors}")
+  endif()
+  string(REPLACE "[${path}]\n" "" output "${output}")
+  string(REGEX REPLACE " +\n" "\n" output "${output}")
+  set(${output_var} "${output}" PARENT_SCOPE)
+endfunction()
+
+run_samdisk(output copy ${SOURCE} ${WORK_DIR}/weak.hfe --hfe=3)
+run_samdisk(output copy ${WORK_DIR}/weak.hfe ${WORK_DIR}/weak2.hfe --hfe=3)
+file(SHA1 ${WORK_DIR}/weak.hfe sha1)
+file(SHA1 ${WORK_DIR}/weak2.hfe sha1_again)
+if (NOT sha1 STREQUAL sha1_again)
+  message(FATAL_ERROR "HFE v3 image changed when read and written again")
+endif()
+
+# The weak sectors read back with 3 copies, differing only over the weak range.
+run_samdisk(source_scan scan ${SOURCE} -v)
+run_samdisk(hfe_scan scan ${WORK_DIR}/weak.hfe -v)
+string(REGEX MATCHALL "diff \\([0-9]+\\): [^\n]*" diffs "${hfe_scan}")
+list(REMOVE_DUPLICATES diffs)
+set(expected_diffs)
+foreach(sector ${WEAK_SECTORS})
+  list(GET WEAK_${sector} 0 size)
+  list(GET WEAK_${sector} 1 offset)
+  list(GET WEAK_${sector} 2 length)
+  math(EXPR rest "${size} - ${offset} - ${length}")
+  list(APPEND expected_diffs "diff (${sector}): =${offset} -${length} =${rest}")
+endforeach()
+if (NOT diffs STREQUAL expected_diffs)
+  message(FATAL_ERROR "weak ranges read back as:\n${diffs}\nexpected:\n${expected_diffs}")
+endif()
+
+string(REPLACE "m3," "" hfe_scan "${hfe_scan}")
+string(REGEX REPLACE " +diff [^\n]*\n" "" hfe_scan "${hfe_scan}")
+if (NOT hfe_scan STREQUAL source_scan)
+  message(FATAL_ERROR "HFE v3 image scans as:\n${hfe_scan}\nsource scans as:\n${source_scan}")
+endif()
+
+# Sector data, as one list item per sector of its hex bytes.
+function(view_sectors output_var path)
+  run_samdisk(output view ${path})
+  string(REGEX REPLACE "\n([0-9A-F][0-9A-F][0-9A-F][0-9A-F] ( [0-9A-F][0-9A-F])+)  [^\n]*" "\n\\1" output "${output}")
+  string(REGEX MATCHALL "Sector [0-9]+ \\([0-9]+ bytes\\):(\n[0-9A-F]+ ( [0-9A-F][0-9A-F])+)+" sectors "${output}")
+  set(${output_var} "${sectors}" PARENT_SCOPE)
+endfunction()
+
+view_sectors(source_sectors ${SOURCE})
+view_sectors(hfe_sectors ${WORK_DIR}/weak.hfe)
+list(LENGTH source_sectors count)
+list(LENGTH hfe_sectors hfe_count)
+if (NOT count EQUAL hfe_count OR count EQUAL 0)
+  message(FATAL_ERROR "HFE v3 image has ${hfe_count} sectors instead of ${count}")
+endif()
+
+set(weak_count 0)
+math(EXPR last "${count} - 1")
+foreach(index RANGE ${last})
+  list(GET source_sectors ${index} source)
+  list(GET hfe_sectors ${index} hfe)
+  if (source STREQUAL hfe)
+    continue()
+  endif()
+
+  # Only the weak range of a weak sector may differ.
+  string(REGEX MATCH "^Sector ([0-9]+)" name "${source}")
+  set(sector ${CMAKE_MATCH_1})
+  list(FIND WEAK_SECTORS "${sector}" weak_index)
+  if (weak_index EQUAL -1)
+    message(FATAL_ERROR "HFE v3 data differs in non-weak sector:\n${hfe}\nsource:\n${source}")
+  endif()
+  list(GET WEAK_${sector} 1 weak_begin)
+  list(GET WEAK_${sector} 2 length)
+  math(EXPR weak_end "${weak_begin} + ${length}")
+
+  string(REGEX REPLACE "^[^\n]*\n" "" source "${source}")
+  string(REGEX REPLACE "^[^\n]*\n" "" hfe "${hfe}")
+  string(REGEX MATCHALL " [0-9A-F][0-9A-F]" source_bytes "${source}")
+  string(REGEX MATCHALL " [0-9A-F][0-9A-F]" hfe_bytes "${hfe}")
+  list(LENGTH source_bytes bytes)
+  math(EXPR last_byte "${bytes} - 1")
+  foreach(offset RANGE ${last_byte})
+    if (offset GREATER_EQUAL weak_begin AND offset LESS weak_end)
+      continue()
+    endif()
+    list(GET source_bytes ${offset} source_byte)
+    list(GET hfe_bytes ${offset} hfe_byte)
+    if (NOT source_byte STREQUAL hfe_byte)
+      message(FATAL_ERROR "sector ${sector} data differs outside its weak range at offset ${offset}")
+    endif()
+  endforeach()
+  math(EXPR weak_count "${weak_count} + 1")
+endforeach()
+
+if (weak_count EQUAL 0)
+  message(FATAL_ERROR "no weak data read back from the HFE v3 image")
+endif()
@@ -0,0 +1,70 @@
+# Copies a synthetic disk from several vfd: and vfdpt: sources at once, each
+# missing a different track, and checks the merged image matches a copy of
+# the intact disk whatever the source order. The images are .st, holding only
+# sector data, as the format details of a repaired track depend on the order.
+# The device read output of the threads must stay in whole lines.
+#
+# cmake -DSAMDISK=<samdiskplus> -DVFD_TRACKS=<vfd_tracks> -DWORK_DIR=<dir> -P multi_source_copy.cmake
+
+foreach(var SAMDISK VFD_TRACKS WORK_DIR)
+  if (NOT DEFINED ${var})
+    message(FATAL_ERROR "${var} is not defined")
+  endif()
+endforeach()
+
+set(CYLS 4)
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR}/intact)
+execute_process(COMMAND ${VFD_TRACKS} ${WORK_DIR}/intact ${CYLS} RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "vfd_tracks failed: ${result}")
+endif()
+
+# Each source disk lacks one track, a different one for each.
+foreach(source "a;01;0" "b;02;1" "c;00;0")
+  list(GET source 0 name)
+  list(GET source 1 cyl)
+  list(GET source 2 head)
+  file(COPY ${WORK_DIR}/intact/ DESTINATION ${WORK_DIR}/${name})
+  file(REMOVE "${WORK_DIR}/${name}/Raw track (cyl ${cyl} head ${head}).pt")
+endforeach()
+
+function(copy_disk name output_var)
+  math(EXPR last_cyl "${CYLS} - 1")
+  execute_process(COMMAND ${SAMDISK} copy ${ARGN} ${WORK_DIR}/${name}.st -c0-${last_cyl} --debug=2
+    OUTPUT_VARIABLE output ERROR_VARIABLE output RESULT_VARIABLE result)
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "copy ${name} failed: ${result}\n${output}")
+  endif()
+  file(SHA1 ${WORK_DIR}/${name}.st sha1)
+  set(${output_var} ${sha1} PARENT_SCOPE)
+  set(${name}_output "${output}" PARENT_SCOPE)
+endfunction()
+
+copy_disk(intact intact_sha1 vfd:${WORK_DIR}/intact)
+copy_disk(single single_sha1 vfd:${WORK_DIR}/a)
+if (single_sha1 STREQUAL intact_sha1)
+  message(FATAL_ERROR "disk missing a track copied the same as the intact disk")
+endif()
+
+copy_disk(merged merged_sha1 vfd:${WORK_DIR}/a vfd:${WORK_DIR}/b vfdpt:${WORK_DIR}/c)
+if (NOT merged_sha1 STREQUAL intact_sha1)
+  message(FATAL_ERROR "merged copy differs from the intact disk\n${merged_output}")
+endif()
+
+copy_disk(reversed reversed_sha1 vfdpt:${WORK_DIR}/c vfd:${WORK_DIR}/b vfd:${WORK_DIR}/a)
+if (NOT reversed_sha1 STREQUAL intact_sha1)
+  message(FATAL_ERROR "merged copy in reverse source order differs from the intact disk\n${reversed_output}")
+endif()
+
+# Every vfd: debug line of the reading threads must be whole.
+foreach(name merged reversed)
+  string(REGEX MATCHALL "vfd: " starts "${${name}_output}")
+  string(REGEX MATCHALL "vfd: [A-Za-z]+ took [0-9]+ us, elapsed [0-9]+ us\n" lines "${${name}_output}")
+  list(LENGTH starts start_count)
+  list(LENGTH lines line_count)
+  if (start_count EQUAL 0 OR NOT start_count EQUAL line_count)
+    message(FATAL_ERROR "${name} copy output has ${line_count} whole vfd: lines of ${start_count}:\n${${name}_output}")
+  endif()
+endforeach()
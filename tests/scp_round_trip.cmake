@@ -0,0 +1,124 @@
+# Writes synthetic SCP flux images out as SCP again, and checks the flux of
+# every revolution comes back unchanged, the tracks decode to the same
+# sectors, and a 360rpm image keeps its drive speed flag.
+#
+# cmake -DSAMDISK=<samdiskplus> -DFLUX_TRACKS=<flux_tracks> -DWORK_DIR=<dir> -P scp_round_trip.cmake
+
+foreach(var SAMDISK FLUX_TRACKS WORK_DIR)
+  if (NOT DEFINED ${var})
+    message(FATAL_ERROR "${var} is not defined")
+  endif()
+endforeach()
+
+set(CYLS 2)
+set(REVOLUTIONS 3)
+set(FLAG_RPM 4)
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+function(run_samdisk output_var)
+  execute_process(COMMAND ${SAMDISK} ${ARGN} OUTPUT_VARIABLE output ERROR_VARIABLE output RESULT_VARIABLE result)
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "samdisk ${ARGN} failed: ${result}\n${output}")
+  endif()
+  set(${output_var} "${output}" PARENT_SCOPE)
+endfunction()
+
+function(flux_tracks path)
+  execute_process(COMMAND ${FLUX_TRACKS} ${path} ${ARGN} RESULT_VARIABLE result)
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "flux_tracks failed: ${result}")
+  endif()
+endfunction()
+
+# Little-endian value of a file, of 1 or 4 bytes, at an offset expression.
+function(read_le path offset size output_var)
+  math(EXPR offset "${offset}")
+  math(EXPR hex_digits "${size} * 2")
+  file(READ ${path} hex OFFSET ${offset} LIMIT ${size} HEX)
+  set(value "")
+  foreach(pos 6 4 2 0)
+    if (pos LESS hex_digits)
+      string(SUBSTRING "${hex}" ${pos} 2 byte)
+      string(APPEND value "${byte}")
+    endif()
+  endforeach()
+  math(EXPR value "0x${value}")
+  set(${output_var} ${value} PARENT_SCOPE)
+endfunction()
+
+# Flux data of a revolution, as hex.
+function(read_flux path tracknr rev output_var)
+  read_le(${path} "16 + ${tracknr} * 4" 4 tdh_offset)
+  math(EXPR rev_header "${tdh_offset} + 4 + ${rev} * 12")
+  read_le(${path} "${rev_header} + 4" 4 count)
+  read_le(${path} "${rev_header} + 8" 4 data_offset)
+  math(EXPR flux_offset "${tdh_offset} + ${data_offset}")
+  math(EXPR flux_bytes "${count} * 2")
+  file(READ ${path} flux OFFSET ${flux_offset} LIMIT ${flux_bytes} HEX)
+  set(${output_var} "${flux}" PARENT_SCOPE)
+endfunction()
+
+# Scan output, without the image path.
+function(scan_image path output_var)
+  run_samdisk(output scan ${path} -v)
+  string(REPLACE "[${path}]" "" output "${output}")
+  set(${output_var} "${output}" PARENT_SCOPE)
+endfunction()
+
+flux_tracks(${WORK_DIR}/source.scp ${REVOLUTIONS} 0 ${CYLS})
+run_samdisk(output copy ${WORK_DIR}/source.scp ${WORK_DIR}/copy.scp)
+
+read_le(${WORK_DIR}/copy.scp 5 1 revolutions)
+if (NOT revolutions EQUAL REVOLUTIONS)
+  message(FATAL_ERROR "SCP image has ${revolutions} revolutions instead of ${REVOLUTIONS}")
+endif()
+
+math(EXPR last_track "${CYLS} * 2 - 1")
+math(EXPR last_rev "${REVOLUTIONS} - 1")
+foreach(tracknr RANGE ${last_track})
+  foreach(rev RANGE ${last_rev})
+    read_flux(${WORK_DIR}/source.scp ${tracknr} ${rev} source_flux)
+    read_flux(${WORK_DIR}/copy.scp ${tracknr} ${rev} copy_flux)
+    if (source_flux STREQUAL "" OR NOT source_flux STREQUAL copy_flux)
+      message(FATAL_ERROR "flux of track ${tracknr} revolution ${rev} differs from the source")
+    endif()
+  endforeach()
+endforeach()
+
+scan_image(${WORK_DIR}/source.scp source_scan)
+scan_image(${WORK_DIR}/copy.scp copy_scan)
+if (NOT copy_scan STREQUAL source_scan)
+  message(FATAL_ERROR "SCP image scans as:\n${copy_scan}\nsource scans as:\n${source_scan}")
+endif()
+
+run_samdisk(output copy ${WORK_DIR}/source.scp ${WORK_DIR}/source.dsk)
+run_samdisk(output copy ${WORK_DIR}/copy.scp ${WORK_DIR}/copy.dsk)
+file(SHA1 ${WORK_DIR}/source.dsk source_sha1)
+file(SHA1 ${WORK_DIR}/copy.dsk copy_sha1)
+if (NOT copy_sha1 STREQUAL source_sha1)
+  message(FATAL_ERROR "SCP image sectors differ from the source")
+endif()
+
+read_le(${WORK_DIR}/copy.scp 8 1 flags)
+math(EXPR rpm360 "${flags} & ${FLAG_RPM}")
+if (rpm360)
+  message(FATAL_ERROR "300rpm SCP image was written as 360rpm")
+endif()
+
+# A 360rpm image keeps its speed, and one generated from sectors is 300rpm.
+flux_tracks(${WORK_DIR}/source360.scp 2 0 1 360)
+run_samdisk(output copy ${WORK_DIR}/source360.scp ${WORK_DIR}/copy360.scp)
+read_le(${WORK_DIR}/copy360.scp 8 1 flags)
+math(EXPR rpm360 "${flags} & ${FLAG_RPM}")
+if (NOT rpm360)
+  message(FATAL_ERROR "360rpm SCP image was written as 300rpm")
+endif()
+
+run_samdisk(output copy ${WORK_DIR}/source.dsk ${WORK_DIR}/generated.scp)
+read_le(${WORK_DIR}/generated.scp 8 1 flags)
+math(EXPR rpm360 "${flags} & ${FLAG_RPM}")
+if (rpm360)
+  message(FATAL_ERROR "SCP image generated from sectors was written as 360rpm")
+endif()
@@ -0,0 +1,604 @@
+// Differential fuzz of the TD0 LZSS decoder against the original byte at a time decoder.
+//
+// The corpus is generated by an LZSS-Huffman encoder using the same adaptive tree,
+// plus mutated and random streams. With a directory argument the generated corpus
+// is also written there, one file per stream.
+
+#include "LZSS.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using Bytes = std::vector<uint8_t>;
+
+// The original decoder, reading from a buffer instead of a MemFile, with the
+// output bound the TD0 reader now passes.
+namespace Reference
+{
+using LZSS::N;
+using LZSS::F;
+using LZSS::THRESHOLD;
+using LZSS::N_CHAR;
+using LZSS::T;
+using LZSS::R;
+using LZSS::MAX_FREQ;
+
+short parent[T + N_CHAR];                   // parent nodes (0..T-1) and leaf positions (rest)
+short son[T];                               // pointers to child nodes (son[], son[] + 1)
+uint16_t freq[T + 1];                       // frequency table
+
+uint8_t ring_buff[N + F - 1];               // text buffer for match strings
+unsigned r;                                 // Ring buffer position
+
+const uint8_t* pIn;                         // compressed input
+const uint8_t* pInEnd;
+unsigned uBits, uBitBuff;                   // buffered bit count and left-aligned bit buffer
+
+
+static const uint8_t d_len[] = { 3,3,4,4,4,5,5,5,5,6,6,6,7,7,7,8 };
+
+static const uint8_t d_code[] =
+{
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02,
+    0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03,
+    0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05,
+    0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07, 0x07,
+    0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09, 0x09,
+    0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0A, 0x0B, 0x0B, 0x0B, 0x0B, 0x0B, 0x0B, 0x0B, 0x0B,
+    0x0C, 0x0C, 0x0C, 0x0C, 0x0D, 0x0D, 0x0D, 0x0D, 0x0E, 0x0E, 0x0E, 0x0E, 0x0F, 0x0F, 0x0F, 0x0F,
+    0x10, 0x10, 0x10, 0x10, 0x11, 0x11, 0x11, 0x11, 0x12, 0x12, 0x12, 0x12, 0x13, 0x13, 0x13, 0x13,
+    0x14, 0x14, 0x14, 0x14, 0x15, 0x15, 0x15, 0x15, 0x16, 0x16, 0x16, 0x16, 0x17, 0x17, 0x17, 0x17,
+    0x18, 0x18, 0x19, 0x19, 0x1A, 0x1A, 0x1B, 0x1B, 0x1C, 0x1C, 0x1D, 0x1D, 0x1E, 0x1E, 0x1F, 0x1F,
+    0x20, 0x20, 0x21, 0x21, 0x22, 0x22, 0x23, 0x23, 0x24, 0x24, 0x25, 0x25, 0x26, 0x26, 0x27, 0x27,
+    0x28, 0x28, 0x29, 0x29, 0x2A, 0x2A, 0x2B, 0x2B, 0x2C, 0x2C, 0x2D, 0x2D, 0x2E, 0x2E, 0x2F, 0x2F,
+    0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F,
+};
+
+
+// Initialise the trees and state variables
+void Init()
+{
+    unsigned i;
+
+    memset(parent, 0, sizeof(parent));
+    memset(son, 0, sizeof(son));
+    memset(freq, 0, sizeof(freq));
+    memset(ring_buff, 0, sizeof(ring_buff));
+
+
+    for (i = 0; i < N_CHAR; i++)
+    {
+        freq[i] = 1;
+        son[i] = static_cast<short>(i + T);
+        parent[i + T] = static_cast<short>(i);
+    }
+
+    i = 0;
+    for (int j = N_CHAR; j <= R; i += 2, j++)
+    {
+        freq[j] = static_cast<uint16_t>(freq[i] + freq[i + 1]);
+        son[j] = static_cast<short>(i);
+        parent[i] = parent[i + 1] = static_cast<short>(j);
+    }
+
+    uBitBuff = uBits = 0;
+    memset(ring_buff, ' ', sizeof(ring_buff));
+
+    freq[T] = 0xffff;
+    parent[R] = 0;
+
+    r = N - F;
+}
+
+// Rebuilt the tree
+void RebuildTree()
+{
+    unsigned i, j, k, f, l;
+
+    // Collect leaf nodes in the first half of the table and replace the freq by (freq + 1) / 2
+    for (i = j = 0; i < T; i++)
+    {
+        if (son[i] >= T)
+        {
+            freq[j] = static_cast<uint16_t>((freq[i] + 1) / 2);
+            son[j] = son[i];
+            j++;
+        }
+    }
+
+    // Begin constructing tree by connecting sons
+    for (i = 0, j = N_CHAR; j < T; i += 2, j++)
+    {
+        k = i + 1;
+        f = freq[j] = static_cast<uint16_t>(freq[i] + freq[k]);
+        for (k = j - 1; f < freq[k]; k--);
+        k++;
+        l = (j - k) * sizeof(*freq);
+
+        memmove(&freq[k + 1], &freq[k], l);
+        freq[k] = static_cast<uint16_t>(f);
+        memmove(&son[k + 1], &son[k], l);
+        son[k] = static_cast<short>(i);
+    }
+
+    // Connect parent
+    for (i = 0; i < T; i++)
+        if ((k = static_cast<unsigned>(son[i])) >= T)
+            parent[k] = static_cast<short>(i);
+        else
+            parent[k] = parent[k + 1] = static_cast<short>(i);
+}
+
+
+// Increment frequency of given code by one, and update tree
+void UpdateTree(int c)
+{
+    unsigned i, j, k, l;
+
+    if (freq[R] == MAX_FREQ)
+        RebuildTree();
+
+    c = parent[c + T];
+
+    do
+    {
+        k = ++freq[c];
+
+        // If the order is disturbed, exchange nodes
+        if (k > freq[l = static_cast<unsigned>(c) + 1])
+        {
+            while (k > freq[++l]);
+            l--;
+            freq[c] = freq[l];
+            freq[l] = static_cast<uint16_t>(k);
+
+            i = static_cast<unsigned>(son[c]);
+            parent[i] = static_cast<short>(l);
+            if (i < T)
+                parent[i + 1] = static_cast<short>(l);
+
+            j = static_cast<unsigned>(son[l]);
+            son[l] = static_cast<short>(i);
+
+            parent[j] = static_cast<short>(c);
+            if (j < T)
+                parent[j + 1] = static_cast<short>(c);
+            son[c] = static_cast<short>(j);
+
+            c = static_cast<int>(l);
+        }
+    } while ((c = parent[c]) != 0);  // Repeat up to root
+}
+
+inline unsigned GetChar()
+{
+    return (pIn < pInEnd) ? *pIn++ : 0;
+}
+
+// Get one bit
+unsigned GetBit()
+{
+    if (!uBits--)
+    {
+        uBitBuff |= GetChar() << 8;
+        uBits = 7;
+    }
+
+    uBitBuff <<= 1;
+    return (uBitBuff >> 16) & 1;
+}
+
+// Get one byte
+unsigned GetByte()
+{
+    if (uBits < 8)
+        uBitBuff |= GetChar() << (8 - uBits);
+    else
+        uBits -= 8;
+
+    uBitBuff <<= 8;
+    return (uBitBuff >> 16) & 0xff;
+}
+
+unsigned DecodeChar()
+{
+    unsigned c = static_cast<unsigned>(son[R]);
+
+    // Travel from root to leaf, choosing the smaller child node (son[]) if the
+    // read bit is 0, the bigger (son[]+1} if 1
+    while (c < T)
+        c = static_cast<unsigned>(son[c + GetBit()]);
+
+    c -= T;
+    UpdateTree(static_cast<int>(c));
+    return c;
+}
+
+unsigned DecodePosition()
+{
+    unsigned i, j, c;
+
+    // Recover upper 6 bits from table
+    i = GetByte();
+    c = static_cast<unsigned>(d_code[i]) << 6;
+    j = d_len[i >> 4];
+
+    // Read lower 6 bits verbatim
+    for (j -= 2; j--; i = (i << 1) | GetBit());
+
+    return c | (i & 0x3f);
+}
+
+
+// Unpack a given block into the supplied output buffer
+int Unpack(const uint8_t* pb, int len, uint8_t* pOut_, int out_size)
+{
+    unsigned i, j, c;
+    auto uCount = 0;
+
+    // Store the input start/end positions and prepare to unpack
+    pIn = pb;
+    pInEnd = pb + len;
+    Init();
+
+    // Loop until we've processed all the input
+    while (pIn < pInEnd)
+    {
+        c = DecodeChar();
+
+        // Single output character?
+        if (c < 256)
+        {
+            if (uCount == out_size)
+                throw std::runtime_error("compressed data is too large");
+
+            *pOut_++ = static_cast<uint8_t>(c);
+            uCount++;
+
+            // Update the ring buffer and position (wrapping if necessary)
+            ring_buff[r++] = static_cast<uint8_t>(c);
+            r &= (N - 1);
+        }
+        else
+        {
+            // Position in ring buffer and length
+            i = (r - DecodePosition() - 1) & (N - 1);
+            j = c - 255 + THRESHOLD;
+
+            // Output the block
+            for (unsigned k = 0; k < j; ++k)
+            {
+                if (uCount == out_size)
+                    throw std::runtime_error("compressed data is too large");
+
+                c = ring_buff[(i + k) & (N - 1)];
+                *pOut_++ = static_cast<uint8_t>(c);
+                uCount++;
+
+                ring_buff[r++] = static_cast<uint8_t>(c);
+                r &= (N - 1);
+            }
+        }
+    }
+
+    // Return the unpacked size
+    return uCount;
+}
+
+} // namespace Reference
+
+
+// Greedy LZSS-Huffman encoder for the corpus, coding with the reference tree.
+class Encoder
+{
+public:
+    Bytes Pack(const Bytes& text)
+    {
+        m_out.clear();
+        m_bits = 0;
+        m_code_ends.clear();
+        Reference::Init();
+        std::memset(m_ring, ' ', sizeof(m_ring));
+        unsigned r = LZSS::N - LZSS::F;
+
+        for (size_t pos = 0; pos < text.size();)
+        {
+            unsigned best_pos = 0;
+            auto best_len = 0;
+            // Only nearby matches, which is enough to exercise every position code.
+            for (unsigned d = 1; d <= SEARCH_DISTANCE && best_len < LZSS::F; ++d)
+            {
+                auto i = (r - d) & (LZSS::N - 1);
+                auto len = MatchLength(text, pos, r, i);
+                if (len > best_len)
+                {
+                    best_len = len;
+                    best_pos = i;
+                }
+            }
+
+            auto count = 1;
+            if (best_len > LZSS::THRESHOLD)
+            {
+                PutChar(static_cast<unsigned>(best_len + 255 - LZSS::THRESHOLD));
+                PutPosition((r - best_pos - 1) & (LZSS::N - 1));
+                count = best_len;
+            }
+            else
+                PutChar(text[pos]);
+
+            m_code_ends.emplace_back(m_bits, pos + static_cast<size_t>(count));
+            for (auto k = 0; k < count; ++k, ++pos)
+            {
+                m_ring[r++] = text[pos];
+                r &= (LZSS::N - 1);
+            }
+        }
+
+        return m_out;
+    }
+
+    // Text bytes unpacked from the last packed stream. The decoder stops after
+    // the code that reads the final byte, dropping any others ending in it.
+    size_t UnpackedSize() const
+    {
+        for (const auto& code_end : m_code_ends)
+            if (code_end.first > 8 * (m_out.size() - 1))
+                return code_end.second;
+        return 0;
+    }
+
+private:
+    static constexpr unsigned SEARCH_DISTANCE = 1024;
+
+    // Bytes matched from ring position i, overlapping the bytes written at r as the decoder does.
+    int MatchLength(const Bytes& text, size_t pos, unsigned r, unsigned i) const
+    {
+        auto len = 0;
+        for (; len < LZSS::F && pos + static_cast<size_t>(len) < text.size(); ++len)
+        {
+            auto idx = (i + static_cast<unsigned>(len)) & (LZSS::N - 1);
+            auto written = (idx - r) & (LZSS::N - 1);
+            auto b = (written < static_cast<unsigned>(len)) ? text[pos + written] : m_ring[idx];
+            if (b != text[pos + static_cast<size_t>(len)])
+                break;
+        }
+        return len;
+    }
+
+    void PutBit(unsigned bit)
+    {
+        if (!(m_bits & 7))
+            m_out.push_back(0);
+        if (bit)
+            m_out.back() |= static_cast<uint8_t>(0x80 >> (m_bits & 7));
+        m_bits++;
+    }
+
+    void PutBits(int count, unsigned bits)
+    {
+        while (count--)
+            PutBit((bits >> count) & 1);
+    }
+
+    // Code bits from the root to the leaf, collected from the leaf up.
+    void PutChar(unsigned c)
+    {
+        std::vector<unsigned> code;
+        for (auto k = static_cast<unsigned>(Reference::parent[c + LZSS::T]); k != LZSS::R;
+            k = static_cast<unsigned>(Reference::parent[k]))
+            code.push_back(k & 1);
+        for (auto it = code.rbegin(); it != code.rend(); ++it)
+            PutBit(*it);
+
+        Reference::UpdateTree(static_cast<int>(c));
+    }
+
+    // Upper 6 bits as the d_code prefix of d_len bits, then the lower 6 bits.
+    void PutPosition(unsigned position)
+    {
+        auto i = 0;
+        while (Reference::d_code[i] != (position >> 6))
+            ++i;
+        auto len = Reference::d_len[i >> 4];
+        PutBits(len, static_cast<unsigned>(i) >> (8 - len));
+        PutBits(6, position & 0x3f);
+    }
+
+    Bytes m_out{};
+    std::vector<std::pair<size_t, size_t>> m_code_ends{};   // output bits and text bytes after each code
+    size_t m_bits = 0;
+    uint8_t m_ring[LZSS::N]{};
+};
+
+
+struct Result
+{
+    bool threw = false;
+    int count = 0;
+    int consumed = 0;
+    Bytes out{};
+};
+
+static Result UnpackReference(const Bytes& in, int out_size)
+{
+    Result result;
+    result.out.resize(static_cast<size_t>(out_size));
+    try
+    {
+        result.count = Reference::Unpack(in.data(), static_cast<int>(in.size()), result.out.data(), out_size);
+        result.consumed = static_cast<int>(Reference::pIn - in.data());
+        result.out.resize(static_cast<size_t>(result.count));
+    }
+    catch (const std::exception&)
+    {
+        result.threw = true;
+        result.out.clear();
+    }
+    return result;
+}
+
+static Result UnpackDecoder(const Bytes& in, int out_size)
+{
+    Result result;
+    result.out.resize(static_cast<size_t>(out_size));
+    try
+    {
+        LZSS::Decoder decoder(in.data(), static_cast<int>(in.size()));
+        result.count = decoder.Unpack(result.out.data(), out_size);
+        result.consumed = decoder.consumed();
+        result.out.resize(static_cast<size_t>(result.count));
+    }
+    catch (const std::exception&)
+    {
+        result.threw = true;
+        result.out.clear();
+    }
+    return result;
+}
+
+static Bytes MakeText(std::mt19937& random)
+{
+    std::uniform_int_distribution<int> kind(0, 3), byte(0, 255), run(1, 200);
+    // Mostly sector sized blocks, with some long enough for the tree to be rebuilt.
+    auto size = std::uniform_int_distribution<int>(0, 8)(random) == 0 ?
+        std::uniform_int_distribution<int>(40000, 70000)(random) :
+        std::uniform_int_distribution<int>(0, 4096)(random);
+
+    Bytes text;
+    switch (kind(random))
+    {
+    case 0:     // random bytes
+        while (static_cast<int>(text.size()) < size)
+            text.push_back(static_cast<uint8_t>(byte(random)));
+        break;
+    case 1:     // runs, like formatted sectors
+        while (static_cast<int>(text.size()) < size)
+            text.insert(text.end(), static_cast<size_t>(run(random)), static_cast<uint8_t>(byte(random) & 0xe5));
+        break;
+    case 2:     // a small alphabet with repeats, like text
+        while (static_cast<int>(text.size()) < size)
+        {
+            if (text.size() > 16 && byte(random) < 64)
+            {
+                auto from = std::uniform_int_distribution<size_t>(0, text.size() - 16)(random);
+                text.insert(text.end(), text.begin() + static_cast<long>(from), text.begin() + static_cast<long>(from) + 16);
+            }
+            else
+                text.push_back(static_cast<uint8_t>('a' + byte(random) % 12));
+        }
+        break;
+    default:    // a single repeated byte, matching the ring buffer spaces
+        text.assign(static_cast<size_t>(size), static_cast<uint8_t>(byte(random) < 128 ? ' ' : 0));
+        break;
+    }
+    text.resize(static_cast<size_t>(size));
+    return text;
+}
+
+static void Mutate(Bytes& in, std::mt19937& random)
+{
+    std::uniform_int_distribution<int> kind(0, 3), byte(0, 255);
+    if (in.empty())
+    {
+        in.push_back(static_cast<uint8_t>(byte(random)));
+        return;
+    }
+
+    std::uniform_int_distribution<size_t> pos(0, in.size() - 1);
+    switch (kind(random))
+    {
+    case 0:     // bit flips
+        for (auto n = byte(random) % 8 + 1; n--;)
+            in[pos(random)] ^= static_cast<uint8_t>(1 << (byte(random) & 7));
+        break;
+    case 1:     // truncation
+        in.resize(pos(random));
+        break;
+    case 2:     // trailing garbage
+        for (auto n = byte(random) % 16 + 1; n--;)
+            in.push_back(static_cast<uint8_t>(byte(random)));
+        break;
+    default:    // overwritten span
+        for (auto i = pos(random), n = static_cast<size_t>(byte(random) % 32); n-- && i < in.size(); ++i)
+            in[i] = static_cast<uint8_t>(byte(random));
+        break;
+    }
+}
+
+static void WriteCorpus(const std::string& dir, int index, const Bytes& in)
+{
+    auto path = dir + "/" + std::to_string(index) + ".lzss";
+    if (auto f = std::fopen(path.c_str(), "wb"))
+    {
+        std::fwrite(in.data(), 1, in.size(), f);
+        std::fclose(f);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const auto iterations = (argc > 1) ? std::atoi(argv[1]) : 1000;
+    const std::string corpus_dir = (argc > 2) ? argv[2] : "";
+    std::mt19937 random(28);
+    Encoder encoder;
+    auto failures = 0, roundtrips = 0, throws = 0;
+
+    for (auto n = 0; n < iterations; ++n)
+    {
+        auto text = MakeText(random);
+        auto in = encoder.Pack(text);
+        auto out_size = static_cast<int>(text.size());
+
+        // Every fourth stream is mutated or random, the rest are valid.
+        if (n % 4 == 3)
+        {
+            if (n % 8 == 3)
+                Mutate(in, random);
+            else
+            {
+                in.resize(static_cast<size_t>(std::uniform_int_distribution<int>(0, 512)(random)));
+                for (auto& b : in)
+                    b = static_cast<uint8_t>(random());
+            }
+            out_size = std::uniform_int_distribution<int>(0, 16)(random) ? static_cast<int>(in.size()) * 64 + 64 :
+                std::uniform_int_distribution<int>(0, static_cast<int>(in.size()) * 8)(random);
+        }
+
+        if (!corpus_dir.empty())
+            WriteCorpus(corpus_dir, n, in);
+
+        auto expected = UnpackReference(in, out_size);
+        auto actual = UnpackDecoder(in, out_size);
+
+        auto ok = actual.threw == expected.threw && actual.count == expected.count &&
+            actual.out == expected.out && actual.consumed == expected.consumed;
+        if (n % 4 != 3)
+        {
+            ok = ok && actual.out == Bytes(text.begin(), text.begin() + static_cast<long>(encoder.UnpackedSize()));
+            roundtrips++;
+        }
+        throws += expected.threw;
+
+        if (!ok)
+        {
+            std::printf("stream %d (%zu bytes) differs: reference %s %d bytes from %d, decoder %s %d bytes from %d\n",
+                n, in.size(), expected.threw ? "threw after" : "unpacked", expected.count, expected.consumed,
+                actual.threw ? "threw after" : "unpacked", actual.count, actual.consumed);
+            failures++;
+        }
+    }
+
+    std::printf("%d streams, %d round trips, %d too large, %d differences\n", iterations, roundtrips, throws, failures);
+    return failures ? 1 : 0;
+}
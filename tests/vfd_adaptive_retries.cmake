@@ -0,0 +1,65 @@
+# Reads a synthetic vfd: disk having a sector with a data CRC error on every
+# track, and checks that --adaptive-retries gives up on that sector sooner
+# than the fixed retries, reads the same image, and decides the same way on
+# every run.
+#
+# cmake -DSAMDISK=<samdiskplus> -DVFD_TRACKS=<vfd_tracks> -DWORK_DIR=<dir> -P vfd_adaptive_retries.cmake
+
+foreach(var SAMDISK VFD_TRACKS WORK_DIR)
+  if (NOT DEFINED ${var})
+    message(FATAL_ERROR "${var} is not defined")
+  endif()
+endforeach()
+
+set(CYLS 4)
+set(BAD_SECTOR 5)
+set(RETRIES 8)
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR}/tracks)
+execute_process(COMMAND ${VFD_TRACKS} ${WORK_DIR}/tracks ${CYLS} ${BAD_SECTOR} RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "vfd_tracks failed: ${result}")
+endif()
+
+# Copy the disk and return the debug output and the number of simulated reads.
+function(copy_disk name output_var reads_var)
+  math(EXPR last_cyl "${CYLS} - 1")
+  execute_process(COMMAND ${SAMDISK} copy vfd:${WORK_DIR}/tracks ${WORK_DIR}/${name}.dsk
+      -c0-${last_cyl} --retries=${RETRIES} --debug=2 ${ARGN}
+    OUTPUT_VARIABLE output ERROR_VARIABLE output RESULT_VARIABLE result)
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "copy ${name} failed: ${result}\n${output}")
+  endif()
+  string(REGEX MATCHALL "vfd: Read took" reads "${output}")
+  list(LENGTH reads count)
+  set(${output_var} "${output}" PARENT_SCOPE)
+  set(${reads_var} ${count} PARENT_SCOPE)
+endfunction()
+
+copy_disk(fixed fixed_output fixed_reads)
+copy_disk(adaptive1 adaptive1_output adaptive1_reads --adaptive-retries)
+copy_disk(adaptive2 adaptive2_output adaptive2_reads --adaptive-retries)
+message(STATUS "sector reads: fixed ${fixed_reads}, adaptive ${adaptive1_reads}")
+
+if (fixed_output MATCHES "giving up")
+  message(FATAL_ERROR "fixed retries gave up a sector")
+endif()
+string(REGEX MATCHALL "giving up sector ${BAD_SECTOR} of" giveups "${adaptive1_output}")
+list(LENGTH giveups giveup_count)
+math(EXPR tracks "${CYLS} * 2")
+if (NOT giveup_count EQUAL tracks)
+  message(FATAL_ERROR "adaptive retries gave up sector ${BAD_SECTOR} on ${giveup_count} tracks instead of ${tracks}")
+endif()
+if (NOT adaptive1_reads LESS fixed_reads)
+  message(FATAL_ERROR "adaptive retries did not save reads (${adaptive1_reads} >= ${fixed_reads})")
+endif()
+if (NOT adaptive1_output STREQUAL adaptive2_output)
+  message(FATAL_ERROR "adaptive retries are not deterministic")
+endif()
+
+file(SHA1 ${WORK_DIR}/fixed.dsk fixed_sha1)
+file(SHA1 ${WORK_DIR}/adaptive1.dsk adaptive_sha1)
+if (NOT fixed_sha1 STREQUAL adaptive_sha1)
+  message(FATAL_ERROR "adaptive retries read a different image")
+endif()
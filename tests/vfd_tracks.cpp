@@ -0,0 +1,40 @@
+// Writes synthetic raw track files for the vfd: virtual device.
+
+#include "SyntheticTrack.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argc > 4)
+    {
+        std::fprintf(stderr, "Usage: %s <dir> [cyls] [bad sector id]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string dir = argv[1];
+    const auto cyls = argc > 2 ? std::atoi(argv[2]) : 80;
+    const auto bad_sector = argc > 3 ? std::atoi(argv[3]) : 0;
+
+    for (auto cyl = 0; cyl < cyls; cyl++)
+    {
+        for (auto head = 0; head < 2; head++)
+        {
+            char name[64];
+            std::snprintf(name, sizeof(name), "Raw track (cyl %02d head %1d).pt", cyl, head);
+            const auto track = MakeTrack(cyl, head, bad_sector).bytes;
+            std::ofstream file(dir + "/" + name, std::ios::binary);
+            if (!file.write(reinterpret_cast<const char*>(track.data()), static_cast<std::streamsize>(track.size())))
+            {
+                std::fprintf(stderr, "%s: failed to write %s/%s\n", argv[0], dir.c_str(), name);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+# Copies synthetic SCP images whose sector 5 has a data CRC error and noisy
+# flux timing, and checks when a second copy of it is added as a weak sector.
+# A single revolution is ordinary damage and stays unchanged, even with --fix.
+# Two revolutions are weak, but the copy is only added with --fix.
+#
+# cmake -DSAMDISK=<samdiskplus> -DFLUX_TRACKS=<flux_tracks> -DWORK_DIR=<dir> -P weak_sector_copies.cmake
+
+foreach(var SAMDISK FLUX_TRACKS WORK_DIR)
+  if (NOT DEFINED ${var})
+    message(FATAL_ERROR "${var} is not defined")
+  endif()
+endforeach()
+
+set(JITTER_PERCENT 13)
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+# Copy the flux image with the given revolutions, returning the output and
+# the scan of the copied cylinder, which lists the data copies of each sector.
+function(copy_disk revs name output_var scan_var)
+  execute_process(COMMAND ${SAMDISK} copy ${WORK_DIR}/revs${revs}.scp ${WORK_DIR}/${name}.dsk ${ARGN}
+    OUTPUT_VARIABLE output ERROR_VARIABLE output RESULT_VARIABLE result)
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "copy ${name} failed: ${result}\n${output}")
+  endif()
+  execute_process(COMMAND ${SAMDISK} scan ${WORK_DIR}/${name}.dsk -c0 -v
+    OUTPUT_VARIABLE scan ERROR_VARIABLE scan RESULT_VARIABLE result)
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "scan ${name} failed: ${result}\n${scan}")
+  endif()
+  string(REPLACE "${WORK_DIR}/${name}.dsk" "" scan "${scan}")
+  set(${output_var} "${output}" PARENT_SCOPE)
+  set(${scan_var} "${scan}" PARENT_SCOPE)
+endfunction()
+
+foreach(revs 1 2)
+  execute_process(COMMAND ${FLUX_TRACKS} ${WORK_DIR}/revs${revs}.scp ${revs} ${JITTER_PERCENT} RESULT_VARIABLE result)
+  if (NOT result EQUAL 0)
+    message(FATAL_ERROR "flux_tracks failed: ${result}")
+  endif()
+endforeach()
+
+copy_disk(1 single_nofix single_nofix_output single_nofix_scan --no-fix)
+copy_disk(1 single_fix single_fix_output single_fix_scan --fix)
+if (single_fix_output MATCHES "weak sector")
+  message(FATAL_ERROR "single revolution bad CRC sector was taken as weak:\n${single_fix_output}")
+endif()
+if (NOT single_fix_scan STREQUAL single_nofix_scan)
+  message(FATAL_ERROR "single revolution bad CRC sector was changed by --fix:\n${single_fix_scan}")
+endif()
+
+copy_disk(2 weak_nofix weak_nofix_output weak_nofix_scan --no-fix)
+copy_disk(2 weak_default weak_default_output weak_default_scan)
+copy_disk(2 weak_fix weak_fix_output weak_fix_scan --fix)
+if (NOT weak_default_output MATCHES "missing multiple copies of weak sector")
+  message(FATAL_ERROR "weak sector was not reported without --fix:\n${weak_default_output}")
+endif()
+if (NOT weak_default_scan STREQUAL weak_nofix_scan)
+  message(FATAL_ERROR "weak sector copy was added without --fix")
+endif()
+if (NOT weak_fix_output MATCHES "added second copy of weak sector")
+  message(FATAL_ERROR "weak sector copy was not added with --fix:\n${weak_fix_output}")
+endif()
+if (NOT weak_fix_scan MATCHES "5\\[m2,dc\\]")
+  message(FATAL_ERROR "weak sector has no second copy with --fix:\n${weak_fix_scan}")
+endif()
@@ -0,0 +1,109 @@
+// Writes a zip file of stored (uncompressed) entries, with any entry names.
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static uint32_t Crc32(const std::vector<uint8_t>& data)
+{
+    uint32_t crc = 0xffffffff;
+    for (auto b : data)
+    {
+        crc ^= b;
+        for (auto bit = 0; bit < 8; bit++)
+            crc = (crc & 1) ? ((crc >> 1) ^ 0xedb88320) : (crc >> 1);
+    }
+    return ~crc;
+}
+
+static void Put16(std::vector<uint8_t>& data, uint32_t value)
+{
+    data.push_back(static_cast<uint8_t>(value));
+    data.push_back(static_cast<uint8_t>(value >> 8));
+}
+
+static void Put32(std::vector<uint8_t>& data, uint32_t value)
+{
+    Put16(data, value & 0xffff);
+    Put16(data, value >> 16);
+}
+
+// The header fields shared by the local and central directory headers, from the version needed.
+static void PutEntryFields(std::vector<uint8_t>& data, const std::string& name, uint32_t crc, uint32_t size)
+{
+    Put16(data, 10);            // version needed
+    Put16(data, 0);             // flags
+    Put16(data, 0);             // stored
+    Put16(data, 0);             // time
+    Put16(data, 0x21);          // date (1980-01-01)
+    Put32(data, crc);
+    Put32(data, size);          // compressed size
+    Put32(data, size);          // uncompressed size
+    Put16(data, static_cast<uint32_t>(name.size()));
+    Put16(data, 0);             // extra field length
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 4 || argc % 2)
+    {
+        std::fprintf(stderr, "Usage: %s <file.zip> <entry name> <file> [<entry name> <file> ...]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<uint8_t> zip, central;
+    auto entries = 0u;
+
+    for (auto i = 2; i < argc; i += 2, entries++)
+    {
+        const std::string name = argv[i];
+        std::ifstream file(argv[i + 1], std::ios::binary);
+        if (!file)
+        {
+            std::fprintf(stderr, "%s: failed to read %s\n", argv[0], argv[i + 1]);
+            return 1;
+        }
+        std::vector<uint8_t> data{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+
+        auto crc = Crc32(data);
+        auto size = static_cast<uint32_t>(data.size());
+        auto offset = static_cast<uint32_t>(zip.size());
+
+        Put32(zip, 0x04034b50);
+        PutEntryFields(zip, name, crc, size);
+        zip.insert(zip.end(), name.begin(), name.end());
+        zip.insert(zip.end(), data.begin(), data.end());
+
+        Put32(central, 0x02014b50);
+        Put16(central, 20);     // version made by
+        PutEntryFields(central, name, crc, size);
+        Put16(central, 0);      // comment length
+        Put16(central, 0);      // disk number
+        Put16(central, 0);      // internal attributes
+        Put32(central, 0);      // external attributes
+        Put32(central, offset);
+        central.insert(central.end(), name.begin(), name.end());
+    }
+
+    auto central_offset = static_cast<uint32_t>(zip.size());
+    zip.insert(zip.end(), central.begin(), central.end());
+    Put32(zip, 0x06054b50);
+    Put16(zip, 0);              // disk number
+    Put16(zip, 0);              // central directory disk
+    Put16(zip, entries);
+    Put16(zip, entries);
+    Put32(zip, static_cast<uint32_t>(central.size()));
+    Put32(zip, central_offset);
+    Put16(zip, 0);              // comment length
+
+    std::ofstream file(argv[1], std::ios::binary);
+    if (!file.write(reinterpret_cast<const char*>(zip.data()), static_cast<std::streamsize>(zip.size())))
+    {
+        std::fprintf(stderr, "%s: failed to write %s\n", argv[0], argv[1]);
+        return 1;
+    }
+    return 0;
+}